@@ -0,0 +1,255 @@
+/*
+ * afpacket.c - implementation of the TPACKET_V3 AF_PACKET capture backend
+ */
+
+#include "afpacket.h"
+#include "mem.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+#include <linux/filter.h>
+
+typedef struct af_packet {
+	int fd;
+	unsigned char *map;
+	struct tpacket_req3 req;
+	unsigned block;		/* next block to look at */
+	struct tpacket3_hdr *frame;	/* next frame in the current block */
+	unsigned left;		/* frames left in the current block */
+	int loopback;		/* skip our own outgoing copies, as libpcap does */
+	unsigned long packets, drops;	/* kernel counters, which reset on reading */
+	volatile int brk;
+} AFPacketHead;
+
+static int attach_filter(int fd, const char *filter, int snaplen,
+			 char *errbuf) {
+	struct bpf_program bp;
+	struct sock_fprog fprog;
+	pcap_t *p;
+	int ret = 0;
+
+	if (!(p = pcap_open_dead(DLT_EN10MB, snaplen))) {
+		snprintf(errbuf, PCAP_ERRBUF_SIZE, "pcap_open_dead failed");
+		return -1;
+	}
+	if (pcap_compile(p, &bp, filter, 0, 0) == -1) {
+		snprintf(errbuf, PCAP_ERRBUF_SIZE, "%s", pcap_geterr(p));
+		pcap_close(p);
+		return -1;
+	}
+	fprog.len = bp.bf_len;
+	fprog.filter = (struct sock_filter *)bp.bf_insns;
+	if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog))) {
+		snprintf(errbuf, PCAP_ERRBUF_SIZE, "SO_ATTACH_FILTER: %s",
+			 strerror(errno));
+		ret = -1;
+	}
+	pcap_freecode(&bp);
+	pcap_close(p);
+	return ret;
+}
+
+AFPacket afp_open(const char *dev, unsigned block_size, unsigned nblocks,
+		  int fanout_group, const char *filter, int snaplen,
+		  char *errbuf) {
+	AFPacketHead *ah;
+	struct sockaddr_ll sll;
+	struct packet_mreq mreq;
+	struct ifreq ifr;
+	int version = TPACKET_V3;
+	int fanout;
+
+	if (!(ah = (AFPacketHead *)mem_alloc(sizeof(AFPacketHead)))) {
+		snprintf(errbuf, PCAP_ERRBUF_SIZE, "out of memory");
+		return NULL;
+	}
+	memset(ah, 0, sizeof(AFPacketHead));
+	ah->map = MAP_FAILED;
+	/* protocol 0: nothing is delivered until the bind below, by then the
+	 * filter and the ring are in place, as libpcap does it */
+	if ((ah->fd = socket(AF_PACKET, SOCK_RAW, 0)) < 0) {
+		snprintf(errbuf, PCAP_ERRBUF_SIZE, "socket: %s", strerror(errno));
+		goto err;
+	}
+	if (setsockopt(ah->fd, SOL_PACKET, PACKET_VERSION, &version,
+		       sizeof(version))) {
+		snprintf(errbuf, PCAP_ERRBUF_SIZE, "PACKET_VERSION: %s",
+			 strerror(errno));
+		goto err;
+	}
+	if (filter && *filter && attach_filter(ah->fd, filter, snaplen, errbuf))
+		goto err;
+
+	ah->req.tp_block_size = block_size;
+	ah->req.tp_block_nr = nblocks;
+	ah->req.tp_frame_size = AFP_DEFAULT_FRAME_SIZE;
+	ah->req.tp_frame_nr = (block_size / AFP_DEFAULT_FRAME_SIZE) * nblocks;
+	ah->req.tp_retire_blk_tov = 10;	/* ms until a partly filled block is handed over */
+	ah->req.tp_feature_req_word = TP_FT_REQ_FILL_RXHASH;
+	if (setsockopt(ah->fd, SOL_PACKET, PACKET_RX_RING, &ah->req,
+		       sizeof(ah->req))) {
+		snprintf(errbuf, PCAP_ERRBUF_SIZE, "PACKET_RX_RING: %s",
+			 strerror(errno));
+		goto err;
+	}
+	ah->map = mmap(NULL, (size_t)block_size * nblocks,
+		       PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED,
+		       ah->fd, 0);
+	if (ah->map == MAP_FAILED)	/* MAP_LOCKED needs privileges */
+		ah->map = mmap(NULL, (size_t)block_size * nblocks,
+			       PROT_READ | PROT_WRITE, MAP_SHARED, ah->fd, 0);
+	if (ah->map == MAP_FAILED) {
+		snprintf(errbuf, PCAP_ERRBUF_SIZE, "mmap: %s", strerror(errno));
+		goto err;
+	}
+
+	/* only now frames of `dev' start to arrive */
+	memset(&sll, 0, sizeof(sll));
+	sll.sll_family = AF_PACKET;
+	sll.sll_protocol = htons(ETH_P_ALL);
+	if (!(sll.sll_ifindex = if_nametoindex(dev))) {
+		snprintf(errbuf, PCAP_ERRBUF_SIZE, "unknown device %s", dev);
+		goto err;
+	}
+	if (bind(ah->fd, (struct sockaddr *)&sll, sizeof(sll))) {
+		snprintf(errbuf, PCAP_ERRBUF_SIZE, "bind: %s", strerror(errno));
+		goto err;
+	}
+	memset(&ifr, 0, sizeof(ifr));
+	strncpy(ifr.ifr_name, dev, sizeof(ifr.ifr_name) - 1);
+	if (!ioctl(ah->fd, SIOCGIFFLAGS, &ifr))
+		ah->loopback = (ifr.ifr_flags & IFF_LOOPBACK) != 0;
+
+	memset(&mreq, 0, sizeof(mreq));
+	mreq.mr_ifindex = sll.sll_ifindex;
+	mreq.mr_type = PACKET_MR_PROMISC;
+	(void)setsockopt(ah->fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mreq,
+			 sizeof(mreq));
+
+	if (fanout_group >= 0) {
+		/* with DEFRAG the kernel reassembles before hashing, so all
+		 * fragments of a datagram reach the socket of its flow */
+		fanout = (fanout_group & 0xffff) |
+			 ((PACKET_FANOUT_HASH | PACKET_FANOUT_FLAG_DEFRAG) << 16);
+		if (setsockopt(ah->fd, SOL_PACKET, PACKET_FANOUT, &fanout,
+			       sizeof(fanout))) {
+			snprintf(errbuf, PCAP_ERRBUF_SIZE, "PACKET_FANOUT: %s",
+				 strerror(errno));
+			goto err;
+		}
+	}
+	return (AFPacket)ah;
+err:
+	afp_close((AFPacket)ah);
+	return NULL;
+}
+
+static struct tpacket_block_desc *block_desc(AFPacketHead *ah, unsigned i) {
+	return (struct tpacket_block_desc *)(ah->map +
+					     (size_t)i * ah->req.tp_block_size);
+}
+
+int afp_dispatch(AFPacket a, int cnt, pcap_handler cb, u_char *user,
+		 int timeout_ms) {
+	AFPacketHead *ah = (AFPacketHead *)a;
+	struct tpacket_block_desc *bd;
+	struct pcap_pkthdr hdr;
+	struct pollfd pfd;
+	int n = 0;
+
+	for (;;) {
+		if (ah->brk) {
+			ah->brk = 0;
+			return -2;
+		}
+		bd = block_desc(ah, ah->block);
+		if (!ah->left) {
+			if (!(__atomic_load_n(&bd->hdr.bh1.block_status,
+					      __ATOMIC_ACQUIRE) & TP_STATUS_USER)) {
+				if (n > 0)
+					return n;
+				pfd.fd = ah->fd;
+				pfd.events = POLLIN | POLLERR;
+				pfd.revents = 0;
+				if (poll(&pfd, 1, timeout_ms) < 0 && errno != EINTR)
+					return -1;
+				if (!(__atomic_load_n(&bd->hdr.bh1.block_status,
+						      __ATOMIC_ACQUIRE) & TP_STATUS_USER))
+					return 0;
+			}
+			ah->left = bd->hdr.bh1.num_pkts;
+			ah->frame = (struct tpacket3_hdr *)((unsigned char *)bd +
+					bd->hdr.bh1.offset_to_first_pkt);
+		}
+		while (ah->left && (cnt <= 0 || n < cnt)) {
+			struct tpacket3_hdr *f = ah->frame;
+			struct sockaddr_ll *from = (struct sockaddr_ll *)
+				((unsigned char *)f + TPACKET_ALIGN(sizeof(*f)));
+			ah->frame = (struct tpacket3_hdr *)((unsigned char *)f +
+							    f->tp_next_offset);
+			ah->left--;
+			if (ah->loopback && from->sll_pkttype == PACKET_OUTGOING)
+				continue;
+			hdr.ts.tv_sec = f->tp_sec;
+			hdr.ts.tv_usec = f->tp_nsec / 1000;
+			hdr.caplen = f->tp_snaplen;
+			hdr.len = f->tp_len;
+			cb(user, &hdr, (unsigned char *)f + f->tp_mac);
+			n++;
+		}
+		if (!ah->left) {
+			/* all frames seen, hand the block back to the kernel */
+			__atomic_store_n(&bd->hdr.bh1.block_status,
+					 TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+			ah->block = (ah->block + 1) % ah->req.tp_block_nr;
+		}
+		if (cnt > 0 && n >= cnt)
+			return n;
+	}
+}
+
+int afp_loop(AFPacket a, pcap_handler cb, u_char *user) {
+	int n;
+
+	while ((n = afp_dispatch(a, -1, cb, user, 100)) >= 0)
+		;
+	return n == -2 ? 0 : n;
+}
+
+void afp_breakloop(AFPacket a) {
+	((AFPacketHead *)a)->brk = 1;
+}
+
+int afp_stats(AFPacket a, unsigned long *packets, unsigned long *drops) {
+	AFPacketHead *ah = (AFPacketHead *)a;
+	struct tpacket_stats_v3 st;
+	socklen_t len = sizeof(st);
+
+	/* every read hands out its own share of the kernel counters */
+	if (getsockopt(ah->fd, SOL_PACKET, PACKET_STATISTICS, &st, &len))
+		return -1;
+	*packets = __atomic_add_fetch(&ah->packets, st.tp_packets, __ATOMIC_RELAXED);
+	*drops = __atomic_add_fetch(&ah->drops, st.tp_drops, __ATOMIC_RELAXED);
+	return 0;
+}
+
+void afp_close(AFPacket a) {
+	AFPacketHead *ah = (AFPacketHead *)a;
+
+	if (ah->map != MAP_FAILED)
+		munmap(ah->map, (size_t)ah->req.tp_block_size *
+				ah->req.tp_block_nr);
+	if (ah->fd >= 0)
+		close(ah->fd);
+	mem_free(ah);
+}
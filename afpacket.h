@@ -0,0 +1,58 @@
+/*
+ * afpacket.h - public data structures and entry points for the native
+ *              Linux AF_PACKET capture backend
+ *
+ * frames are received into a TPACKET_V3 ring that is mmap'd into the
+ * process; the capture callback is handed a pointer into the ring, no
+ * copy is made. The callback uses the libpcap handler signature so the
+ * same packet functions serve both backends
+ *
+ * several sockets (threads or processes) may join the same fanout group
+ * to share one interface; the kernel then spreads packets across them by
+ * flow hash
+ */
+
+#ifndef _AFPACKET_H_INCLUDED_
+#define _AFPACKET_H_INCLUDED_
+
+#include <pcap.h>
+
+typedef void *AFPacket;
+
+#define AFP_DEFAULT_BLOCK_SIZE (1 << 20)	/* bytes, a multiple of the page size */
+#define AFP_DEFAULT_BLOCK_COUNT 64
+#define AFP_DEFAULT_FRAME_SIZE 2048		/* hint for the kernel only */
+
+/* open `dev' with a ring of `nblocks' blocks of `block_size' bytes each;
+ * if `fanout_group' is not negative the socket joins that fanout group
+ * (PACKET_FANOUT_HASH); `filter', if not NULL or empty, is compiled with
+ * libpcap and attached to the socket; `snaplen' is the length the compiled
+ * filter accepts, so it only truncates frames when there is a filter -
+ * without one, frames are captured whole
+ * returns NULL if error, with a message in `errbuf' (PCAP_ERRBUF_SIZE) */
+AFPacket afp_open(const char *dev, unsigned block_size, unsigned nblocks,
+		  int fanout_group, const char *filter, int snaplen,
+		  char *errbuf);
+
+/* wait up to `timeout_ms' for frames and pass up to `cnt' of them
+ * (cnt <= 0 means all available) to `cb'
+ * returns the number of frames processed, -1 on error, -2 after
+ * afp_breakloop() */
+int afp_dispatch(AFPacket a, int cnt, pcap_handler cb, u_char *user,
+		 int timeout_ms);
+
+/* run afp_dispatch() until an error or afp_breakloop() */
+int afp_loop(AFPacket a, pcap_handler cb, u_char *user);
+
+/* make afp_loop()/afp_dispatch() return; safe from a signal handler */
+void afp_breakloop(AFPacket a);
+
+/* fill in the kernel counters (see struct tpacket_stats_v3) accumulated
+ * since afp_open(); may be called from another thread than the one
+ * capturing. Returns 0 if successful */
+int afp_stats(AFPacket a, unsigned long *packets, unsigned long *drops);
+
+/* destructor */
+void afp_close(AFPacket a);
+
+#endif /* _AFPACKET_H_INCLUDED_ */
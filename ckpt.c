@@ -0,0 +1,225 @@
+/*
+ * ckpt.c - implementation of checkpoint files
+ */
+
+#include "ckpt.h"
+#include "mem.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define CKPT_MAGIC "DPICKPT"
+#define CKPT_VERSION 1
+#define CKPT_BYTE_ORDER 0x01020304
+#define CKPT_ALIGN 8			/* sections start 8 byte aligned */
+
+typedef struct ckpt_file_header {
+	char magic[8];
+	uint32_t byte_order;
+	uint32_t version;
+	uint64_t length;		/* bytes in the file, header included */
+} CkptFileHeader;
+
+typedef struct ckpt_section_header {
+	uint32_t tag;
+	uint32_t recsize;
+	uint32_t nrecs;
+	uint32_t pad;
+} CkptSectionHeader;
+
+typedef struct ckpt_writer {
+	char *path;
+	char *tmp;
+	int fd;
+	unsigned char *map;
+	unsigned long size;
+	unsigned long used;
+} CkptWriterHead;
+
+typedef struct ckpt_reader {
+	unsigned char *map;
+	unsigned long size;
+	unsigned long pos;
+} CkptReaderHead;
+
+static unsigned long align(unsigned long n) {
+	return (n + CKPT_ALIGN - 1) & ~(unsigned long)(CKPT_ALIGN - 1);
+}
+
+unsigned long ckpt_size(unsigned nsections, unsigned long bytes) {
+	return sizeof(CkptFileHeader) +
+	       nsections * (sizeof(CkptSectionHeader) + CKPT_ALIGN) + bytes;
+}
+
+CkptWriter ckpt_create(const char *path, unsigned long size, char *errbuf) {
+	CkptWriterHead *wh;
+
+	if (!(wh = (CkptWriterHead *)mem_alloc(sizeof(CkptWriterHead)))) {
+		snprintf(errbuf, CKPT_ERRBUF_SIZE, "out of memory");
+		return NULL;
+	}
+	memset(wh, 0, sizeof(CkptWriterHead));
+	wh->fd = -1;
+	wh->map = MAP_FAILED;
+	wh->size = size;
+	wh->used = sizeof(CkptFileHeader);
+	if (!(wh->path = (char *)mem_alloc(strlen(path) + 1)) ||
+	    !(wh->tmp = (char *)mem_alloc(strlen(path) + 5))) {
+		snprintf(errbuf, CKPT_ERRBUF_SIZE, "out of memory");
+		goto err;
+	}
+	strcpy(wh->path, path);
+	sprintf(wh->tmp, "%s.tmp", path);
+	if ((wh->fd = open(wh->tmp, O_RDWR | O_CREAT | O_TRUNC, 0644)) == -1 ||
+	    ftruncate(wh->fd, size) == -1 ||
+	    (wh->map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+			    wh->fd, 0)) == MAP_FAILED) {
+		snprintf(errbuf, CKPT_ERRBUF_SIZE, "%s: %s", wh->tmp,
+			 strerror(errno));
+		goto err;
+	}
+	return (CkptWriter)wh;
+err:
+	ckpt_abort((CkptWriter)wh);
+	return NULL;
+}
+
+void *ckpt_section(CkptWriter w, uint32_t tag, uint32_t recsize,
+		   uint32_t nrecs) {
+	CkptWriterHead *wh = (CkptWriterHead *)w;
+	CkptSectionHeader *sh;
+	unsigned long len = align(sizeof(CkptSectionHeader) +
+				  (unsigned long)recsize * nrecs);
+
+	if (wh->used + len > wh->size)
+		return NULL;
+	sh = (CkptSectionHeader *)(wh->map + wh->used);
+	sh->tag = tag;
+	sh->recsize = recsize;
+	sh->nrecs = nrecs;
+	sh->pad = 0;
+	wh->used += len;
+	return sh + 1;
+}
+
+int ckpt_commit(CkptWriter w, char *errbuf) {
+	CkptWriterHead *wh = (CkptWriterHead *)w;
+	CkptFileHeader *fh = (CkptFileHeader *)wh->map;
+	int ok = 0;
+
+	memcpy(fh->magic, CKPT_MAGIC, sizeof(fh->magic));
+	fh->byte_order = CKPT_BYTE_ORDER;
+	fh->version = CKPT_VERSION;
+	fh->length = wh->used;
+	munmap(wh->map, wh->size);
+	wh->map = MAP_FAILED;
+	if (ftruncate(wh->fd, wh->used) == -1 || fsync(wh->fd) == -1 ||
+	    rename(wh->tmp, wh->path) == -1)
+		snprintf(errbuf, CKPT_ERRBUF_SIZE, "%s: %s", wh->path,
+			 strerror(errno));
+	else
+		ok = 1;
+	if (!ok)
+		unlink(wh->tmp);
+	close(wh->fd);
+	wh->fd = -1;
+	mem_free(wh->path);
+	mem_free(wh->tmp);
+	mem_free(wh);
+	return ok;
+}
+
+void ckpt_abort(CkptWriter w) {
+	CkptWriterHead *wh = (CkptWriterHead *)w;
+
+	if (wh->map != MAP_FAILED)
+		munmap(wh->map, wh->size);
+	if (wh->fd != -1) {
+		close(wh->fd);
+		unlink(wh->tmp);
+	}
+	if (wh->path)
+		mem_free(wh->path);
+	if (wh->tmp)
+		mem_free(wh->tmp);
+	mem_free(wh);
+}
+
+CkptReader ckpt_open(const char *path, char *errbuf) {
+	CkptReaderHead *rh;
+	CkptFileHeader *fh;
+	struct stat st;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY)) == -1 || fstat(fd, &st) == -1) {
+		snprintf(errbuf, CKPT_ERRBUF_SIZE, "%s: %s", path,
+			 strerror(errno));
+		if (fd != -1)
+			close(fd);
+		return NULL;
+	}
+	if ((unsigned long)st.st_size < sizeof(CkptFileHeader)) {
+		snprintf(errbuf, CKPT_ERRBUF_SIZE, "%s: file too short", path);
+		close(fd);
+		return NULL;
+	}
+	if (!(rh = (CkptReaderHead *)mem_alloc(sizeof(CkptReaderHead)))) {
+		snprintf(errbuf, CKPT_ERRBUF_SIZE, "out of memory");
+		close(fd);
+		return NULL;
+	}
+	rh->size = st.st_size;
+	rh->pos = sizeof(CkptFileHeader);
+	rh->map = mmap(NULL, rh->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (rh->map == MAP_FAILED) {
+		snprintf(errbuf, CKPT_ERRBUF_SIZE, "mmap %s: %s", path,
+			 strerror(errno));
+		mem_free(rh);
+		return NULL;
+	}
+	madvise(rh->map, rh->size, MADV_SEQUENTIAL);
+	fh = (CkptFileHeader *)rh->map;
+	if (memcmp(fh->magic, CKPT_MAGIC, sizeof(fh->magic)) ||
+	    fh->byte_order != CKPT_BYTE_ORDER || fh->version != CKPT_VERSION ||
+	    fh->length != rh->size) {
+		snprintf(errbuf, CKPT_ERRBUF_SIZE,
+			 "%s: not a checkpoint of this version and byte order, "
+			 "or truncated", path);
+		ckpt_close((CkptReader)rh);
+		return NULL;
+	}
+	return (CkptReader)rh;
+}
+
+const void *ckpt_next(CkptReader r, uint32_t *tag, uint32_t *recsize,
+		      uint32_t *nrecs) {
+	CkptReaderHead *rh = (CkptReaderHead *)r;
+	const CkptSectionHeader *sh;
+	unsigned long len;
+
+	if (rh->pos + sizeof(CkptSectionHeader) > rh->size)
+		return NULL;
+	sh = (const CkptSectionHeader *)(rh->map + rh->pos);
+	len = align(sizeof(CkptSectionHeader) +
+		    (unsigned long)sh->recsize * sh->nrecs);
+	if (rh->pos + len > rh->size)
+		return NULL;
+	rh->pos += len;
+	*tag = sh->tag;
+	*recsize = sh->recsize;
+	*nrecs = sh->nrecs;
+	return sh + 1;
+}
+
+void ckpt_close(CkptReader r) {
+	CkptReaderHead *rh = (CkptReaderHead *)r;
+
+	munmap(rh->map, rh->size);
+	mem_free(rh);
+}
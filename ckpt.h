@@ -0,0 +1,58 @@
+/*
+ * ckpt.h - public data structures and entry points for checkpoint files
+ *
+ * a checkpoint is a header followed by sections, each a tag and a run of
+ * fixed-size records. The writer lays the file out through a shared
+ * mapping, so saving costs no copies and no write calls, and renames it
+ * into place only once it is complete: a crash while saving leaves the
+ * previous checkpoint intact. The reader maps the file and hands out the
+ * sections in place
+ *
+ * records are stored as they are in memory; a file written by a machine
+ * of different byte order or by another format version is refused
+ */
+
+#ifndef _CKPT_H_INCLUDED_
+#define _CKPT_H_INCLUDED_
+
+#include <stdint.h>
+
+#define CKPT_ERRBUF_SIZE 256
+
+typedef void *CkptWriter;
+typedef void *CkptReader;
+
+/* bytes needed for `nsections' sections holding `bytes' of records */
+unsigned long ckpt_size(unsigned nsections, unsigned long bytes);
+
+/* start a checkpoint of at most `size' bytes (see ckpt_size()) that will
+ * replace `path'
+ * returns NULL if error, with a message in `errbuf' */
+CkptWriter ckpt_create(const char *path, unsigned long size, char *errbuf);
+
+/* append a section of `nrecs' records of `recsize' bytes each
+ * returns where to store the records, NULL if they do not fit */
+void *ckpt_section(CkptWriter w, uint32_t tag, uint32_t recsize,
+		   uint32_t nrecs);
+
+/* complete the checkpoint and put it in place of `path'; frees `w'
+ * returns 1 if successful, 0 with a message in `errbuf' otherwise */
+int ckpt_commit(CkptWriter w, char *errbuf);
+
+/* drop an unfinished checkpoint, `path' is left alone; frees `w' */
+void ckpt_abort(CkptWriter w);
+
+/* map the checkpoint `path' and check its header
+ * returns NULL if error, with a message in `errbuf' */
+CkptReader ckpt_open(const char *path, char *errbuf);
+
+/* the next section: fills in its tag, record size and count and returns
+ * its records, valid until ckpt_close()
+ * returns NULL at the end, or if the rest of the file is damaged */
+const void *ckpt_next(CkptReader r, uint32_t *tag, uint32_t *recsize,
+		      uint32_t *nrecs);
+
+/* destructor, unmaps the file */
+void ckpt_close(CkptReader r);
+
+#endif /* _CKPT_H_INCLUDED_ */
@@ -2,8 +2,14 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <string.h>
+#include <strings.h>
 #include <pcap.h>
 #include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/resource.h>
 
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -20,6 +26,19 @@
 #include "ipq_api.h"
 #include "config.h"
 #include "srpc.h"
+#include "htable.h"
+#include "spscring.h"
+#include "pool.h"
+#include "afpacket.h"
+#include "pcapfile.h"
+#include "ipfrag.h"
+#include "publisher.h"
+#include "lhist.h"
+#include "ckpt.h"
+#ifdef BENCHMARK
+#include "trafgen.h"
+#endif
+#include "srpcdefs.h"
 
 enum capture_type {
   FILE_CAPTURE,
@@ -29,29 +48,205 @@ enum capture_type {
 
 #define			MAX_OSDPI_IDS			50000
 #define			MAX_OSDPI_FLOWS			200000
-#define CLEANUP_TIMEOUT 10
 #define CONNECTION_TIMEOUT 10
-
-// id tracking
-struct osdpi_id {
-	u8 ip[4];
-	struct ipoque_id_struct *ipoque_id;
-};
+#define EXPIRE_BUDGET 32  // max flows expired while handling one packet
+#define FLOW_SLAB_OBJS 512
+#define HOST_SLAB_OBJS 512
+// table memory per flow and per host beyond the pool object: the libhashish
+// list entry, and the host table slots at their load factor
+#define FLOW_TABLE_OVERHEAD 64
+#define HOST_TABLE_OVERHEAD 48
+#define EVICT_SCAN 32  // flows looked at for a victim matching the eviction policy
+
+// adaptive load shedding (-L): every SHED_PERIOD packets a worker looks at
+// the fill of its ring and halves the share of new flows it runs through
+// detection above SHED_HIGH percent, or raises it by SHED_STEP below
+// SHED_LOW percent. The share is in 1/SHED_SCALE, never below SHED_MIN.
+#define SHED_PERIOD 1024
+#define SHED_HIGH 50
+#define SHED_LOW 10
+#define SHED_BITS 10
+#define SHED_SCALE (1U << SHED_BITS)
+#define SHED_STEP 32
+#define SHED_MIN 1
+#define FILE_CHUNK 1024  // records read from a file between checks for a signal
+#define DEFAULT_DETECT_PKTS 0  // packets of a flow in detection, 0 for no limit (-c)
+#define DEFAULT_FRAG_MEM (4 << 20)  // bytes of reassembly buffers per thread
+#define DEFAULT_FRAG_TIMEOUT 30  // seconds, as the linux ipfrag_time
+#define PUBLISH_QUEUE_SIZE 65536  // flow records per worker waiting for the publisher
+#define PUBLISH_QUERY_SIZE FR_SIZE  // one rpc datagram, no fragment round trips
+#define PUBLISH_FLUSH_MS 1000
+#define STATS_SERVICE "DPIStats"  // srpc service answering STATS queries (-S)
+#define STATS_QUERY "STATS"
+
+#define MAX_WORKERS 64
+#define MAX_BATCH 256
+#define DEFAULT_RING_SIZE 4096
+#define SNAPLEN BUFSIZ
+#define BENCH_ROUNDS 5  // replays of the trace by dpibench (-R)
 
 // flow tracking
 struct osdpi_flow {
-  u32 lower_ip;
-  u32 upper_ip;
-  u16 lower_port;
-  u16 upper_port;
-  u8 protocol;
-  uint32_t byte_count;
-  uint32_t pkt_count;
+  // canonical 5-tuple, also the storage of the key inserted in the flow hash
+  struct hi_flow_key key;
+  uint64_t byte_count;
+  uint64_t pkt_count;
   uint32_t first_pkt, last_pkt;
+  // totals at the last export, the export callback gets the difference
+  uint64_t exported_bytes, exported_pkts;
   struct ipoque_flow_struct *ipoque_flow;
   
   // result only, not used for flow identification
   u32 detected_protocol;
+  // set once the flow is classified or its detection budget is spent;
+  // from then on its packets bypass opendpi and only update the counters
+  u8 detection_done;
+  // on the worker's dirty list, i.e. seen packets since the last export
+  u8 dirty;
+
+  // per worker expiry list, least recently seen flow first
+  struct osdpi_flow *lru_prev, *lru_next;
+  struct osdpi_flow *dirty_prev, *dirty_next;
+};
+
+// a flow and its opendpi state are co-allocated in one pool object, the
+// ipoque_flow_struct starts right after the (padded) osdpi_flow
+#define OSDPI_FLOW_SIZE ((sizeof(struct osdpi_flow) + 15) & ~15UL)
+
+// a host, likewise followed by its ipoque_id_struct. Hosts come from a
+// bounded pool too; the least recently seen one makes room for a new one.
+struct osdpi_host {
+  HostKey key;
+  struct osdpi_host *lru_prev, *lru_next;
+};
+
+#define OSDPI_HOST_SIZE ((sizeof(struct osdpi_host) + 15) & ~15UL)
+#define OSDPI_HOST_ID(host) ((struct ipoque_id_struct *)((u8 *)(host) + OSDPI_HOST_SIZE))
+
+// longest link header in front of the IP header: ethernet, then tags and
+// labels. Also the room the reassemblers leave in front of a datagram.
+#define LINK_HDR_MAX 64
+
+// per encapsulation counters of the decoder, see extract_headers()
+enum decode_counter {
+  DECODE_IPV4, DECODE_IPV4_FRAGMENT, DECODE_VLAN, DECODE_QINQ, DECODE_MPLS,
+  DECODE_IPV6, DECODE_IPV6_EXT, DECODE_IPV6_TCP, DECODE_IPV6_UDP, DECODE_IPV6_OTHER_L4,
+  DECODE_NON_IP, DECODE_OTHER_L4, DECODE_TRUNCATED,
+  MAX_DECODE_COUNTER
+};
+
+static const char *decode_counter_str[] = {
+  "IPv4", "IPv4 fragments", "VLAN tags", "QinQ tags", "MPLS stacks",
+  "IPv6", "IPv6 extension headers", "IPv6 TCP", "IPv6 UDP", "IPv6 other transport",
+  "non-IP", "not TCP/UDP", "truncated"
+};
+
+// counters of a packet processing thread. Only the owning thread writes
+// them, through STAT_ADD(); the STATS service sums them up on demand with
+// STAT_READ() and never stops the packet path. Aligned so that no two
+// threads ever write to the same cache line.
+struct thread_stats {
+  unsigned long packets, bytes;  // handed to the decoder, captured bytes
+  unsigned long decode[MAX_DECODE_COUNTER];
+  unsigned long reassembled;     // datagrams completed from fragments
+  unsigned long flows_created, flows_expired;
+  unsigned long flows_evicted;   // released early to make room, see -E
+  unsigned long flows_refused;   // packets of flows not admitted, no flow state
+  unsigned long hosts_created, hosts_evicted;
+  unsigned long detect_calls;    // packets through opendpi
+  unsigned long pkts_bypassed;   // packets of flows done with detection
+  unsigned long flows_classified;
+  unsigned long flows_unknown;   // gave up on, see detect_pkts/detect_bytes
+  unsigned long flows_sampled_out;  // not in the 1 in N sample (-s), counters only
+  unsigned long flows_shed;      // left out of detection under load (-L)
+  unsigned long dpi_share;       // of SHED_SCALE, new flows above it skip detection
+  // packets and IP bytes by the protocol of their flow, as far as known
+  unsigned long proto_packets[IPOQUE_MAX_SUPPORTED_PROTOCOLS + 1];
+  unsigned long proto_bytes[IPOQUE_MAX_SUPPORTED_PROTOCOLS + 1];
+} __attribute__((aligned(64)));
+
+// single writer: a relaxed load and store compile to the plain increment
+// but guarantee that readers see whole values
+#define STAT_ADD(st, field, n) \
+  __atomic_store_n(&(st)->field, (st)->field + (n), __ATOMIC_RELAXED)
+#define STAT_INC(st, field) STAT_ADD(st, field, 1)
+#define STAT_SET(st, field, v) __atomic_store_n(&(st)->field, (v), __ATOMIC_RELAXED)
+#define STAT_READ(st, field) __atomic_load_n(&(st)->field, __ATOMIC_RELAXED)
+
+// stages of the packet path timed with -DSTAGE_TIMING; without it the
+// STAGE_ macros compile to nothing
+enum stage {
+  STAGE_DECODE, STAGE_HOST, STAGE_FLOW, STAGE_DETECT, MAX_STAGE
+};
+
+#ifdef STAGE_TIMING
+static const char *stage_str[] = {
+  "extract_headers", "get_id", "get_osdpi_flow", "ipoque_detection_process_packet"
+};
+
+#define STAGE_START(t) uint64_t t = lhist_now()
+#define STAGE_END(w, stage, t) lhist_record(&(w)->timing[stage], lhist_now() - (t))
+#else
+#define STAGE_START(t)
+#define STAGE_END(w, stage, t)
+#endif
+
+// which flow makes room for a new one when the flow pool is full (-E)
+enum evict_policy {
+  EVICT_LRU,           // the least recently seen flow
+  EVICT_UNCLASSIFIED,  // the least recently seen flow without a protocol
+  EVICT_UDP,           // the least recently seen single packet UDP flow
+  EVICT_NONE,          // none, new flows are refused
+};
+
+static const char *evict_policy_str[] = { "lru", "unclassified", "udp", "none" };
+
+// per thread packet processing state, nothing in here is shared between
+// workers. In threaded mode every flow is pinned to one worker by a
+// symmetric hash of its 5-tuple.
+struct osdpi_worker {
+  int id;
+  pthread_t thread;
+  SPSCRing ring;   // packets handed over by the capture thread
+  AFPacket afp;    // own capture ring in AF_PACKET mode (-A)
+
+  struct ipoque_detection_module_struct *ipoque_struct;
+  HTable hosts; 
+  Pool host_pool;
+  struct osdpi_host *host_lru_head, *host_lru_tail;
+  hi_handle_t *hi_handle_flows;
+  struct osdpi_flow *lru_head, *lru_tail;
+  struct osdpi_flow *dirty_head;
+  uint32_t next_export;  // packet time of the next interval export (-I)
+  Pool flow_pool;
+  IPFrag frags;
+  struct thread_stats stats;
+  unsigned long shed_count;  // packets since the last shedding adjustment
+#ifdef STAGE_TIMING
+  LHist timing[MAX_STAGE];
+  LHist *proto_timing;  // the detection stage by the protocol it returned
+#endif
+  int flushing;  // releasing all flows at the end, see flush_osdpi_flows()
+
+  // batched ingest (-b), see batch_collect()
+  struct batch_packet *batch;
+  int batch_len;
+  int batch_in_place;  // input stays mapped until the batch is done
+};
+
+// called with the packets and bytes a flow saw since its last export: for
+// every flow leaving the flow table, right before it is freed, and in
+// interval mode (-I) for every flow that changed during the interval
+typedef void (*flow_export_fn)(struct osdpi_worker *w, struct osdpi_flow *flow, 
+			       uint64_t pkts, uint64_t bytes);
+
+// a packet copied into a worker ring slot. A reassembled datagram or an
+// offline packet longer than the slot goes over in `big', which the
+// worker frees.
+struct ring_packet {
+  struct pcap_pkthdr hdr;
+  u_char *big;
+  u_char data[SNAPLEN];
 };
 
 static const char *protocol_long_str[] = { IPOQUE_PROTOCOL_LONG_STRING };
@@ -59,7 +254,10 @@ static const char *protocol_long_str[] = { IPOQUE_PROTOCOL_LONG_STRING };
 struct str_cfg {
   int verbose;
   int type;
-  char filename[1000];
+  char **files;      // -r, may be given more than once
+  int num_files;
+  int next_file;     // next file to be taken by a reader
+  double replay_speed;
   char dev_name[1000];
   char pcap_filter[1000];
   pcap_t * pcap_dev;
@@ -69,12 +267,70 @@ struct str_cfg {
   
   RpcConnection rpc;
 
-  struct ipoque_detection_module_struct *ipoque_struct;
-
-  ///a hast structure to store state
-  hi_handle_t *hi_handle_ip; 
-  hi_handle_t *hi_handle_flows;
-
+  // packet processing threads, a single worker runs inline in pcap_loop
+  int num_workers;
+  unsigned long ring_size;
+  int batch_size;
+  struct osdpi_worker *workers;
+  // protocol selection and parameters of opendpi, read-only once set up
+  // and shared by the workers' detection modules
+  struct ipoque_detection_config_struct *dpi_cfg;
+  // port hints of the detection (-H), port=protocol pairs or none, on top
+  // of the defaults of opendpi
+  char *port_hints;
+
+  // detection budget of a flow without final result, 0 means unlimited
+  uint32_t detect_pkts;
+  uint32_t detect_bytes;
+
+  // memory budget of the flow and host tables (-M), in bytes, 0 for the
+  // MAX_OSDPI_FLOWS and MAX_OSDPI_IDS defaults; init() turns it into
+  // the object counts per worker
+  unsigned long table_mem;
+  unsigned long max_flows, max_hosts;
+  enum evict_policy evict_policy;
+
+  // flows go through detection only if in the 1 in `sample_rate' sample
+  // picked by their hash (-s), and, with `shedding' (-L), within the
+  // share of their worker; the others are only counted
+  unsigned sample_rate;
+  int shedding;
+
+  // fragment reassembly, in whichever thread parses the packets first
+  unsigned long frag_mem;
+  unsigned frag_timeout;
+  enum ipfrag_overlap frag_policy;
+  IPFrag capture_frags;  // the capture thread's when it feeds worker rings
+  struct thread_stats capture_stats;
+
+  // native AF_PACKET capture (-A), one TPACKET_V3 ring per worker
+  int afpacket;
+  unsigned afp_block_size;
+  unsigned afp_block_count;
+  int fanout_group;
+
+  // workers read their input themselves (AF_PACKET, or several files
+  // read in parallel), no capture thread and no rings
+  int workers_capture;
+  int capture_done;
+  unsigned long ring_drops;
+
+  flow_export_fn flow_export;
+  uint32_t export_interval;  // seconds, 0 exports flows only when they expire
+  Publisher publisher;
+
+  unsigned short stats_port;  // srpc port of the STATS service, 0 for none
+
+  // flow and host state saved at the end and restored at startup (-K);
+  // SIGTERM and SIGINT end the capture, see stop_capture()
+  char *checkpoint;
+  volatile sig_atomic_t stopping;
+
+#ifdef BENCHMARK
+  int bench_rounds;
+  char *bench_traffic;  // synthetic trace instead of files (-g), see trafgen.h
+  char *bench_pcap;     // write the synthetic trace to this file instead (-w)
+#endif
 };
 
 struct str_cfg obj_cfg;
@@ -87,297 +343,1240 @@ struct packet_header {
   struct iphdr *ip;
   struct udphdr *udp;
   struct tcphdr *tcp;
+  int l3_off;  // length of the link header, VLAN tags and MPLS labels included
+};
+
+// a packet of a batch, copied out of the pcap buffer together with the
+// results of the parse stage. Input that stays mapped is parsed in place,
+// `packet' then points into the mapping rather than at `data', one too long
+// for `data' is copied to `big', freed after the batch.
+struct batch_packet {
+  struct pcap_pkthdr pkthdr;
+  const u_char *packet;
+  u_char *big;
+  struct packet_header hdr;
+  struct hi_flow_key key;
+  uint32_t hash;
+  u_char data[SNAPLEN];
 };
 
-#define USAGE "./linklogger [-i device -f file -v]"
+#ifdef BENCHMARK
+#define BENCH_OPTIONS "R:g:w:"
+#define BENCH_USAGE " -R rounds -g traffic -w pcap_out"
+#else
+#define BENCH_OPTIONS ""
+#define BENCH_USAGE ""
+#endif
+
+#define USAGE "./linklogger [-i device -r file [-r file ...] -f filter -t threads " \
+  "-q ring_size -b batch -x speed -c detect_pkts -C detect_bytes " \
+  "-m frag_mem -M table_mem -E lru|unclassified|udp|none -s sample_rate -L -T frag_timeout -O first|last|drop -I export_interval -A -B block_size -N block_count -F fanout_group -S stats_port -K checkpoint -H none|port=protocol[,...]" BENCH_USAGE " -v]"
 
+#define ETHERTYPE_QINQ 0x88a8        // 802.1ad service tag
+#define ETHERTYPE_QINQ_OLD 0x9100    // pre-standard QinQ
+#define ETHERTYPE_MPLS 0x8847
+#define ETHERTYPE_MPLS_MCAST 0x8848
+#define MPLS_BOTTOM_OF_STACK 0x100
+
+// results of extract_headers()
+#define DECODE_DROP 0
+#define DECODE_OK 1
+#define DECODE_FRAGMENT 2  // an IPv4 fragment, the transport header is not parsed
 
 /*
- * A function to fill in a packet_header structure from a captured file
- * return 0 in case of problem during decompression.
+ * skip a VLAN tag, either the 802.1Q customer tag or a QinQ service tag
  */
-int 
-extract_headers(struct packet_header *hdr, uint8_t *data, int data_len) {
-  int ptr = 0;
-  
-  //extract ethernet header
-  if(data_len < ETHER_HDR_LEN) return 0;
-  hdr->ether = (struct ether_header *)data;
-  ptr += ETHER_HDR_LEN;
+static int
+decode_vlan(const uint8_t *data, int data_len, int *ptr, uint16_t *type) {
+  if(data_len < *ptr + 4) return 0;
+  *type = ntohs(*(const uint16_t *)(data + *ptr + 2));
+  *ptr += 4;
+  return 1;
+}
+
+/*
+ * skip an MPLS label stack; the label stack does not tell what it carries,
+ * the version nibble below the bottom label does
+ */
+static int
+decode_mpls(const uint8_t *data, int data_len, int *ptr, uint16_t *type) {
+  uint32_t label;
+
+  do {
+    if(data_len < *ptr + 4 || *ptr >= LINK_HDR_MAX) return 0;
+    label = ntohl(*(const uint32_t *)(data + *ptr));
+    *ptr += 4;
+  } while(!(label & MPLS_BOTTOM_OF_STACK));
+
+  if(data_len < *ptr + 1) return 0;
+  switch(data[*ptr] >> 4) {
+  case 4: *type = ETHERTYPE_IP; break;
+  case 6: *type = ETHERTYPE_IPV6; break;
+  default: *type = 0;  // pseudowire or anything else, not IP
+  }
+  return 1;
+}
 
-  if(ntohs(hdr->ether->ether_type) != ETHERTYPE_IP) return 0;
+// the encapsulations walked by extract_headers() in front of the IP header
+static const struct l2_decoder {
+  uint16_t ethertype;
+  int (*decode)(const uint8_t *data, int data_len, int *ptr, uint16_t *type);
+  enum decode_counter counter;
+} l2_decoders[] = {
+  { ETHERTYPE_VLAN,       decode_vlan, DECODE_VLAN },
+  { ETHERTYPE_QINQ,       decode_vlan, DECODE_QINQ },
+  { ETHERTYPE_QINQ_OLD,   decode_vlan, DECODE_QINQ },
+  { ETHERTYPE_MPLS,       decode_mpls, DECODE_MPLS },
+  { ETHERTYPE_MPLS_MCAST, decode_mpls, DECODE_MPLS },
+};
+#define NUM_L2_DECODERS (sizeof(l2_decoders) / sizeof(l2_decoders[0]))
 
-  //extract ip headers
-  if(data_len < ptr + sizeof(struct iphdr)) return 0;
-  hdr->ip = (struct iphdr *)(data + ptr);
-  if(data_len < ptr + (hdr->ip->ihl)*4) return 0;  
-  ptr += hdr->ip->ihl*4;
+/*
+ * walk the IPv6 extension headers following the fixed header at `ptr' and
+ * count the transport they lead to. The packet is only counted: neither
+ * OpenDPI nor the flow key know IPv6.
+ */
+static int
+decode_ipv6(struct thread_stats *st, const uint8_t *data, int data_len, int ptr) {
+  uint8_t next;
+
+  STAT_INC(st, decode[DECODE_IPV6]);
+  if(data_len < ptr + 40) {
+    STAT_INC(st, decode[DECODE_TRUNCATED]);
+    return DECODE_DROP;
+  }
+  next = data[ptr + 6];
+  ptr += 40;
+
+  for(;;) {
+    switch(next) {
+    case IPPROTO_HOPOPTS:
+    case IPPROTO_ROUTING:
+    case IPPROTO_DSTOPTS:
+    case IPPROTO_FRAGMENT:
+    case IPPROTO_AH:
+      break;
+    case IPPROTO_TCP:
+      STAT_INC(st, decode[DECODE_IPV6_TCP]);
+      return DECODE_DROP;
+    case IPPROTO_UDP:
+      STAT_INC(st, decode[DECODE_IPV6_UDP]);
+      return DECODE_DROP;
+    default:
+      // other transport, ESP or no next header
+      STAT_INC(st, decode[DECODE_IPV6_OTHER_L4]);
+      return DECODE_DROP;
+    }
+    if(data_len < ptr + 8) {
+      STAT_INC(st, decode[DECODE_TRUNCATED]);
+      return DECODE_DROP;
+    }
+    STAT_INC(st, decode[DECODE_IPV6_EXT]);
+    if(next == IPPROTO_FRAGMENT) {
+      // only the first fragment carries the transport header
+      if(ntohs(*(const uint16_t *)(data + ptr + 2)) & 0xfff8)
+	return DECODE_DROP;
+      next = data[ptr];
+      ptr += 8;
+    } else if(next == IPPROTO_AH) {
+      next = data[ptr];
+      ptr += (data[ptr + 1] + 2) * 4;
+    } else {
+      next = data[ptr];
+      ptr += (data[ptr + 1] + 1) * 8;
+    }
+  }
+}
+
+/*
+ * fill in the transport header of an IPv4 packet whose IP header is known
+ */
+static int
+extract_l4(struct thread_stats *st, struct packet_header *hdr, uint8_t *data, int data_len) {
+  int ptr = hdr->l3_off + hdr->ip->ihl*4;
 
-  //extract tcp/udp header
+  hdr->tcp = NULL;
+  hdr->udp = NULL;
   if(hdr->ip->protocol == 6) { //TCP packet
-    if(data_len < ptr + sizeof(struct tcphdr)) return 0;
+    if(data_len < ptr + sizeof(struct tcphdr)) goto truncated;
     hdr->tcp = (struct tcphdr *)(data + ptr);
     
   } else if(hdr->ip->protocol == 17) { //UDP packet
-    if(data_len < ptr + sizeof(struct udphdr)) return 0;
+    if(data_len < ptr + sizeof(struct udphdr)) goto truncated;
     hdr->udp = (struct udphdr *)(data + ptr);
-  } else 
-    return 0;
-  return 1;
+  } else {
+    STAT_INC(st, decode[DECODE_OTHER_L4]);
+    return DECODE_DROP;
+  }
+  return DECODE_OK;
+
+ truncated:
+  STAT_INC(st, decode[DECODE_TRUNCATED]);
+  return DECODE_DROP;
 }
 
-static void 
-*get_id(const u8 * ip) {
-  uint32_t i, res;
-  char str_ip[20];
-  struct in_addr addr;
-  struct osdpi_id *data;
+/*
+ * A function to fill in a packet_header structure from a captured file.
+ * Plain IPv4 over ethernet goes straight to the IP header, VLAN tags and
+ * MPLS labels are walked through l2_decoders first.
+ * return DECODE_DROP if the packet is of no use to detection,
+ * DECODE_FRAGMENT for an IPv4 fragment and DECODE_OK otherwise.
+ */
+int 
+extract_headers(struct thread_stats *st, struct packet_header *hdr, uint8_t *data, int data_len) {
+  const struct l2_decoder *d;
+  int ptr = ETHER_HDR_LEN;
+  uint16_t type;
+  
+  STAT_INC(st, packets);
+  STAT_ADD(st, bytes, data_len);
+
+  //extract ethernet header
+  if(data_len < ETHER_HDR_LEN) goto truncated;
+  hdr->ether = (struct ether_header *)data;
+  type = ntohs(hdr->ether->ether_type);
+
+  while(type != ETHERTYPE_IP) {
+    for(d = l2_decoders; d < l2_decoders + NUM_L2_DECODERS; d++)
+      if(d->ethertype == type)
+	break;
+    if(d == l2_decoders + NUM_L2_DECODERS) {
+      if(type == ETHERTYPE_IPV6)
+	return decode_ipv6(st, data, data_len, ptr);
+      STAT_INC(st, decode[DECODE_NON_IP]);
+      return DECODE_DROP;
+    }
+    STAT_INC(st, decode[d->counter]);
+    if(!d->decode(data, data_len, &ptr, &type) || ptr > LINK_HDR_MAX) goto truncated;
+  }
+  hdr->l3_off = ptr;
+  STAT_INC(st, decode[DECODE_IPV4]);
+
+  //extract ip headers
+  if(data_len < ptr + sizeof(struct iphdr)) goto truncated;
+  hdr->ip = (struct iphdr *)(data + ptr);
+  if(hdr->ip->ihl < 5 || data_len < ptr + (hdr->ip->ihl)*4) goto truncated;
+
+  if(IPFRAG_IS_FRAGMENT(hdr->ip)) {
+    STAT_INC(st, decode[DECODE_IPV4_FRAGMENT]);
+    return DECODE_FRAGMENT;
+  }
+  return extract_l4(st, hdr, data, data_len);
+
+ truncated:
+  STAT_INC(st, decode[DECODE_TRUNCATED]);
+  return DECODE_DROP;
+}
+
+/*
+ * run the IPv4 fragment `hdr' was decoded from through reassembler
+ * `frags'. Returns DECODE_DROP if it did not complete its datagram;
+ * otherwise `pkthdr' and `packet' now point at `reasm' and at the datagram
+ * in the reassembler's buffer (valid until its next fragment), with the
+ * link header of the last fragment in front, and `hdr' describes it.
+ */
+static int
+defragment(IPFrag frags, struct thread_stats *st, const struct pcap_pkthdr **pkthdr, 
+	   struct pcap_pkthdr *reasm, const u_char **packet, struct packet_header *hdr) {
+  unsigned char *dgram;
+  unsigned len;
+
+  len = ipfrag_add(frags, hdr->ip, (*pkthdr)->caplen - hdr->l3_off, (*pkthdr)->ts.tv_sec, &dgram);
+  if(len == 0)
+    return DECODE_DROP;
+  STAT_INC(st, reassembled);
+  memcpy(dgram - hdr->l3_off, *packet, hdr->l3_off);
+  reasm->ts = (*pkthdr)->ts;
+  reasm->caplen = reasm->len = len + hdr->l3_off;
+  *pkthdr = reasm;
+  *packet = dgram - hdr->l3_off;
+  hdr->ether = (struct ether_header *)*packet;
+  hdr->ip = (struct iphdr *)dgram;
+  return extract_l4(st, hdr, (uint8_t *)*packet, reasm->caplen);
+}
 
-  addr.s_addr = ip;
+static void
+host_lru_unlink(struct osdpi_worker *w, struct osdpi_host *host) {
+  if(host->lru_prev) host->lru_prev->lru_next = host->lru_next;
+  else w->host_lru_head = host->lru_next;
+  if(host->lru_next) host->lru_next->lru_prev = host->lru_prev;
+  else w->host_lru_tail = host->lru_prev;
+}
+
+static void
+host_lru_append(struct osdpi_worker *w, struct osdpi_host *host) {
+  host->lru_next = NULL;
+  host->lru_prev = w->host_lru_tail;
+  if(w->host_lru_tail) w->host_lru_tail->lru_next = host;
+  else w->host_lru_head = host;
+  w->host_lru_tail = host;
+}
+
+/*
+ * return the per host opendpi state for an IPv4 address (network order),
+ * creating it on first sight. With the host pool exhausted the least
+ * recently seen host is dropped; opendpi only refers to host state while
+ * it handles a packet, so nothing else points to it.
+ */
+static void 
+*get_id(struct osdpi_worker *w, uint32_t ip) {
+  HostKey key;
+  struct osdpi_host *host;
 
-  sprintf(str_ip, "%s", inet_ntoa(addr));
-  res = hi_get_str(obj_cfg.hi_handle_ip, str_ip, (void *)&data);
+  hostkey_from_ipv4(&key, ip);
+  host = htable_lookup(w->hosts, &key);
 
   //if state found retrurn object
-  if(res == HI_ERR_SUCCESS) {
-    return data->ipoque_id;
+  if(host != NULL) {
+    if(host != w->host_lru_tail) {
+      host_lru_unlink(w, host);
+      host_lru_append(w, host);
+    }
+    return OSDPI_HOST_ID(host);
   } else {
     //if file not found create new state
-    data = malloc(sizeof(struct osdpi_id));
-    if(data == NULL) {
-      perror("malloc osdpi_id");
-      exit(1);
+    if((host = pool_alloc(w->host_pool)) == NULL) {
+      // the pool holds at least two hosts, so the source of the packet,
+      // looked up just before, is never the one to go
+      host = w->host_lru_head;
+      host_lru_unlink(w, host);
+      htable_remove(w->hosts, &host->key);
+      STAT_INC(&w->stats, hosts_evicted);
     }
-    memcpy(data->ip, ip, 4);
-    data->ipoque_id = calloc(1, ipoque_detection_get_sizeof_ipoque_id_struct());
-    if(data->ipoque_id == NULL) {
-      perror("malloc osdpi_id->ipoque_id");
+    host->key = key;
+    memset(OSDPI_HOST_ID(host), 0, ipoque_detection_get_sizeof_ipoque_id_struct());
+    if(!htable_insert(w->hosts, &host->key, host)) {
+      perror("htable_insert");
       exit(1);
     }
-    hi_insert_str(obj_cfg.hi_handle_ip, str_ip, data);
-    return  data->ipoque_id;
+    host_lru_append(w, host);
+    STAT_INC(&w->stats, hosts_created);
+    return OSDPI_HOST_ID(host);
   }
 }
 
-void
-garbadge_collect_osdpi_flows(uint32_t time ) {
-  hi_iterator_t *iter;
-  struct osdpi_flow *data;
-  char *key;
-  uint32_t len;
-  int res;
+/*
+ * format a flow key as "1.2.3.4:00080-5.6.7.8:01234-TCP" for logging
+ */
+static char *
+flow_key_to_str(const struct hi_flow_key *key, char *buf, size_t len) {
+  char lower_ip[INET_ADDRSTRLEN], upper_ip[INET_ADDRSTRLEN];
+
+  inet_ntop(AF_INET, &key->lower_ip, lower_ip, sizeof(lower_ip));
+  inet_ntop(AF_INET, &key->upper_ip, upper_ip, sizeof(upper_ip));
+  snprintf(buf, len, "%s:%05d-%s:%05d-%s", lower_ip, ntohs(key->lower_port),
+	   upper_ip, ntohs(key->upper_port), (key->protocol == 6)?"TCP":"UDP");
+  return buf;
+}
+
+/*
+ * default export callback: log the flow when running verbose
+ */
+static void
+log_flow(struct osdpi_worker *w, struct osdpi_flow *flow, uint64_t pkts, uint64_t bytes) {
+  char key_str[64];
+
+  if(!obj_cfg.verbose)
+    return;
+  flow_key_to_str(&flow->key, key_str, sizeof(key_str));
+  printf("worker %d flow %s : %llu %llu %u %u\n", w->id, key_str, (unsigned long long)bytes,
+	 (unsigned long long)pkts, flow->first_pkt, flow->last_pkt);
+}
+
+/*
+ * export callback when publishing to the database: queue a record for the
+ * publisher thread, dropping it rather than stalling the packet path. At
+ * the end of the capture every flow is worth the wait.
+ */
+static void
+publish_flow(struct osdpi_worker *w, struct osdpi_flow *flow, uint64_t pkts, uint64_t bytes) {
+  FlowRecord r;
+
+  log_flow(w, flow, pkts, bytes);
+  r.proto = flow->key.protocol;
+  r.saddr = flow->key.lower_ip;
+  r.sport = flow->key.lower_port;
+  r.daddr = flow->key.upper_ip;
+  r.dport = flow->key.upper_port;
+  r.packets = pkts;
+  r.bytes = bytes;
+  pub_enqueue(obj_cfg.publisher, w->id, &r, w->flushing);
+}
+
+/*
+ * Flows of a worker are kept on a list ordered by last_pkt: each packet
+ * moves its flow to the tail, so idle flows collect at the head and expiry
+ * never has to look past the first live flow.
+ */
+static inline void
+flow_lru_unlink(struct osdpi_worker *w, struct osdpi_flow *flow) {
+  if(flow->lru_prev) flow->lru_prev->lru_next = flow->lru_next;
+  else w->lru_head = flow->lru_next;
+  if(flow->lru_next) flow->lru_next->lru_prev = flow->lru_prev;
+  else w->lru_tail = flow->lru_prev;
+}
+
+static inline void
+flow_lru_append(struct osdpi_worker *w, struct osdpi_flow *flow) {
+  flow->lru_next = NULL;
+  flow->lru_prev = w->lru_tail;
+  if(w->lru_tail) w->lru_tail->lru_next = flow;
+  else w->lru_head = flow;
+  w->lru_tail = flow;
+}
 
-  printf("hash elements: %lu\n", hi_no_objects(obj_cfg.hi_handle_flows));
+/*
+ * Flows with packets since their last export are on the dirty list of
+ * their worker, so an interval export only visits active flows.
+ */
+static inline void
+flow_dirty_unlink(struct osdpi_worker *w, struct osdpi_flow *flow) {
+  if(flow->dirty_prev) flow->dirty_prev->dirty_next = flow->dirty_next;
+  else w->dirty_head = flow->dirty_next;
+  if(flow->dirty_next) flow->dirty_next->dirty_prev = flow->dirty_prev;
+  flow->dirty = 0;
+}
 
-  if( (res = hi_iterator_create(obj_cfg.hi_handle_flows, &iter)) != HI_SUCCESS) {
-    printf("Failed to init iterator: %s(%d)\n", hi_strerror(res), res);
+static inline void
+flow_mark_dirty(struct osdpi_worker *w, struct osdpi_flow *flow) {
+  if(flow->dirty)
     return;
+  flow->dirty_prev = NULL;
+  flow->dirty_next = w->dirty_head;
+  if(w->dirty_head) w->dirty_head->dirty_prev = flow;
+  w->dirty_head = flow;
+  flow->dirty = 1;
+}
+
+/*
+ * hand what a flow saw since its last export to the export callback
+ */
+static void
+export_flow(struct osdpi_worker *w, struct osdpi_flow *flow) {
+  uint64_t pkts = flow->pkt_count - flow->exported_pkts;
+  uint64_t bytes = flow->byte_count - flow->exported_bytes;
+
+  flow->exported_pkts = flow->pkt_count;
+  flow->exported_bytes = flow->byte_count;
+  obj_cfg.flow_export(w, flow, pkts, bytes);
+}
+
+/*
+ * interval export: every flow that changed since the last one
+ */
+static void
+export_dirty_flows(struct osdpi_worker *w) {
+  struct osdpi_flow *flow;
+
+  while((flow = w->dirty_head) != NULL) {
+    flow_dirty_unlink(w, flow);
+    export_flow(w, flow);
   }
+}
 
-  while(hi_iterator_getnext(iter, (void **)&data, (void **)&key, &len) == HI_SUCCESS ) {
-    if( time - data->last_pkt > CONNECTION_TIMEOUT) {
-      printf(">>>>>>>>> flow %s %d : %d %d %d %ld\n", key, len, data->byte_count, data->pkt_count, data->last_pkt);
-      hi_remove_str(obj_cfg.hi_handle_flows, key, &data);
-      free(data->ipoque_flow);
-      free(data);
-      //      printf("flow timed out\n");
-    } else {
-      printf("flow %s %d : %lu %lu %lu\n", key, len, data->byte_count, data->pkt_count, data->last_pkt);
-    }
+/*
+ * take a flow out of the flow table, export what is left of its counters
+ * and release it
+ */
+static void
+release_osdpi_flow(struct osdpi_worker *w, struct osdpi_flow *flow) {
+  void *data;
+
+  flow_lru_unlink(w, flow);
+  hi_remove_flow(w->hi_handle_flows, &flow->key, &data);
+  if(flow->dirty) {
+    flow_dirty_unlink(w, flow);
+    export_flow(w, flow);
+  }
+  pool_free(w->flow_pool, flow);
+}
+
+/*
+ * expire up to `budget' flows idle for more than CONNECTION_TIMEOUT
+ * seconds; the work is spread over the packets instead of scanning the
+ * whole table
+ */
+void
+expire_osdpi_flows(struct osdpi_worker *w, uint32_t time, int budget) {
+  while(budget-- > 0 && w->lru_head != NULL &&
+	time - w->lru_head->last_pkt > CONNECTION_TIMEOUT) {
+    release_osdpi_flow(w, w->lru_head);
+    STAT_INC(&w->stats, flows_expired);
+  }
+}
+
+/*
+ * release every flow of a worker, e.g. at the end of the capture
+ */
+void
+flush_osdpi_flows(struct osdpi_worker *w) {
+  // the flows live on in the checkpoint, they are exported once they
+  // expire after the restart
+  if(obj_cfg.checkpoint != NULL)
+    return;
+  w->flushing = 1;
+  while(w->lru_head != NULL) {
+    release_osdpi_flow(w, w->lru_head);
+    STAT_INC(&w->stats, flows_expired);
+  }
+  w->flushing = 0;
+}
+
+/*
+ * build the canonical binary flow key of a parsed packet, ports stay in
+ * network byte order
+ */
+static void
+packet_flow_key(const struct packet_header *hdr, struct hi_flow_key *key) {
+  if (hdr->ip->protocol == 6) // tcp
+    hi_flow_key_init(key, hdr->ip->saddr, hdr->tcp->source, 
+		     hdr->ip->daddr, hdr->tcp->dest, hdr->ip->protocol);
+  else // udp
+    hi_flow_key_init(key, hdr->ip->saddr, hdr->udp->source, 
+		     hdr->ip->daddr, hdr->udp->dest, hdr->ip->protocol);
+}
+
+/*
+ * make room in the full flow pool for a new flow with key `key', following
+ * obj_cfg.evict_policy; the victim is exported and released like an
+ * expired flow
+ * returns 1 if a flow was evicted, 0 if the new flow is to be refused
+ */
+static int
+evict_osdpi_flow(struct osdpi_worker *w, const struct hi_flow_key *key) {
+  struct osdpi_flow *victim = w->lru_head;
+  struct osdpi_flow *flow;
+  int scan;
+
+  if(victim == NULL)
+    return 0;
+  switch(obj_cfg.evict_policy) {
+  case EVICT_LRU:
+    break;
+  case EVICT_UNCLASSIFIED:
+    // classified flows are cheap to keep, their packets bypass detection
+    for(flow = w->lru_head, scan = 0; flow != NULL && scan < EVICT_SCAN; 
+	flow = flow->lru_next, scan++)
+      if(flow->detected_protocol == IPOQUE_PROTOCOL_UNKNOWN) {
+	victim = flow;
+	break;
+      }
+    break;
+  case EVICT_UDP:
+    // scans and floods leave UDP flows of a single packet behind; if there
+    // is none to drop, a new UDP flow, a singleton so far, is not admitted
+    for(flow = w->lru_head, scan = 0; flow != NULL && scan < EVICT_SCAN; 
+	flow = flow->lru_next, scan++)
+      if(flow->key.protocol == IPPROTO_UDP && flow->pkt_count == 1)
+	break;
+    if(flow != NULL && scan < EVICT_SCAN)
+      victim = flow;
+    else if(key->protocol == IPPROTO_UDP)
+      return 0;
+    break;
+  case EVICT_NONE:
+    return 0;
   }
+  release_osdpi_flow(w, victim);
+  STAT_INC(&w->stats, flows_evicted);
+  return 1;
+}
+
+/*
+ * decide once, when a flow is created, whether it goes through detection
+ * or only gets its counters. The decision hangs on its 5-tuple alone, so
+ * a flow is either fully classified or not at all, and with -s the same
+ * flows are sampled on every run and every probe. The flow hash is mixed
+ * once more since its low bits already picked the worker.
+ */
+static inline int
+flow_skips_detection(struct osdpi_worker *w, const struct hi_flow_key *key) {
+  uint32_t h;
 
-   hi_iterator_fini(iter);
+  if(obj_cfg.sample_rate == 1 && w->stats.dpi_share >= SHED_SCALE)
+    return 0;
+  h = hi_hash_flow((const uint8_t *)key, sizeof(*key));
+  h ^= h >> 16;
+  h *= 0x85ebca6b;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35;
+  h ^= h >> 16;
+  if(h % obj_cfg.sample_rate != 0) {
+    STAT_INC(&w->stats, flows_sampled_out);
+    return 1;
+  }
+  if((h >> (32 - SHED_BITS)) >= w->stats.dpi_share) {
+    STAT_INC(&w->stats, flows_shed);
+    return 1;
+  }
+  return 0;
 }
 
 struct osdpi_flow *
-get_osdpi_flow(const struct packet_header *hdr, 
+get_osdpi_flow(struct osdpi_worker *w, const struct hi_flow_key *key, 
 					 u16 ipsize, uint32_t time)
 {
   int res;
-  char lower_ip[20], upper_ip[20];
-  struct in_addr addr;
-  u16 lower_port, upper_port;
   struct osdpi_flow *data;
-  static uint32_t timer= 0;
 
-  if(timer == 0) {
-    timer = time;
-  } else if(time - timer > CLEANUP_TIMEOUT) {
-    printf("Cleaning up state\n");
-   garbadge_collect_osdpi_flows(time);
-    timer =time;
+  expire_osdpi_flows(w, time, EXPIRE_BUDGET);
+  ipfrag_expire(w->frags, time);
+  if(obj_cfg.export_interval && (int32_t)(time - w->next_export) >= 0) {
+    if(w->next_export)
+      export_dirty_flows(w);
+    w->next_export = time + obj_cfg.export_interval;
   }
 
-  //XXX.XXX.XXX.XXX:XXXXX-XXX.XXX.XXX.XXX:XXXXX-XXX
-  char *flow_key;
-  flow_key = malloc(50*sizeof(char));
-
-  if (hdr->ip->saddr < hdr->ip->daddr) {
-    addr.s_addr = hdr->ip->saddr;
-    sprintf(lower_ip, "%s", inet_ntoa(addr));
-    addr.s_addr = hdr->ip->daddr;
-    sprintf(upper_ip, "%s", inet_ntoa(addr));
-  } else {
-    addr.s_addr = hdr->ip->saddr;
-    sprintf(upper_ip, "%s", inet_ntoa(addr));
-    addr.s_addr = hdr->ip->daddr;
-    sprintf(lower_ip, "%s", inet_ntoa(addr));
-  }
-  
-  if (hdr->ip->protocol == 6) { // tcp
-    if (hdr->ip->saddr < hdr->ip->daddr) 
-      snprintf(flow_key, 50, "%s:%05d-%s:%05d-TCP", lower_ip, ntohs(hdr->tcp->source),
-	       upper_ip, ntohs(hdr->tcp->dest));
-    else
-      snprintf(flow_key, 50, "%s:%05d-%s:%05d-TCP", lower_ip, ntohs(hdr->tcp->dest),
-	       upper_ip, ntohs(hdr->tcp->source));
-  } else if (hdr->ip->protocol == 17) {// udp
-    if (hdr->ip->saddr < hdr->ip->daddr) 
-      snprintf(flow_key, 50, "%s:%05d-%s:%05d-UDP", lower_ip, ntohs(hdr->udp->source), 
-	       upper_ip, ntohs(hdr->udp->dest));
-    else
-      snprintf(flow_key, 50, "%s:%05d-%s:%05d-UDP", lower_ip, ntohs(hdr->udp->dest), 
-	       upper_ip, ntohs(hdr->udp->source));
-    
-  } 
-  
-  res = hi_get_str(obj_cfg.hi_handle_flows, flow_key, (void **)&data);  
+  res = hi_get_flow(w->hi_handle_flows, key, (void **)&data);  
   //if state found retrurn object
   if(res == HI_ERR_SUCCESS) {
     data->byte_count += ipsize;
     data->pkt_count++;
     data->last_pkt = time;
-    //printf("Flow %s found with pkts %d\n", flow_key, data->pkt_count);
+    flow_mark_dirty(w, data);
+    if(data != w->lru_tail) {
+      flow_lru_unlink(w, data);
+      flow_lru_append(w, data);
+    }
     return data;
   } else {
-    //if file not found create new state
-    data = malloc(sizeof(struct osdpi_flow));
+    //if file not found create new state, unless the pool is exhausted
+    //in which case the packet goes through detection without flow state
+    data = pool_alloc(w->flow_pool);
+    if(data == NULL && evict_osdpi_flow(w, key))
+      data = pool_alloc(w->flow_pool);
     if(data == NULL) {
-      perror("malloc osdpi_flow");
-      exit(1);
+      STAT_INC(&w->stats, flows_refused);
+      return NULL;
     }
     
-    //    printf("Flow %s created\n", flow_key);
+    data->key = *key;
     data->byte_count = ipsize;
     data->pkt_count = 1;
+    data->exported_bytes = data->exported_pkts = 0;
     data->first_pkt = time;
     data->last_pkt = time;
-    data->ipoque_flow = calloc(1, ipoque_detection_get_sizeof_ipoque_flow_struct());
-    if(data->ipoque_flow == NULL) {
-      perror("malloc osdpi_id->ipoque_id");
-      exit(1);
-    }
-    hi_insert_str(obj_cfg.hi_handle_flows, flow_key, data);
+    data->dirty = 0;
+    flow_mark_dirty(w, data);
+    data->detected_protocol = IPOQUE_PROTOCOL_UNKNOWN;
+    data->detection_done = flow_skips_detection(w, key);
+    data->ipoque_flow = (struct ipoque_flow_struct *)((u8 *)data + OSDPI_FLOW_SIZE);
+    memset(data->ipoque_flow, 0, ipoque_detection_get_sizeof_ipoque_flow_struct());
+    // the hash keeps a pointer to the key, so insert the copy owned by data
+    hi_insert_flow(w->hi_handle_flows, &data->key, data);
+    flow_lru_append(w, data);
+    STAT_INC(&w->stats, flows_created);
     return  data;
   }
 }
 
-void 
-process_packet(u_char *args, const struct pcap_pkthdr* pkthdr, const u_char* packet) {
-  struct packet_header hdr;
-  char src_ip[20], dst_ip[20];
-  struct in_addr addr;
-
+/*
+ * the per packet work after the parse stage: host and flow lookups and
+ * detection
+ */
+static void
+detect_packet(struct osdpi_worker *w, const struct pcap_pkthdr* pkthdr, 
+	      const struct packet_header *hdr, const struct hi_flow_key *key) {
   struct ipoque_id_struct *src = NULL;
   struct ipoque_id_struct *dst = NULL;
   struct osdpi_flow *flow = NULL;
   struct ipoque_flow_struct *ipq_flow = NULL;
   u32 protocol = 0;
-  
-  if(extract_headers(&hdr,(uint8_t *)packet, pkthdr->caplen) == 0) {
-    //printf("Failed to parse header information\n");
-    return;
-  }
-
-  addr.s_addr=hdr.ip->saddr;
-  strcpy(src_ip, (char *)inet_ntoa(addr));
-  addr.s_addr=hdr.ip->daddr;
-  strcpy(dst_ip, (char *)inet_ntoa(addr));
+  u16 ipsize = pkthdr->caplen - hdr->l3_off;
 
-  src = get_id((u8 *) & hdr.ip->saddr);
-  dst = get_id((u8 *) & hdr.ip->daddr);
-
-  flow = get_osdpi_flow(&hdr, pkthdr->caplen - ETHER_HDR_LEN, pkthdr->ts.tv_sec);
+  STAGE_START(t_flow);
+  flow = get_osdpi_flow(w, key, ipsize, pkthdr->ts.tv_sec);
+  STAGE_END(w, STAGE_FLOW, t_flow);
   if (flow != NULL) {
+    if (flow->detection_done) {
+      // nothing left to learn, the flow lookup above was all there is to do
+      STAT_INC(&w->stats, pkts_bypassed);
+      STAT_INC(&w->stats, proto_packets[flow->detected_protocol]);
+      STAT_ADD(&w->stats, proto_bytes[flow->detected_protocol], ipsize);
+      return;
+    }
     ipq_flow = flow->ipoque_flow;
   }
 
-  if ((hdr.ip->frag_off & htons(0x1FFF)) == 0) {
+  STAGE_START(t_host);
+  src = get_id(w, hdr->ip->saddr);
+  dst = get_id(w, hdr->ip->daddr);
+  STAGE_END(w, STAGE_HOST, t_host);
+
+  // fragments never get here, see defragment()
+  {
     uint64_t time =((((uint64_t) pkthdr->ts.tv_sec)*1000) + pkthdr->ts.tv_usec/1000);
     // here the actual detection is performed
-    protocol = ipoque_detection_process_packet(obj_cfg.ipoque_struct, ipq_flow, (uint8_t *) hdr.ip, 
-					       pkthdr->caplen - ETHER_HDR_LEN, time, src, dst);
+    STAGE_START(t_detect);
+    protocol = ipoque_detection_process_packet(w->ipoque_struct, ipq_flow, (uint8_t *) hdr->ip, 
+					       ipsize, time, src, dst);
+    STAGE_END(w, STAGE_DETECT, t_detect);
+#ifdef STAGE_TIMING
+    lhist_record(&w->proto_timing[protocol], lhist_now() - t_detect);
+#endif
+    STAT_INC(&w->stats, detect_calls);
+    STAT_INC(&w->stats, proto_packets[protocol]);
+    STAT_ADD(&w->stats, proto_bytes[protocol], ipsize);
+    if (flow != NULL) {
+      int over_budget = (obj_cfg.detect_pkts && flow->pkt_count >= obj_cfg.detect_pkts) ||
+	(obj_cfg.detect_bytes && flow->byte_count >= obj_cfg.detect_bytes);
+
+      if (protocol != IPOQUE_PROTOCOL_UNKNOWN) {
+	if (flow->detected_protocol == IPOQUE_PROTOCOL_UNKNOWN)
+	  STAT_INC(&w->stats, flows_classified);
+	flow->detected_protocol = protocol;
+	// a refinable protocol, HTTP say, may still turn into one of its
+	// sub-protocols on later packets; only a final one ends detection
+	if (ipoque_detection_is_final(w->ipoque_struct) || over_budget)
+	  flow->detection_done = 1;
+      } else if (over_budget) {
+	flow->detection_done = 1;
+	STAT_INC(&w->stats, flows_unknown);
+      }
+    }
     
-/*     if(hdr.ip->protocol == 6) //TCP packet */
-/*       //      printf("New packet received: %s:%d-%s:%d-TCP >>> %s\n", src_ip, ntohs(hdr.tcp->source),  */
-/*       //	     dst_ip,ntohs(hdr.tcp->dest),protocol_long_str[protocol]); */
+/*     if(hdr->ip->protocol == 6) //TCP packet */
+/*       //      printf("New packet received: %s:%d-%s:%d-TCP >>> %s\n", src_ip, ntohs(hdr->tcp->source),  */
+/*       //	     dst_ip,ntohs(hdr->tcp->dest),protocol_long_str[protocol]); */
 /*     else */
-/*       printf("New packet received: %s:%d-%s:%d-UDP >>>> %s\n", src_ip, ntohs(hdr.udp->source),  */
-/* 	     dst_ip, ntohs(hdr.udp->dest),protocol_long_str[protocol]); */
-  } else {
-    static u8 frag_warning_used = 0;
-    if (frag_warning_used == 0) {
-      printf("\n\nWARNING: fragmented ip packets are not supported and will be skipped \n\n");
-      sleep(2);
-      frag_warning_used = 1;
-    }
+/*       printf("New packet received: %s:%d-%s:%d-UDP >>>> %s\n", src_ip, ntohs(hdr->udp->source),  */
+/* 	     dst_ip, ntohs(hdr->udp->dest),protocol_long_str[protocol]); */
+  }
+}
+
+/*
+ * pcap callback doing the actual per packet work; `args' is the worker
+ * owning the state the packet is accounted to
+ */
+void 
+process_packet(u_char *args, const struct pcap_pkthdr* pkthdr, const u_char* packet) {
+  struct osdpi_worker *w = (struct osdpi_worker *)args;
+  struct packet_header hdr;
+  struct hi_flow_key key;
+  struct pcap_pkthdr reasm;
+  int res;
+  
+  STAGE_START(t_decode);
+  res = extract_headers(&w->stats, &hdr,(uint8_t *)packet, pkthdr->caplen);
+  STAGE_END(w, STAGE_DECODE, t_decode);
+  switch(res) {
+  case DECODE_DROP:
+    //printf("Failed to parse header information\n");
     return;
+  case DECODE_FRAGMENT:
+    if(!defragment(w->frags, &w->stats, &pkthdr, &reasm, &packet, &hdr))
+      return;
   }
+  packet_flow_key(&hdr, &key);
+  detect_packet(w, pkthdr, &hdr, &key);
 }
 
+/*
+ * point the headers decoded from `from' at the same bytes in the copy `to'
+ */
+static void
+move_headers(struct packet_header *hdr, const u_char *from, u_char *to) {
+  hdr->ether = (struct ether_header *)to;
+  hdr->ip = (struct iphdr *)(to + ((const u_char *)hdr->ip - from));
+  if(hdr->tcp != NULL)
+    hdr->tcp = (struct tcphdr *)(to + ((const u_char *)hdr->tcp - from));
+  if(hdr->udp != NULL)
+    hdr->udp = (struct udphdr *)(to + ((const u_char *)hdr->udp - from));
+}
 
 /*
- * Initialize the configuration structure
+ * Batched ingest: pcap_dispatch() hands up to batch_size packets to
+ * batch_collect(), which copies each one, parses it, hashes its flow key
+ * and prefetches the flow table bucket. process_batch() then prefetches
+ * the bucket chains and host slots of the whole batch before it runs the
+ * lookups and detection, so the cache misses of consecutive packets
+ * overlap instead of being paid one after the other.
  */
-void
-init_cfg() {
+static void
+batch_collect(u_char *args, const struct pcap_pkthdr* pkthdr, const u_char* packet) {
+  struct osdpi_worker *w = (struct osdpi_worker *)args;
+  struct batch_packet *b = &w->batch[w->batch_len];
+  struct pcap_pkthdr reasm;
+  u_char *to;
   int res;
 
-  obj_cfg.verbose = 0;
-  obj_cfg.type = DEVICE_CAPTURE;
-  strcpy(obj_cfg.dev_name, "eth0");
-  strcpy(obj_cfg.pcap_filter, "udp or tcp");
-  obj_cfg.ipoque_struct= NULL;
+  STAGE_START(t_decode);
+  res = extract_headers(&w->stats, &b->hdr, (uint8_t *)packet, pkthdr->caplen);
+  STAGE_END(w, STAGE_DECODE, t_decode);
+  switch(res) {
+  case DECODE_DROP:
+    return;
+  case DECODE_FRAGMENT:
+    if(!defragment(w->frags, &w->stats, &pkthdr, &reasm, &packet, &b->hdr))
+      return;
+  }
+  b->pkthdr = *pkthdr;
+  b->big = NULL;
+  // a reassembled datagram only lives until the next fragment
+  if(w->batch_in_place && pkthdr != &reasm) {
+    b->packet = packet;
+  } else {
+    // IP checks the whole datagram, so nothing may be cut off
+    if(b->pkthdr.caplen > SNAPLEN && (b->big = malloc(b->pkthdr.caplen)) == NULL)
+      return;
+    to = b->big ? b->big : b->data;
+    memcpy(to, packet, b->pkthdr.caplen);
+    move_headers(&b->hdr, packet, to);
+    b->packet = to;
+  }
+  packet_flow_key(&b->hdr, &b->key);
+  b->hash = hi_hash_flow((uint8_t *)&b->key, sizeof(b->key));
+  hi_prefetch_bucket(w->hi_handle_flows, b->hash);
+  w->batch_len++;
+}
 
-  hi_init_str(&obj_cfg.hi_handle_ip, 93563);
+static void
+process_batch(struct osdpi_worker *w) {
+  struct batch_packet *b;
+  int i;
 
-  if( (res = hi_init_str(&obj_cfg.hi_handle_flows, 93563)) != HI_SUCCESS) {
-    printf("Failed to init flow_hasr: %s\n", hi_strerror(res));
-    exit(1);
+  for (i = 0; i < w->batch_len; i++) {
+    b = &w->batch[i];
+    hi_prefetch_chain(w->hi_handle_flows, b->hash);
+    htable_prefetch_ipv4(w->hosts, b->hdr.ip->saddr);
+    htable_prefetch_ipv4(w->hosts, b->hdr.ip->daddr);
   }
+  for (i = 0; i < w->batch_len; i++) {
+    b = &w->batch[i];
+    detect_packet(w, &b->pkthdr, &b->hdr, &b->key);
+    free(b->big);
+  }
+  w->batch_len = 0;
+}
 
-};
-
+/*
+ * capture loop of the batched, single threaded live mode
+ */
+static void
+batch_loop(struct osdpi_worker *w) {
+  int n;
+
+  do {
+    n = pcap_dispatch(obj_cfg.pcap_dev, obj_cfg.batch_size, batch_collect, (u_char *)w);
+    if(w->batch_len > 0)
+      process_batch(w);
+  } while(n >= 0);
+}
 
 /*
- * Parse the command line parameters and modify appropriately the config object
+ * open the next input file no reader has taken yet, NULL once all are
+ * taken. Files are mapped and read in place, see pcapfile.h.
  */
-int 
-parse_options(int argc, char *argv[]) {
-  int i, j, c;
-  //intiliaze program configuration object
-  init_cfg();
+static PcapFile
+open_next_file() {
+  char errbuf[PCAP_ERRBUF_SIZE];
+  PcapFile f;
+  int i;
 
-  
-  strcpy(obj_cfg.target, HWDB_SERVER_ADDR);
+  if(obj_cfg.stopping)
+    return NULL;
+  i = __atomic_fetch_add(&obj_cfg.next_file, 1, __ATOMIC_RELAXED);
+  if(i >= obj_cfg.num_files)
+    return NULL;
+  if (obj_cfg.verbose) 
+    printf("File is %s\n", obj_cfg.files[i]);
+  if((f = pcapfile_open(obj_cfg.files[i], errbuf)) == NULL) {
+    fprintf(stderr, "pcapfile_open(): %s\n", errbuf);
+    exit(1);
+  }
+  if(pcapfile_linktype(f) != DLT_EN10MB) {
+    fprintf(stderr, "%s: link type %d, only ethernet is supported\n", 
+	    obj_cfg.files[i], pcapfile_linktype(f));
+    exit(1);
+  }
+  if(strlen(obj_cfg.pcap_filter) > 0 && 
+     pcapfile_setfilter(f, obj_cfg.pcap_filter, errbuf) == -1) {
+    fprintf(stderr, "Error calling pcap_compile: $%s %s\n", obj_cfg.pcap_filter, errbuf);
+    exit(1);
+  }
+  pcapfile_setspeed(f, obj_cfg.replay_speed);
+  return f;
+}
+
+/*
+ * run all packets of an input file through worker `w'; the file stays
+ * mapped, so batches refer to the packets in place
+ */
+static void
+file_loop(struct osdpi_worker *w, PcapFile f) {
+  unsigned long packets, skipped;
+  int n;
+
+  if(obj_cfg.batch_size > 1) {
+    w->batch_in_place = 1;
+    do {
+      n = pcapfile_dispatch(f, obj_cfg.batch_size, batch_collect, (u_char *)w);
+      if(w->batch_len > 0)
+	process_batch(w);
+    } while(n > 0 && !obj_cfg.stopping);
+    w->batch_in_place = 0;
+  } else {
+    while((n = pcapfile_dispatch(f, FILE_CHUNK, process_packet, (u_char *)w)) > 0 &&
+	  !obj_cfg.stopping)
+      ;
+  }
+  if(n < 0)
+    fprintf(stderr, "worker %d: damaged record, rest of the file skipped\n", w->id);
+  if(obj_cfg.verbose) {
+    pcapfile_stats(f, &packets, &skipped);
+    fprintf(stderr, "worker %d: %lu packets read, %lu filtered\n", w->id, packets, skipped);
+  }
+}
+
+/*
+ * reader loop of a worker: take input files until none are left. Flows
+ * carry over between the files a worker reads one after the other; with
+ * several workers reading in parallel a flow spanning files read by
+ * different workers is reported by each of them.
+ */
+static void *
+file_capture(void *args) {
+  struct osdpi_worker *w = (struct osdpi_worker *)args;
+  PcapFile f;
+
+  while((f = open_next_file()) != NULL) {
+    file_loop(w, f);
+    pcapfile_close(f);
+  }
+  flush_osdpi_flows(w);
+  return NULL;
+}
+
+/*
+ * capture loop of a worker reading its own AF_PACKET ring; with several
+ * workers the rings share a fanout group and the kernel hashes flows
+ * onto them, so no packet crosses threads. Also usable as thread body.
+ */
+static void *
+afp_capture(void *args) {
+  struct osdpi_worker *w = (struct osdpi_worker *)args;
+  int n;
+
+  if(obj_cfg.batch_size > 1) {
+    do {
+      n = afp_dispatch(w->afp, obj_cfg.batch_size, batch_collect, (u_char *)w, 100);
+      if(w->batch_len > 0)
+	process_batch(w);
+    } while(n >= 0);
+  } else {
+    afp_loop(w->afp, process_packet, (u_char *)w);
+  }
+  flush_osdpi_flows(w);
+  return NULL;
+}
+
+/*
+ * pcap callback of the capture thread in threaded mode: pick the worker
+ * owning the flow and copy the packet into its ring. Packets that would be
+ * dropped by process_packet anyway never cross threads.
+ */
+void
+dispatch_packet(u_char *args, const struct pcap_pkthdr* pkthdr, const u_char* packet) {
+  struct packet_header hdr;
+  struct hi_flow_key key;
+  struct osdpi_worker *w;
+  struct ring_packet *slot;
+  struct pcap_pkthdr reasm;
+  u_char *big = NULL;
+
+  // reassemble here, the fragments of a datagram after the first carry no
+  // ports and could not be sent to the worker owning its flow
+  switch(extract_headers(&obj_cfg.capture_stats, &hdr,(uint8_t *)packet, pkthdr->caplen)) {
+  case DECODE_DROP:
+    return;
+  case DECODE_FRAGMENT:
+    if(!defragment(obj_cfg.capture_frags, &obj_cfg.capture_stats, &pkthdr, &reasm, 
+		   &packet, &hdr))
+      return;
+  }
+
+  // the key is canonical, so both directions land on the same worker
+  packet_flow_key(&hdr, &key);
+  w = &obj_cfg.workers[hi_hash_flow((uint8_t *)&key, sizeof(key)) % obj_cfg.num_workers];
+
+  // IP checks the whole datagram, so one longer than a slot is not cut off
+  if(pkthdr->caplen > SNAPLEN && (big = malloc(pkthdr->caplen)) == NULL)
+    return;
+  while((slot = spsc_reserve(w->ring)) == NULL) {
+    // a live capture must not stall, offline input must not lose packets
+    if(obj_cfg.type == DEVICE_CAPTURE) {
+      obj_cfg.ring_drops++;
+      free(big);
+      return;
+    }
+    sched_yield();
+  }
+  slot->hdr = *pkthdr;
+  slot->big = big;
+  memcpy(big ? big : slot->data, packet, pkthdr->caplen);
+  spsc_commit(w->ring);
+}
+
+/*
+ * shedding controller of a worker (-L): shrink the share of new flows that
+ * get detection quickly while the ring fills up, grow it back slowly once
+ * the worker catches up
+ */
+static void
+adapt_shedding(struct osdpi_worker *w) {
+  unsigned long fill = spsc_count(w->ring) * 100 / obj_cfg.ring_size;
+  unsigned long share = w->stats.dpi_share;
+
+  if(fill >= SHED_HIGH)
+    share = share / 2 > SHED_MIN ? share / 2 : SHED_MIN;
+  else if(fill <= SHED_LOW)
+    share = share + SHED_STEP < SHED_SCALE ? share + SHED_STEP : SHED_SCALE;
+  STAT_SET(&w->stats, dpi_share, share);
+}
+
+/*
+ * worker thread body: drain the ring until the capture thread is done
+ */
+static void *
+worker_loop(void *args) {
+  struct osdpi_worker *w = (struct osdpi_worker *)args;
+  struct ring_packet *slot;
+  int done;
+
+  for(;;) {
+    done = __atomic_load_n(&obj_cfg.capture_done, __ATOMIC_ACQUIRE);
+    if((slot = spsc_peek(w->ring)) != NULL) {
+      process_packet((u_char *)w, &slot->hdr, slot->big ? slot->big : slot->data);
+      free(slot->big);
+      spsc_release(w->ring);
+      if(obj_cfg.shedding && ++w->shed_count == SHED_PERIOD) {
+	adapt_shedding(w);
+	w->shed_count = 0;
+      }
+    } else if(done) {
+      flush_osdpi_flows(w);
+      break;
+    } else {
+      sched_yield();
+    }
+  }
+  return NULL;
+}
+
+
+/*
+ * Initialize the configuration structure
+ */
+void
+init_cfg() {
+  obj_cfg.verbose = 0;
+  obj_cfg.type = DEVICE_CAPTURE;
+  strcpy(obj_cfg.dev_name, "eth0");
+  // no filter by default: "udp or tcp" misses tagged and labelled frames,
+  // extract_headers() keeps to TCP and UDP anyway
+  strcpy(obj_cfg.pcap_filter, "");
+  obj_cfg.num_workers = 1;
+  obj_cfg.ring_size = DEFAULT_RING_SIZE;
+  obj_cfg.batch_size = 1;
+  obj_cfg.detect_pkts = DEFAULT_DETECT_PKTS;
+  obj_cfg.detect_bytes = 0;
+  obj_cfg.frag_mem = DEFAULT_FRAG_MEM;
+  obj_cfg.frag_timeout = DEFAULT_FRAG_TIMEOUT;
+  obj_cfg.frag_policy = IPFRAG_KEEP_FIRST;
+  obj_cfg.table_mem = 0;
+  obj_cfg.evict_policy = EVICT_LRU;
+  obj_cfg.sample_rate = 1;
+  obj_cfg.shedding = 0;
+  obj_cfg.capture_frags = NULL;
+  obj_cfg.afpacket = 0;
+  obj_cfg.afp_block_size = AFP_DEFAULT_BLOCK_SIZE;
+  obj_cfg.afp_block_count = AFP_DEFAULT_BLOCK_COUNT;
+  obj_cfg.fanout_group = -1;
+  obj_cfg.workers_capture = 0;
+  obj_cfg.files = NULL;
+  obj_cfg.num_files = 0;
+  obj_cfg.next_file = 0;
+  obj_cfg.replay_speed = 0;
+  obj_cfg.workers = NULL;
+  obj_cfg.capture_done = 0;
+  obj_cfg.ring_drops = 0;
+  obj_cfg.flow_export = log_flow;
+  obj_cfg.export_interval = 0;
+  obj_cfg.publisher = NULL;
+  obj_cfg.stats_port = 0;
+  obj_cfg.checkpoint = NULL;
+  obj_cfg.stopping = 0;
+  obj_cfg.port_hints = NULL;
+#ifdef BENCHMARK
+  obj_cfg.bench_rounds = BENCH_ROUNDS;
+  obj_cfg.bench_traffic = NULL;
+  obj_cfg.bench_pcap = NULL;
+#endif
+
+};
+
+
+/*
+ * Parse the command line parameters and modify appropriately the config object
+ */
+int 
+parse_options(int argc, char *argv[]) {
+  int i, j, c;
+  //intiliaze program configuration object
+  init_cfg();
+
+  
+  strcpy(obj_cfg.target, HWDB_SERVER_ADDR);
   obj_cfg.port = HWDB_SERVER_PORT;
 
-  while ((c = getopt (argc, argv, "f:r:i:v")) != -1) {
+  // every argument could be a -r
+  if ((obj_cfg.files = calloc(argc, sizeof(char *))) == NULL) {
+    perror("malloc files");
+    exit(1);
+  }
+
+  while ((c = getopt (argc, argv, "f:r:i:t:q:b:x:c:C:m:M:E:s:LT:O:I:AB:N:F:S:K:H:v" BENCH_OPTIONS)) != -1) {
     switch (c) {
     case 'f':
       strcpy(obj_cfg.pcap_filter, optarg);
       break;
     case 'r':
-      strcpy(obj_cfg.filename, optarg);
+      obj_cfg.files[obj_cfg.num_files++] = optarg;
       obj_cfg.type = FILE_CAPTURE;
       break;
     case 'i':
       strcpy(obj_cfg.dev_name, optarg);
       obj_cfg.type = DEVICE_CAPTURE;
       break;
+    case 't':
+      obj_cfg.num_workers = atoi(optarg);
+      if(obj_cfg.num_workers < 1 || obj_cfg.num_workers > MAX_WORKERS) {
+	printf("thread count must be within 1..%d\n", MAX_WORKERS);
+	exit(1);
+      }
+      break;
+    case 'q':
+      obj_cfg.ring_size = strtoul(optarg, NULL, 10);
+      if(obj_cfg.ring_size == 0) {
+	printf("invalid ring size %s\n", optarg);
+	exit(1);
+      }
+      break;
+    case 'b':
+      obj_cfg.batch_size = atoi(optarg);
+      if(obj_cfg.batch_size < 1 || obj_cfg.batch_size > MAX_BATCH) {
+	printf("batch size must be within 1..%d\n", MAX_BATCH);
+	exit(1);
+      }
+      break;
+    case 'c':
+      obj_cfg.detect_pkts = strtoul(optarg, NULL, 10);
+      break;
+    case 'C':
+      obj_cfg.detect_bytes = strtoul(optarg, NULL, 10);
+      break;
+    case 'm':
+      obj_cfg.frag_mem = strtoul(optarg, NULL, 10);
+      break;
+    case 'M':
+      obj_cfg.table_mem = strtoul(optarg, NULL, 10);
+      break;
+    case 'E':
+      for(i = 0; i <= EVICT_NONE; i++)
+	if(strcmp(optarg, evict_policy_str[i]) == 0)
+	  break;
+      if(i > EVICT_NONE) {
+	printf("eviction policy must be lru, unclassified, udp or none\n");
+	exit(1);
+      }
+      obj_cfg.evict_policy = i;
+      break;
+    case 's':
+      obj_cfg.sample_rate = strtoul(optarg, NULL, 10);
+      if(obj_cfg.sample_rate == 0) {
+	printf("invalid sample rate %s\n", optarg);
+	exit(1);
+      }
+      break;
+    case 'L':
+      obj_cfg.shedding = 1;
+      break;
+    case 'T':
+      obj_cfg.frag_timeout = strtoul(optarg, NULL, 10);
+      break;
+    case 'O':
+      if(strcmp(optarg, "first") == 0)
+	obj_cfg.frag_policy = IPFRAG_KEEP_FIRST;
+      else if(strcmp(optarg, "last") == 0)
+	obj_cfg.frag_policy = IPFRAG_KEEP_LAST;
+      else if(strcmp(optarg, "drop") == 0)
+	obj_cfg.frag_policy = IPFRAG_DROP;
+      else {
+	printf("overlap policy must be first, last or drop\n");
+	exit(1);
+      }
+      break;
+    case 'I':
+      obj_cfg.export_interval = strtoul(optarg, NULL, 10);
+      break;
+    case 'x':
+      obj_cfg.replay_speed = atof(optarg);
+      if(obj_cfg.replay_speed < 0) {
+	printf("invalid replay speed %s\n", optarg);
+	exit(1);
+      }
+      break;
+    case 'A':
+      obj_cfg.afpacket = 1;
+      break;
+    case 'B':
+      obj_cfg.afp_block_size = strtoul(optarg, NULL, 10);
+      if(obj_cfg.afp_block_size == 0 || obj_cfg.afp_block_size % getpagesize()) {
+	printf("block size must be a multiple of %d\n", getpagesize());
+	exit(1);
+      }
+      break;
+    case 'N':
+      obj_cfg.afp_block_count = strtoul(optarg, NULL, 10);
+      if(obj_cfg.afp_block_count == 0) {
+	printf("invalid block count %s\n", optarg);
+	exit(1);
+      }
+      break;
+    case 'F':
+      obj_cfg.fanout_group = atoi(optarg) & 0xffff;
+      break;
+    case 'S':
+      obj_cfg.stats_port = atoi(optarg);
+      if(obj_cfg.stats_port == 0) {
+	printf("invalid stats port %s\n", optarg);
+	exit(1);
+      }
+      break;
+    case 'K':
+      obj_cfg.checkpoint = optarg;
+      break;
+    case 'H':
+      obj_cfg.port_hints = optarg;
+      break;
     case 'v':
       obj_cfg.verbose = 1;
       break;
+#ifdef BENCHMARK
+    case 'R':
+      obj_cfg.bench_rounds = atoi(optarg);
+      if(obj_cfg.bench_rounds < 1) {
+	printf("invalid rounds %s\n", optarg);
+	exit(1);
+      }
+      break;
+    case 'g':
+      obj_cfg.bench_traffic = optarg;
+      break;
+    case 'w':
+      obj_cfg.bench_pcap = optarg;
+      break;
+#endif
     case 'h':
       printf("usage: %s\n", USAGE);
       exit(0);
@@ -386,6 +1585,34 @@ parse_options(int argc, char *argv[]) {
       exit(0);
     } 
   }
+#ifdef BENCHMARK
+  // the benchmark replays files or synthetic traffic on one worker, with
+  // nothing around it
+  if(obj_cfg.bench_traffic != NULL)
+    obj_cfg.type = FILE_CAPTURE;
+  if(obj_cfg.type != FILE_CAPTURE) {
+    printf("the benchmark only replays files (-r) or synthetic traffic (-g)\n");
+    exit(1);
+  }
+  obj_cfg.num_workers = 1;
+  obj_cfg.shedding = 0;
+  obj_cfg.stats_port = 0;
+  obj_cfg.checkpoint = NULL;
+#endif
+  // AF_PACKET only applies to live captures
+  if(obj_cfg.type != DEVICE_CAPTURE)
+    obj_cfg.afpacket = 0;
+  // several AF_PACKET workers always need a fanout group to share the device
+  if(obj_cfg.afpacket && obj_cfg.num_workers > 1 && obj_cfg.fanout_group < 0)
+    obj_cfg.fanout_group = getpid() & 0xffff;
+  // several files are spread over the workers, each reading its own
+  obj_cfg.workers_capture = obj_cfg.afpacket || 
+    (obj_cfg.type == FILE_CAPTURE && obj_cfg.num_workers > 1 && obj_cfg.num_files > 1);
+  // shedding watches the worker rings, only the threaded mode has them
+  if(obj_cfg.shedding && (obj_cfg.num_workers == 1 || obj_cfg.workers_capture)) {
+    fprintf(stderr, "load shedding (-L) needs worker rings (-t), ignored\n");
+    obj_cfg.shedding = 0;
+  }
 }
 
 
@@ -418,6 +1645,733 @@ debug_printf(u32 protocol, void *id_struct, ipq_log_level_t log_level,
 #endif
 }
 
+/*
+ * print the counters of a fragment reassembler
+ */
+static void
+print_frag_stats(const char *owner, IPFrag frags) {
+  IPFragStats st;
+
+  ipfrag_stats(frags, &st);
+  fprintf(stderr, "%s fragments: %lu seen, %lu datagrams reassembled, %lu timed out, "
+	  "%lu evicted, %lu overlapping, %lu dropped, %lu in progress, peak %lu bytes\n",
+	  owner, st.fragments, st.reassembled, st.timeouts, st.evicted, st.overlaps,
+	  st.dropped, st.in_progress, st.mem_peak);
+}
+
+/*
+ * print the per encapsulation counters of a decoder, those that counted
+ * anything
+ */
+static void
+print_decode_stats(const char *owner, const struct thread_stats *st) {
+  int i;
+
+  fprintf(stderr, "%s decoder:", owner);
+  for(i = 0; i < MAX_DECODE_COUNTER; i++)
+    if(st->decode[i])
+      fprintf(stderr, " %lu %s", st->decode[i], decode_counter_str[i]);
+  fprintf(stderr, "\n");
+}
+
+/*
+ * print the flow pool occupancy and detection counters of a worker
+ */
+static void
+print_worker_stats(struct osdpi_worker *w) {
+  char owner[32];
+  PoolStats st;
+  unsigned long kpackets, kdrops;
+
+  snprintf(owner, sizeof(owner), "worker %d", w->id);
+  if(w->afp != NULL && afp_stats(w->afp, &kpackets, &kdrops) == 0)
+    fprintf(stderr, "worker %d kernel ring: %lu packets, %lu dropped\n", w->id, kpackets, kdrops);
+  print_decode_stats(owner, &w->stats);
+  print_frag_stats(owner, w->frags);
+
+  fprintf(stderr, "worker %d detection: %lu flows classified, %lu given up, "
+	  "%lu packets bypassed\n", w->id, w->stats.flows_classified, w->stats.flows_unknown,
+	  w->stats.pkts_bypassed);
+  if(obj_cfg.sample_rate > 1 || obj_cfg.shedding)
+    fprintf(stderr, "worker %d sampling: %lu flows sampled out, %lu shed, detection share %lu/%u\n", 
+	    w->id, w->stats.flows_sampled_out, w->stats.flows_shed, w->stats.dpi_share, SHED_SCALE);
+
+  pool_stats(w->flow_pool, &st);
+  fprintf(stderr, "worker %d flow pool: %lu/%lu in use, peak %lu, %lu free, "
+	  "%lu slabs of %lu x %lu bytes, %lu failed allocations\n", w->id, 
+	  st.in_use, st.capacity, st.peak, st.free, st.slabs, 
+	  (unsigned long)FLOW_SLAB_OBJS, st.objsize, st.failures);
+  fprintf(stderr, "worker %d flow table: %lu created, %lu expired, %lu evicted, "
+	  "%lu admissions refused\n", w->id, w->stats.flows_created, w->stats.flows_expired,
+	  w->stats.flows_evicted, w->stats.flows_refused);
+
+  pool_stats(w->host_pool, &st);
+  fprintf(stderr, "worker %d host pool: %lu/%lu in use, peak %lu, %lu evicted\n", 
+	  w->id, st.in_use, st.capacity, st.peak, w->stats.hosts_evicted);
+}
+
+#ifdef STAGE_TIMING
+/*
+ * format one line of percentiles of `h' labelled `what'; returns its length
+ */
+static unsigned
+format_lhist(char *buf, unsigned size, const char *what, const LHist *h) {
+  double cpn = lhist_cycles_per_ns();
+  uint64_t p50 = lhist_quantile(h, 0.5), p99 = lhist_quantile(h, 0.99), 
+    p999 = lhist_quantile(h, 0.999), max = lhist_quantile(h, 1.0);
+
+  return snprintf(buf, size, "timing %s: %llu samples, p50 %llu p99 %llu p999 %llu "
+		  "max %llu cycles (%.0f/%.0f/%.0f/%.0f ns)\n", what, 
+		  (unsigned long long)lhist_total(h), (unsigned long long)p50, 
+		  (unsigned long long)p99, (unsigned long long)p999, (unsigned long long)max,
+		  p50 / cpn, p99 / cpn, p999 / cpn, max / cpn);
+}
+
+/*
+ * format the stage histograms merged over all workers, then the detection
+ * stage by protocol; returns the length
+ */
+static unsigned
+format_timing(char *buf, unsigned size) {
+  LHist h;
+  char what[64];
+  unsigned len = 0;
+  int i, j;
+
+  for(i = 0; i < MAX_STAGE && len < size; i++) {
+    memset(&h, 0, sizeof(h));
+    for(j = 0; j < obj_cfg.num_workers; j++)
+      lhist_merge(&h, &obj_cfg.workers[j].timing[i]);
+    len += format_lhist(buf + len, size - len, stage_str[i], &h);
+  }
+  for(i = 0; i <= IPOQUE_MAX_SUPPORTED_PROTOCOLS && len < size; i++) {
+    memset(&h, 0, sizeof(h));
+    for(j = 0; j < obj_cfg.num_workers; j++)
+      lhist_merge(&h, &obj_cfg.workers[j].proto_timing[i]);
+    if(lhist_total(&h) == 0)
+      continue;
+    snprintf(what, sizeof(what), "detection %s", protocol_long_str[i]);
+    len += format_lhist(buf + len, size - len, what, &h);
+  }
+  return len < size ? len : size - 1;
+}
+#endif
+
+/*
+ * sum up the counters of the workers into `sum'; the workers keep
+ * running, so the result is a snapshot that may be a few packets apart
+ * between counters
+ */
+static void
+aggregate_stats(struct thread_stats *sum) {
+  const struct thread_stats *st;
+  int i, j;
+
+  memset(sum, 0, sizeof(*sum));
+  for(i = 0; i < obj_cfg.num_workers; i++) {
+    st = &obj_cfg.workers[i].stats;
+    sum->packets += STAT_READ(st, packets);
+    sum->bytes += STAT_READ(st, bytes);
+    for(j = 0; j < MAX_DECODE_COUNTER; j++)
+      sum->decode[j] += STAT_READ(st, decode[j]);
+    sum->reassembled += STAT_READ(st, reassembled);
+    sum->flows_created += STAT_READ(st, flows_created);
+    sum->flows_expired += STAT_READ(st, flows_expired);
+    sum->flows_evicted += STAT_READ(st, flows_evicted);
+    sum->flows_refused += STAT_READ(st, flows_refused);
+    sum->hosts_created += STAT_READ(st, hosts_created);
+    sum->hosts_evicted += STAT_READ(st, hosts_evicted);
+    sum->detect_calls += STAT_READ(st, detect_calls);
+    sum->pkts_bypassed += STAT_READ(st, pkts_bypassed);
+    sum->flows_classified += STAT_READ(st, flows_classified);
+    sum->flows_unknown += STAT_READ(st, flows_unknown);
+    sum->flows_sampled_out += STAT_READ(st, flows_sampled_out);
+    sum->flows_shed += STAT_READ(st, flows_shed);
+    for(j = 0; j <= IPOQUE_MAX_SUPPORTED_PROTOCOLS; j++) {
+      sum->proto_packets[j] += STAT_READ(st, proto_packets[j]);
+      sum->proto_bytes[j] += STAT_READ(st, proto_bytes[j]);
+    }
+  }
+}
+
+/*
+ * format the answer to a STATS query into `buf', one "name: value" per
+ * line; returns its length
+ */
+static unsigned
+format_stats(char *buf, unsigned size) {
+  struct thread_stats sum;
+  const struct thread_stats *cap = &obj_cfg.capture_stats;
+  unsigned long kpackets, kdrops, kpackets_sum = 0, kdrops_sum = 0;
+  unsigned len = 0;
+  int i;
+
+#define STATS_PRINTF(...) \
+  if(len < size) len += snprintf(buf + len, size - len, __VA_ARGS__)
+
+  aggregate_stats(&sum);
+  STATS_PRINTF("workers: %d\n", obj_cfg.num_workers);
+  if(obj_cfg.num_workers > 1 && !obj_cfg.workers_capture) {
+    STATS_PRINTF("capture packets: %lu\n", STAT_READ(cap, packets));
+    STATS_PRINTF("capture bytes: %lu\n", STAT_READ(cap, bytes));
+    STATS_PRINTF("ring drops: %lu\n", __atomic_load_n(&obj_cfg.ring_drops, __ATOMIC_RELAXED));
+  }
+  if(obj_cfg.afpacket) {
+    for(i = 0; i < obj_cfg.num_workers; i++)
+      if(obj_cfg.workers[i].afp != NULL &&
+	 afp_stats(obj_cfg.workers[i].afp, &kpackets, &kdrops) == 0) {
+	kpackets_sum += kpackets;
+	kdrops_sum += kdrops;
+      }
+    STATS_PRINTF("kernel ring packets: %lu\n", kpackets_sum);
+    STATS_PRINTF("kernel ring drops: %lu\n", kdrops_sum);
+  }
+  STATS_PRINTF("packets: %lu\n", sum.packets);
+  STATS_PRINTF("bytes: %lu\n", sum.bytes);
+  STATS_PRINTF("parse failures: %lu\n", sum.decode[DECODE_NON_IP] + sum.decode[DECODE_OTHER_L4] +
+	       sum.decode[DECODE_TRUNCATED]);
+  for(i = 0; i < MAX_DECODE_COUNTER; i++)
+    STATS_PRINTF("%s: %lu\n", decode_counter_str[i], sum.decode[i]);
+  STATS_PRINTF("reassembled: %lu\n", sum.reassembled);
+  STATS_PRINTF("flows created: %lu\n", sum.flows_created);
+  STATS_PRINTF("flows expired: %lu\n", sum.flows_expired);
+  STATS_PRINTF("flows evicted: %lu\n", sum.flows_evicted);
+  STATS_PRINTF("flow admissions refused: %lu\n", sum.flows_refused);
+  STATS_PRINTF("flows in table: %lu of %lu\n", 
+	       sum.flows_created - sum.flows_expired - sum.flows_evicted,
+	       obj_cfg.max_flows * obj_cfg.num_workers);
+  STATS_PRINTF("hosts evicted: %lu\n", sum.hosts_evicted);
+  STATS_PRINTF("hosts in table: %lu of %lu\n", sum.hosts_created - sum.hosts_evicted,
+	       obj_cfg.max_hosts * obj_cfg.num_workers);
+  STATS_PRINTF("detection calls: %lu\n", sum.detect_calls);
+  STATS_PRINTF("packets bypassed: %lu\n", sum.pkts_bypassed);
+  STATS_PRINTF("flows classified: %lu\n", sum.flows_classified);
+  STATS_PRINTF("flows given up: %lu\n", sum.flows_unknown);
+  STATS_PRINTF("sample rate: 1/%u\n", obj_cfg.sample_rate);
+  STATS_PRINTF("flows sampled out: %lu\n", sum.flows_sampled_out);
+  STATS_PRINTF("flows shed: %lu\n", sum.flows_shed);
+  if(obj_cfg.shedding)
+    for(i = 0; i < obj_cfg.num_workers; i++)
+      STATS_PRINTF("worker %d detection share: %lu/%u\n", i, 
+		   STAT_READ(&obj_cfg.workers[i].stats, dpi_share), SHED_SCALE);
+  for(i = 0; i <= IPOQUE_MAX_SUPPORTED_PROTOCOLS; i++)
+    if(sum.proto_packets[i])
+      STATS_PRINTF("protocol %s: %lu packets %lu bytes\n", protocol_long_str[i],
+		   sum.proto_packets[i], sum.proto_bytes[i]);
+#ifdef STAGE_TIMING
+  if(len < size)
+    len += format_timing(buf + len, size - len);
+#endif
+#undef STATS_PRINTF
+
+  return len < size ? len : size - 1;
+}
+
+/*
+ * thread answering STATS queries on the srpc service; it only reads the
+ * counters and never holds up the packet path
+ */
+static void *
+stats_service(void *args) {
+  RpcService rps = (RpcService)args;
+  RpcConnection sender;
+  static char query[SOCK_RECV_BUF_LEN], resp[SOCK_RECV_BUF_LEN];
+  unsigned len;
+
+  for(;;) {
+    len = rpc_query(rps, &sender, query, sizeof(query) - 1);
+    query[len] = '\0';
+    if(strncmp(query, STATS_QUERY, strlen(STATS_QUERY)) == 0)
+      len = format_stats(resp, sizeof(resp));
+    else
+      len = snprintf(resp, sizeof(resp), "ERROR unknown query, try %s\n", STATS_QUERY);
+    rpc_response(rps, sender, resp, len + 1);
+  }
+  return NULL;
+}
+
+/*
+ * offer the STATS service on the rpc port given with -S
+ */
+static void
+start_stats_service() {
+  RpcService rps;
+  pthread_t thread;
+
+  if ((rps = rpc_offer(STATS_SERVICE)) == NULL) {
+    fprintf(stderr, "Failure offering %s service\n", STATS_SERVICE);
+    exit(1);
+  }
+  if (pthread_create(&thread, NULL, stats_service, rps) || pthread_detach(thread)) {
+    fprintf(stderr, "Failure to start stats thread\n");
+    exit(1);
+  }
+}
+
+/*
+ * apply the port hints given with -H to the detection configuration: a
+ * comma separated list of port=protocol, protocol by its long name or
+ * unknown to drop the hint of the port; none removes all hints first
+ */
+static void
+set_port_hints(const char *spec) {
+  char buf[1000];
+  char *tok, *save, *name;
+  unsigned long port;
+  u32 proto;
+
+  if (strlen(spec) >= sizeof(buf)) {
+    printf("port hints too long\n");
+    exit(1);
+  }
+  strcpy(buf, spec);
+  for (tok = strtok_r(buf, ",", &save); tok != NULL; tok = strtok_r(NULL, ",", &save)) {
+    if (strcmp(tok, "none") == 0) {
+      ipoque_clear_config_port_hints(obj_cfg.dpi_cfg);
+      continue;
+    }
+    port = strtoul(tok, &name, 10);
+    if (*name != '=' || port == 0 || port > 0xffff) {
+      printf("invalid port hint %s\n", tok);
+      exit(1);
+    }
+    name++;
+    for (proto = 0; proto < sizeof(protocol_long_str) / sizeof(protocol_long_str[0]); proto++)
+      if (strcasecmp(name, protocol_long_str[proto]) == 0)
+	break;
+    if (proto == sizeof(protocol_long_str) / sizeof(protocol_long_str[0])) {
+      printf("unknown protocol %s in port hint\n", name);
+      exit(1);
+    }
+    if (!ipoque_set_config_port_hint(obj_cfg.dpi_cfg, port, proto)) {
+      printf("too many port hints\n");
+      exit(1);
+    }
+  }
+}
+
+/*
+ * turn the table budget (-M) into the number of flows and hosts a worker
+ * may keep. The budget is split in the ratio of the MAX_OSDPI_FLOWS and
+ * MAX_OSDPI_IDS defaults, which also apply without a budget.
+ */
+static void
+size_tables() {
+  // pool objects are rounded up to a cache line
+  unsigned long flow_cost = ((OSDPI_FLOW_SIZE + ipoque_detection_get_sizeof_ipoque_flow_struct() 
+			      + 63) & ~63UL) + FLOW_TABLE_OVERHEAD;
+  unsigned long host_cost = ((OSDPI_HOST_SIZE + ipoque_detection_get_sizeof_ipoque_id_struct() 
+			      + 63) & ~63UL) + HOST_TABLE_OVERHEAD;
+  double scale = 1.0;
+
+  if (obj_cfg.table_mem)
+    scale = obj_cfg.table_mem / 
+      ((double)MAX_OSDPI_FLOWS * flow_cost + (double)MAX_OSDPI_IDS * host_cost);
+  obj_cfg.max_flows = MAX_OSDPI_FLOWS * scale / obj_cfg.num_workers;
+  obj_cfg.max_hosts = MAX_OSDPI_IDS * scale / obj_cfg.num_workers;
+  // a packet needs both of its hosts at once
+  if (obj_cfg.max_hosts < 2)
+    obj_cfg.max_hosts = 2;
+  if (obj_cfg.max_flows < 1)
+    obj_cfg.max_flows = 1;
+  if (obj_cfg.verbose)
+    fprintf(stderr, "tables: %lu flows and %lu hosts per worker, about %lu bytes in all, "
+	    "eviction %s\n", obj_cfg.max_flows, obj_cfg.max_hosts, 
+	    (obj_cfg.max_flows * flow_cost + obj_cfg.max_hosts * host_cost) * obj_cfg.num_workers,
+	    evict_policy_str[obj_cfg.evict_policy]);
+}
+
+// checkpoint sections (-K): CKPT_CONF first, then CKPT_FLOWS and
+// CKPT_HOSTS of every worker in turn
+#define CKPT_CONF 1
+#define CKPT_FLOWS 2
+#define CKPT_HOSTS 3
+
+struct ckpt_conf {
+  uint32_t flow_blob, host_blob;  // sizes of the opendpi structs saved
+  uint32_t num_protocols;
+  uint32_t num_callbacks;         // dissectors enabled in the opendpi config
+  uint32_t num_workers;
+};
+
+// followed by the ipoque_flow_struct
+struct ckpt_flow {
+  struct hi_flow_key key;
+  uint64_t byte_count, pkt_count;
+  uint64_t exported_bytes, exported_pkts;
+  uint32_t first_pkt, last_pkt;
+  uint32_t detected_protocol;
+  uint8_t detection_done;
+  uint8_t pad[3];
+};
+
+// followed by the ipoque_id_struct
+struct ckpt_host {
+  HostKey key;
+};
+
+#define CKPT_REC_SIZE(s, blob) ((sizeof(s) + (blob) + 7) & ~7UL)
+
+/*
+ * write the flows and hosts of all workers, in LRU order, to the
+ * checkpoint file; the workers must be done
+ */
+static void
+save_checkpoint() {
+  char errbuf[CKPT_ERRBUF_SIZE];
+  uint32_t flow_blob = ipoque_detection_get_sizeof_ipoque_flow_struct();
+  uint32_t host_blob = ipoque_detection_get_sizeof_ipoque_id_struct();
+  unsigned long flow_rec = CKPT_REC_SIZE(struct ckpt_flow, flow_blob);
+  unsigned long host_rec = CKPT_REC_SIZE(struct ckpt_host, host_blob);
+  unsigned long nflows = 0, nhosts = 0, n;
+  struct osdpi_worker *w;
+  struct osdpi_flow *flow;
+  struct osdpi_host *host;
+  struct ckpt_conf *conf;
+  struct ckpt_flow *cf;
+  struct ckpt_host *ch;
+  uint8_t *recs;
+  CkptWriter cw;
+  int i;
+
+  for (i = 0; i < obj_cfg.num_workers; i++) {
+    for (flow = obj_cfg.workers[i].lru_head; flow != NULL; flow = flow->lru_next)
+      nflows++;
+    for (host = obj_cfg.workers[i].host_lru_head; host != NULL; host = host->lru_next)
+      nhosts++;
+  }
+  cw = ckpt_create(obj_cfg.checkpoint, 
+		   ckpt_size(1 + 2 * obj_cfg.num_workers, sizeof(struct ckpt_conf) + 
+			     nflows * flow_rec + nhosts * host_rec), errbuf);
+  if (cw == NULL) {
+    fprintf(stderr, "Failure saving checkpoint: %s\n", errbuf);
+    return;
+  }
+  conf = ckpt_section(cw, CKPT_CONF, sizeof(*conf), 1);
+  conf->flow_blob = flow_blob;
+  conf->host_blob = host_blob;
+  conf->num_protocols = IPOQUE_MAX_SUPPORTED_PROTOCOLS;
+  conf->num_callbacks = ipoque_get_config_callback_count(obj_cfg.dpi_cfg);
+  conf->num_workers = obj_cfg.num_workers;
+
+  for (i = 0; i < obj_cfg.num_workers; i++) {
+    w = &obj_cfg.workers[i];
+    for (n = 0, flow = w->lru_head; flow != NULL; flow = flow->lru_next)
+      n++;
+    recs = ckpt_section(cw, CKPT_FLOWS, flow_rec, n);
+    for (flow = w->lru_head; flow != NULL; flow = flow->lru_next, recs += flow_rec) {
+      cf = (struct ckpt_flow *)recs;
+      memset(cf, 0, flow_rec);
+      cf->key = flow->key;
+      cf->byte_count = flow->byte_count;
+      cf->pkt_count = flow->pkt_count;
+      cf->exported_bytes = flow->exported_bytes;
+      cf->exported_pkts = flow->exported_pkts;
+      cf->first_pkt = flow->first_pkt;
+      cf->last_pkt = flow->last_pkt;
+      cf->detected_protocol = flow->detected_protocol;
+      cf->detection_done = flow->detection_done;
+      memcpy(cf + 1, flow->ipoque_flow, flow_blob);
+    }
+
+    for (n = 0, host = w->host_lru_head; host != NULL; host = host->lru_next)
+      n++;
+    recs = ckpt_section(cw, CKPT_HOSTS, host_rec, n);
+    for (host = w->host_lru_head; host != NULL; host = host->lru_next, recs += host_rec) {
+      ch = (struct ckpt_host *)recs;
+      memset(ch, 0, host_rec);
+      ch->key = host->key;
+      memcpy(ch + 1, OSDPI_HOST_ID(host), host_blob);
+    }
+  }
+  if (!ckpt_commit(cw, errbuf)) {
+    fprintf(stderr, "Failure saving checkpoint: %s\n", errbuf);
+    return;
+  }
+  if (obj_cfg.verbose)
+    fprintf(stderr, "checkpoint: saved %lu flows and %lu hosts to %s\n", 
+	    nflows, nhosts, obj_cfg.checkpoint);
+}
+
+/*
+ * put a saved flow back into the flow table of `w'. The opendpi state is
+ * only taken over if it was saved by an opendpi of the same struct layout
+ * (`blob' set); otherwise a classified flow stays classified and an
+ * unknown one starts detection over. Protocol numbers are only ever
+ * appended to by opendpi, so those within range keep their meaning.
+ * returns 0 if the flow pool is full, 1 otherwise
+ */
+static int
+restore_flow(struct osdpi_worker *w, const struct ckpt_flow *cf, int blob) {
+  struct osdpi_flow *flow;
+  void *dup;
+
+  if (hi_get_flow(w->hi_handle_flows, &cf->key, &dup) == HI_ERR_SUCCESS)
+    return 1;
+  if ((flow = pool_alloc(w->flow_pool)) == NULL)
+    return 0;
+  flow->key = cf->key;
+  flow->byte_count = cf->byte_count;
+  flow->pkt_count = cf->pkt_count;
+  flow->exported_bytes = cf->exported_bytes;
+  flow->exported_pkts = cf->exported_pkts;
+  flow->first_pkt = cf->first_pkt;
+  flow->last_pkt = cf->last_pkt;
+  flow->detected_protocol = cf->detected_protocol;
+  if (flow->detected_protocol > IPOQUE_MAX_SUPPORTED_PROTOCOLS)
+    flow->detected_protocol = IPOQUE_PROTOCOL_UNKNOWN;
+  flow->ipoque_flow = (struct ipoque_flow_struct *)((u8 *)flow + OSDPI_FLOW_SIZE);
+  if (blob) {
+    memcpy(flow->ipoque_flow, cf + 1, ipoque_detection_get_sizeof_ipoque_flow_struct());
+    flow->detection_done = cf->detection_done;
+  } else {
+    memset(flow->ipoque_flow, 0, ipoque_detection_get_sizeof_ipoque_flow_struct());
+    flow->detection_done = flow->detected_protocol != IPOQUE_PROTOCOL_UNKNOWN;
+  }
+  flow->dirty = 0;
+  if (flow->pkt_count != flow->exported_pkts)
+    flow_mark_dirty(w, flow);
+  hi_insert_flow(w->hi_handle_flows, &flow->key, flow);
+  flow_lru_append(w, flow);
+  STAT_INC(&w->stats, flows_created);
+  return 1;
+}
+
+/*
+ * put a saved host back into the host table of `w', see restore_flow()
+ * returns 0 if the host pool is full, 1 otherwise
+ */
+static int
+restore_host(struct osdpi_worker *w, const struct ckpt_host *ch, int blob) {
+  struct osdpi_host *host;
+
+  if (htable_lookup(w->hosts, &ch->key) != NULL)
+    return 1;
+  if ((host = pool_alloc(w->host_pool)) == NULL)
+    return 0;
+  host->key = ch->key;
+  if (blob)
+    memcpy(OSDPI_HOST_ID(host), ch + 1, ipoque_detection_get_sizeof_ipoque_id_struct());
+  else
+    memset(OSDPI_HOST_ID(host), 0, ipoque_detection_get_sizeof_ipoque_id_struct());
+  if (!htable_insert(w->hosts, &host->key, host)) {
+    pool_free(w->host_pool, host);
+    return 1;
+  }
+  host_lru_append(w, host);
+  STAT_INC(&w->stats, hosts_created);
+  return 1;
+}
+
+/*
+ * load the checkpoint file, if there is one, into the freshly initialised
+ * workers. Flows go to the worker their hash picks when the capture thread
+ * dispatches, to the worker they were saved from otherwise; as many as the
+ * tables hold are taken. A missing or unusable checkpoint means a cold start.
+ */
+static void
+load_checkpoint() {
+  char errbuf[CKPT_ERRBUF_SIZE];
+  struct ckpt_conf conf;
+  struct osdpi_worker *w;
+  const uint8_t *recs;
+  uint32_t tag, recsize, nrecs, i;
+  unsigned long nflows = 0, nhosts = 0;
+  int have_conf = 0, flow_blob = 0, host_blob = 0, section = 0;
+  int by_hash = obj_cfg.num_workers > 1 && !obj_cfg.workers_capture;
+  CkptReader cr;
+
+  if (access(obj_cfg.checkpoint, F_OK) == -1)
+    return;
+  if ((cr = ckpt_open(obj_cfg.checkpoint, errbuf)) == NULL) {
+    fprintf(stderr, "Ignoring checkpoint: %s\n", errbuf);
+    return;
+  }
+  while ((recs = ckpt_next(cr, &tag, &recsize, &nrecs)) != NULL) {
+    switch (tag) {
+    case CKPT_CONF:
+      if (recsize < sizeof(conf) || nrecs != 1)
+	goto damaged;
+      memcpy(&conf, recs, sizeof(conf));
+      // the opendpi state only fits the same protocols and dissectors, the
+      // struct size alone rarely changes with them
+      host_blob = conf.host_blob == ipoque_detection_get_sizeof_ipoque_id_struct() &&
+	conf.num_protocols == IPOQUE_MAX_SUPPORTED_PROTOCOLS;
+      flow_blob = conf.flow_blob == ipoque_detection_get_sizeof_ipoque_flow_struct() &&
+	conf.num_protocols == IPOQUE_MAX_SUPPORTED_PROTOCOLS &&
+	conf.num_callbacks == ipoque_get_config_callback_count(obj_cfg.dpi_cfg);
+      have_conf = 1;
+      break;
+    case CKPT_FLOWS:
+      if (!have_conf || recsize < CKPT_REC_SIZE(struct ckpt_flow, conf.flow_blob))
+	goto damaged;
+      for (i = 0; i < nrecs; i++) {
+	const struct ckpt_flow *cf = (const struct ckpt_flow *)(recs + i * recsize);
+
+	w = &obj_cfg.workers[by_hash ? 
+			     hi_hash_flow((uint8_t *)&cf->key, sizeof(cf->key)) % obj_cfg.num_workers :
+			     section % obj_cfg.num_workers];
+	nflows += restore_flow(w, cf, flow_blob);
+      }
+      break;
+    case CKPT_HOSTS:
+      if (!have_conf || recsize < CKPT_REC_SIZE(struct ckpt_host, conf.host_blob))
+	goto damaged;
+      w = &obj_cfg.workers[section % obj_cfg.num_workers];
+      for (i = 0; i < nrecs; i++)
+	nhosts += restore_host(w, (const struct ckpt_host *)(recs + i * recsize), host_blob);
+      // the hosts close the sections of a worker
+      section++;
+      break;
+    }
+  }
+  if (obj_cfg.verbose)
+    fprintf(stderr, "checkpoint: restored %lu flows and %lu hosts from %s%s\n", 
+	    nflows, nhosts, obj_cfg.checkpoint, 
+	    flow_blob && host_blob ? "" : ", opendpi state not compatible");
+  ckpt_close(cr);
+  return;
+
+ damaged:
+  fprintf(stderr, "Checkpoint %s damaged, restored %lu flows and %lu hosts\n", 
+	  obj_cfg.checkpoint, nflows, nhosts);
+  ckpt_close(cr);
+}
+
+/*
+ * SIGTERM and SIGINT: end the capture. Whatever reads packets stops and
+ * the run ends as at the end of its input, saving the checkpoint if any.
+ */
+static void
+stop_capture(int sig) {
+  int i;
+
+  obj_cfg.stopping = 1;
+  if (obj_cfg.pcap_dev != NULL)
+    pcap_breakloop(obj_cfg.pcap_dev);
+  for (i = 0; i < obj_cfg.num_workers; i++)
+    if (obj_cfg.workers[i].afp != NULL)
+      afp_breakloop(obj_cfg.workers[i].afp);
+}
+
+/*
+ * Initialize the private detection state of a packet processing thread
+ */
+static void
+init_worker(struct osdpi_worker *w, int id) {
+  char errbuf[PCAP_ERRBUF_SIZE];
+  int res;
+
+  w->id = id;
+  w->lru_head = w->lru_tail = NULL;
+  w->dirty_head = NULL;
+  w->next_export = 0;
+  w->flushing = 0;
+  memset(&w->stats, 0, sizeof(w->stats));
+  w->stats.dpi_share = SHED_SCALE;
+  w->shed_count = 0;
+
+  // each worker needs its own opendpi workspace, it holds the per packet
+  // parse state; the configuration is shared
+  w->ipoque_struct = ipoque_init_detection_workspace(obj_cfg.dpi_cfg, malloc_wrapper);
+  if (w->ipoque_struct == NULL) {
+    printf("ERROR: detection workspace initialization failed\n");
+    exit(-1);
+  }
+
+  if( (w->hosts = htable_create(obj_cfg.max_hosts)) == NULL) {
+    printf("Failed to init host table\n");
+    exit(1);
+  }
+  w->host_pool = pool_create(OSDPI_HOST_SIZE + ipoque_detection_get_sizeof_ipoque_id_struct(),
+			     obj_cfg.max_hosts, HOST_SLAB_OBJS);
+  if (w->host_pool == NULL) {
+    printf("Failed to init host pool\n");
+    exit(1);
+  }
+  w->host_lru_head = w->host_lru_tail = NULL;
+
+  if( (res = hi_init_flow(&w->hi_handle_flows, 93563)) != HI_SUCCESS) {
+    printf("Failed to init flow_hasr: %s\n", hi_strerror(res));
+    exit(1);
+  }
+
+  w->flow_pool = pool_create(OSDPI_FLOW_SIZE + ipoque_detection_get_sizeof_ipoque_flow_struct(),
+			      obj_cfg.max_flows, FLOW_SLAB_OBJS);
+  if (w->flow_pool == NULL) {
+    printf("Failed to init flow pool\n");
+    exit(1);
+  }
+
+  if ((w->frags = ipfrag_create(obj_cfg.frag_mem, obj_cfg.frag_timeout, 
+			       obj_cfg.frag_policy, LINK_HDR_MAX)) == NULL) {
+    printf("Failed to init fragment reassembly\n");
+    exit(1);
+  }
+
+#ifdef STAGE_TIMING
+  memset(w->timing, 0, sizeof(w->timing));
+  w->proto_timing = calloc(IPOQUE_MAX_SUPPORTED_PROTOCOLS + 1, sizeof(LHist));
+  if (w->proto_timing == NULL) {
+    perror("malloc timing");
+    exit(1);
+  }
+#endif
+
+  w->batch = NULL;
+  w->batch_len = 0;
+  w->batch_in_place = 0;
+  if (obj_cfg.batch_size > 1 && (obj_cfg.num_workers == 1 || obj_cfg.workers_capture) &&
+      (w->batch = malloc(obj_cfg.batch_size * sizeof(struct batch_packet))) == NULL) {
+    perror("malloc batch");
+    exit(1);
+  }
+
+  w->afp = NULL;
+  if (obj_cfg.afpacket) {
+    w->afp = afp_open(obj_cfg.dev_name, obj_cfg.afp_block_size, obj_cfg.afp_block_count,
+		      obj_cfg.fanout_group, obj_cfg.pcap_filter, SNAPLEN, errbuf);
+    if (w->afp == NULL) {
+      fprintf(stderr, "afp_open(): %s\n", errbuf);
+      exit(1);
+    }
+  }
+
+  w->ring = NULL;
+  if (obj_cfg.num_workers > 1 && !obj_cfg.workers_capture &&
+      (w->ring = spsc_create(obj_cfg.ring_size, sizeof(struct ring_packet))) == NULL) {
+    printf("Failed to init packet ring\n");
+    exit(1);
+  }
+}
+
+/*
+ * release what init_worker() set up, once the worker has flushed its
+ * flows. The counters stay, the STATS service may still read them.
+ */
+static void
+destroy_worker(struct osdpi_worker *w) {
+  AFPacket afp = w->afp;
+
+  if (afp != NULL) {
+    w->afp = NULL;
+    afp_close(afp);
+  }
+  if (w->ring != NULL)
+    spsc_destroy(w->ring);
+  free(w->batch);
+#ifdef STAGE_TIMING
+  free(w->proto_timing);
+#endif
+  ipfrag_destroy(w->frags);
+  hi_fini(w->hi_handle_flows);
+  pool_destroy(w->flow_pool);
+  // the hosts live in the pool, the table only points at them
+  htable_destroy(w->hosts, NULL);
+  pool_destroy(w->host_pool);
+  ipoque_exit_detection_module(w->ipoque_struct, free);
+}
+
 /*
  * Initialize pcap structures and rpc structures
  */
@@ -425,15 +2379,23 @@ int
 init() {  
   char errbuf[PCAP_ERRBUF_SIZE];
   struct bpf_program fp;      /* hold compiled program     */
+#ifndef BENCHMARK
   char *host = HWDB_SERVER_ADDR;
   unsigned short port = HWDB_SERVER_PORT;
-  IPOQUE_PROTOCOL_BITMASK all;
+#endif
   uint32_t size_id_struct; 
   uint32_t size_flow_struct;
   uint32_t i;
+  IPOQUE_PROTOCOL_BITMASK all;
 
-  /* ask pcap for the network address and mask of the device */
-  if(obj_cfg.type == DEVICE_CAPTURE) {
+  if(obj_cfg.afpacket) {
+    if (obj_cfg.verbose) 
+      printf("Device is %s (AF_PACKET, %u blocks of %u bytes per worker)\n", 
+	     obj_cfg.dev_name, obj_cfg.afp_block_count, obj_cfg.afp_block_size);
+    // every worker opens its own ring, see init_worker()
+    obj_cfg.pcap_dev = NULL;
+  } else if(obj_cfg.type == DEVICE_CAPTURE) {
+    /* ask pcap for the network address and mask of the device */
     if (obj_cfg.verbose) 
       printf("Device is %s\n", obj_cfg.dev_name);
     //pcap_lookupnet(dev, &netp, &maskp, errbuf);
@@ -446,13 +2408,8 @@ init() {
       exit(1);
     }
   } else if (obj_cfg.type == FILE_CAPTURE) {
-    if (obj_cfg.verbose) 
-      printf("File is %s\n", obj_cfg.filename);
-    obj_cfg.pcap_dev = pcap_open_offline(obj_cfg.filename, errbuf);
-    if(obj_cfg.pcap_dev == NULL) {
-      fprintf(stderr, "pcap_open_live(): %s\n", errbuf);
-      exit(1);
-    }
+    // files are mapped by their reader, see open_next_file()
+    obj_cfg.pcap_dev = NULL;
   } else {
       fprintf(stderr, "No device or file was defined for capturing\n");
       exit(1);
@@ -466,7 +2423,7 @@ init() {
 /*     } */
 /*   } */
 
-  if(strlen(obj_cfg.pcap_filter) > 0) {
+  if(obj_cfg.pcap_dev != NULL && strlen(obj_cfg.pcap_filter) > 0) {
     /* Lets try and compile the program.. non-optimized */
     if(pcap_compile(obj_cfg.pcap_dev, &fp, obj_cfg.pcap_filter, 0, 0) == -1) {
       fprintf(stderr, "Error calling pcap_compile: $%s %s\n", obj_cfg.pcap_filter, pcap_geterr(obj_cfg.pcap_dev));
@@ -480,8 +2437,9 @@ init() {
     }
   }
 
+#ifndef BENCHMARK
   //rpc initialization
-  if (! rpc_init(0)) {
+  if (! rpc_init(obj_cfg.stats_port)) {
     fprintf(stderr, "Initialization failure for rpc system\n");
     exit(-1);
   }
@@ -491,19 +2449,211 @@ init() {
 	    host, port);
     exit(-1);
   }
+#endif
   
-  // init global opendpi structure with millisecond precision
-  obj_cfg.ipoque_struct = ipoque_init_detection_module(1000, 
-					       malloc_wrapper, debug_printf);
-  if (obj_cfg.ipoque_struct == NULL) {
+  // the counters in each worker start on a cache line of their own
+  if (posix_memalign((void **)&obj_cfg.workers, 64, 
+		     obj_cfg.num_workers * sizeof(struct osdpi_worker))) {
+    perror("malloc workers");
+    exit(-1);
+  }
+  memset(obj_cfg.workers, 0, obj_cfg.num_workers * sizeof(struct osdpi_worker));
+  size_tables();
+  // millisecond precision, all protocols enabled
+  obj_cfg.dpi_cfg = ipoque_init_detection_config(1000, malloc_wrapper, debug_printf);
+  if (obj_cfg.dpi_cfg == NULL) {
     printf("ERROR: global structure initialization failed\n");
     exit(-1);
   }
-  // enable all protocols
   IPOQUE_BITMASK_SET_ALL(all);
-  ipoque_set_protocol_detection_bitmask2(obj_cfg.ipoque_struct, &all);
+  ipoque_set_config_detection_bitmask(obj_cfg.dpi_cfg, &all);
+  if (obj_cfg.port_hints != NULL)
+    set_port_hints(obj_cfg.port_hints);
+  for (i = 0; i < obj_cfg.num_workers; i++)
+    init_worker(&obj_cfg.workers[i], i);
+
+  if (obj_cfg.num_workers > 1 && !obj_cfg.workers_capture &&
+      (obj_cfg.capture_frags = ipfrag_create(obj_cfg.frag_mem, obj_cfg.frag_timeout, 
+					     obj_cfg.frag_policy, LINK_HDR_MAX)) == NULL) {
+    printf("Failed to init fragment reassembly\n");
+    exit(1);
+  }
+
+  if (obj_cfg.checkpoint != NULL)
+    load_checkpoint();
+
+#ifdef STAGE_TIMING
+  // calibrate now rather than on the first report
+  lhist_cycles_per_ns();
+#endif
+  if (obj_cfg.stats_port)
+    start_stats_service();
 }
 
+#ifdef BENCHMARK
+/*
+ * Benchmark of the packet path (make bench): dpibench takes the options of
+ * dpilogger, loads the -r files, or the synthetic traffic described by -g,
+ * into memory and replays them -R times through process_packet(), or
+ * batch_collect() with -b, on a single worker.
+ * There is no capture, no RPC and no flow export; the flows left at the
+ * end of a round are released outside the timing, so that every round
+ * starts from empty tables.
+ */
+
+// the packets, each a struct pcap_pkthdr followed by its bytes, padded to 8
+struct bench_trace {
+  u_char *buf;
+  unsigned long len, size;
+  unsigned long packets, bytes;
+};
+
+static void
+bench_collect(u_char *args, const struct pcap_pkthdr* pkthdr, const u_char* packet) {
+  struct bench_trace *t = (struct bench_trace *)args;
+  unsigned long rec = (sizeof(*pkthdr) + pkthdr->caplen + 7) & ~7UL;
+
+  if(t->len + rec > t->size) {
+    t->size = 2 * t->size + rec;
+    if((t->buf = realloc(t->buf, t->size)) == NULL) {
+      perror("malloc trace");
+      exit(1);
+    }
+  }
+  memcpy(t->buf + t->len, pkthdr, sizeof(*pkthdr));
+  memcpy(t->buf + t->len + sizeof(*pkthdr), packet, pkthdr->caplen);
+  t->len += rec;
+  t->packets++;
+  t->bytes += pkthdr->caplen;
+}
+
+static void
+bench_export(struct osdpi_worker *w, struct osdpi_flow *flow, uint64_t pkts, uint64_t bytes) {
+}
+
+static double
+bench_now() {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * generate the synthetic traffic of -g into the trace, or into the pcap
+ * file of -w; returns 1 if successful, 0 otherwise
+ */
+static int
+bench_generate(struct bench_trace *t) {
+  TrafGenConfig cfg;
+  TrafGen g;
+  struct pcap_pkthdr hdr;
+  const u_char *frame;
+  long n;
+  int i;
+
+  trafgen_defaults(&cfg);
+  if(!trafgen_parse(&cfg, obj_cfg.bench_traffic) || (g = trafgen_create(&cfg)) == NULL) {
+    fprintf(stderr, "invalid traffic %s\n", obj_cfg.bench_traffic);
+    return 0;
+  }
+  printf("synthetic traffic: %lu flows, %u at a time, Zipf %.2f up to %u packets of %u bytes, "
+	 "seed %u, mix", cfg.flows, cfg.active, cfg.zipf, cfg.max_packets, cfg.packet_size, 
+	 cfg.seed);
+  for(i = 0; i < TG_MAX_APP; i++)
+    printf(" %s=%u", trafgen_app_name(i), cfg.mix[i]);
+  printf("\n");
+  if(obj_cfg.bench_pcap != NULL) {
+    if((n = trafgen_write_pcap(g, obj_cfg.bench_pcap)) < 0)
+      perror(obj_cfg.bench_pcap);
+    else
+      printf("%ld packets written to %s\n", n, obj_cfg.bench_pcap);
+  } else {
+    while((frame = trafgen_next(g, &hdr)) != NULL)
+      bench_collect((u_char *)t, &hdr, frame);
+  }
+  trafgen_destroy(g);
+  return 1;
+}
+
+/*
+ * one pass over the trace; returns the seconds it took
+ */
+static double
+bench_round(struct osdpi_worker *w, const struct bench_trace *t) {
+  const struct pcap_pkthdr *pkthdr;
+  unsigned long off;
+  double start = bench_now();
+
+  for(off = 0; off < t->len; off += (sizeof(*pkthdr) + pkthdr->caplen + 7) & ~7UL) {
+    pkthdr = (const struct pcap_pkthdr *)(t->buf + off);
+    if(obj_cfg.batch_size > 1) {
+      batch_collect((u_char *)w, pkthdr, (const u_char *)(pkthdr + 1));
+      if(w->batch_len == obj_cfg.batch_size)
+	process_batch(w);
+    } else {
+      process_packet((u_char *)w, pkthdr, (const u_char *)(pkthdr + 1));
+    }
+  }
+  if(w->batch_len > 0)
+    process_batch(w);
+  return bench_now() - start;
+}
+
+static int
+bench_main() {
+  struct osdpi_worker *w = &obj_cfg.workers[0];
+  struct bench_trace t;
+  struct rusage ru;
+  PcapFile f;
+  unsigned long created;
+  double secs, best = 0, total = 0;
+  int i;
+
+  memset(&t, 0, sizeof(t));
+  obj_cfg.replay_speed = 0;
+  if(obj_cfg.bench_traffic != NULL) {
+    if(!bench_generate(&t))
+      return 1;
+    if(obj_cfg.bench_pcap != NULL)
+      return 0;
+  }
+  while((f = open_next_file()) != NULL) {
+    while(pcapfile_dispatch(f, FILE_CHUNK, bench_collect, (u_char *)&t) > 0)
+      ;
+    pcapfile_close(f);
+  }
+  if(t.packets == 0) {
+    fprintf(stderr, "no packets to replay, give pcap files with -r or traffic with -g\n");
+    return 1;
+  }
+  obj_cfg.flow_export = bench_export;
+  // the trace stays put, batches refer to it in place
+  w->batch_in_place = 1;
+  printf("%lu packets, %lu bytes, %d rounds, batch %d\n", t.packets, t.bytes, 
+	 obj_cfg.bench_rounds, obj_cfg.batch_size);
+  for(i = 0; i < obj_cfg.bench_rounds; i++) {
+    created = w->stats.flows_created;
+    secs = bench_round(w, &t);
+    created = w->stats.flows_created - created;
+    printf("round %d: %.3f Mpps, %.1f ns/packet, %.0f flows/s created\n", i, 
+	   t.packets / secs / 1e6, secs * 1e9 / t.packets, created / secs);
+    flush_osdpi_flows(w);
+    if(best == 0 || secs < best)
+      best = secs;
+    total += secs;
+  }
+  getrusage(RUSAGE_SELF, &ru);
+  printf("best: %.3f Mpps, %.1f ns/packet\n", t.packets / best / 1e6, best * 1e9 / t.packets);
+  printf("mean: %.3f Mpps, %.1f ns/packet\n", t.packets * obj_cfg.bench_rounds / total / 1e6, 
+	 total * 1e9 / t.packets / obj_cfg.bench_rounds);
+  printf("peak RSS: %ld kB\n", ru.ru_maxrss);
+  if(obj_cfg.verbose)
+    print_worker_stats(w);
+  return 0;
+}
+#endif
+
 int
 main(int argc, char *argv[]) {	
   char *dev;
@@ -511,24 +2661,130 @@ main(int argc, char *argv[]) {
   bpf_u_int32 maskp;
   bpf_u_int32 netp;
   u_char* args = NULL;
-  pthread_t thr;
+  PubStats pst;
   int i;
   char buf[100];
+  struct sigaction sa;
 
   // Initialize link accumulator.
   //  lt_init();
   parse_options(argc, argv);
   init();
+#ifdef BENCHMARK
+  return bench_main();
+#endif
+
+  // a termination signal ends the capture like the end of the input
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = stop_capture;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGTERM, &sa, NULL);
+  sigaction(SIGINT, &sa, NULL);
 
   // and the thread that processes (inserts into hwdb) the accumulated results.
-/*   if (pthread_create(&thr, NULL, handler, NULL)) { */
-/*     fprintf(stderr, "Failure to start database thread\n"); */
-/*     exit(1); */
-/*   } */
+#ifdef HWDB_PUBLISH_IN_BACKGROUND
+  obj_cfg.publisher = pub_create(obj_cfg.rpc, obj_cfg.num_workers, PUBLISH_QUEUE_SIZE,
+				 PUBLISH_QUERY_SIZE, PUBLISH_FLUSH_MS);
+  if (obj_cfg.publisher == NULL || !pub_start(obj_cfg.publisher)) {
+    fprintf(stderr, "Failure to start database thread\n");
+    exit(1);
+  }
+  obj_cfg.flow_export = publish_flow;
+#endif
   /* ... and loop */ 
-  pcap_loop(obj_cfg.pcap_dev, -1, process_packet, args);
+  if (obj_cfg.afpacket) {
+    if (obj_cfg.num_workers == 1) {
+      afp_capture(&obj_cfg.workers[0]);
+    } else {
+      for (i = 0; i < obj_cfg.num_workers; i++) {
+	if (pthread_create(&obj_cfg.workers[i].thread, NULL, afp_capture, 
+			   &obj_cfg.workers[i])) {
+	  fprintf(stderr, "Failure to start worker thread\n");
+	  exit(1);
+	}
+      }
+      for (i = 0; i < obj_cfg.num_workers; i++)
+	pthread_join(obj_cfg.workers[i].thread, NULL);
+    }
+  } else if (obj_cfg.workers_capture) {
+    // several files, read in parallel
+    for (i = 0; i < obj_cfg.num_workers; i++) {
+      if (pthread_create(&obj_cfg.workers[i].thread, NULL, file_capture, 
+			 &obj_cfg.workers[i])) {
+	fprintf(stderr, "Failure to start worker thread\n");
+	exit(1);
+      }
+    }
+    for (i = 0; i < obj_cfg.num_workers; i++)
+      pthread_join(obj_cfg.workers[i].thread, NULL);
+  } else if (obj_cfg.num_workers == 1 && obj_cfg.type == FILE_CAPTURE) {
+    file_capture(&obj_cfg.workers[0]);
+  } else if (obj_cfg.num_workers == 1) {
+    args = (u_char *)&obj_cfg.workers[0];
+    if (obj_cfg.batch_size > 1)
+      batch_loop(&obj_cfg.workers[0]);
+    else
+      pcap_loop(obj_cfg.pcap_dev, -1, process_packet, args);
+    flush_osdpi_flows(&obj_cfg.workers[0]);
+  } else {
+    for (i = 0; i < obj_cfg.num_workers; i++) {
+      if (pthread_create(&obj_cfg.workers[i].thread, NULL, worker_loop, 
+			 &obj_cfg.workers[i])) {
+	fprintf(stderr, "Failure to start worker thread\n");
+	exit(1);
+      }
+    }
+    if (obj_cfg.type == FILE_CAPTURE) {
+      PcapFile f = open_next_file();
+      if (f != NULL) {
+	while (pcapfile_dispatch(f, FILE_CHUNK, dispatch_packet, args) > 0 && !obj_cfg.stopping)
+	  ;
+	pcapfile_close(f);
+      }
+    } else {
+      pcap_loop(obj_cfg.pcap_dev, -1, dispatch_packet, args);
+    }
+    __atomic_store_n(&obj_cfg.capture_done, 1, __ATOMIC_RELEASE);
+    for (i = 0; i < obj_cfg.num_workers; i++)
+      pthread_join(obj_cfg.workers[i].thread, NULL);
+    if (obj_cfg.ring_drops)
+      fprintf(stderr, "%lu packets dropped on full worker rings\n", obj_cfg.ring_drops);
+    if (obj_cfg.verbose) {
+      print_decode_stats("capture", &obj_cfg.capture_stats);
+      print_frag_stats("capture", obj_cfg.capture_frags);
+    }
+  }
+  if (obj_cfg.checkpoint != NULL)
+    save_checkpoint();
+  if (obj_cfg.verbose) {
+    for (i = 0; i < obj_cfg.num_workers; i++)
+      print_worker_stats(&obj_cfg.workers[i]);
+#ifdef STAGE_TIMING
+    {
+      static char timing[SOCK_RECV_BUF_LEN];
+
+      format_timing(timing, sizeof(timing));
+      fputs(timing, stderr);
+    }
+#endif
+  }
+  if (obj_cfg.publisher != NULL) {
+    pub_stop(obj_cfg.publisher);
+    pub_stats(obj_cfg.publisher, &pst);
+    if (obj_cfg.verbose || pst.dropped || pst.failed)
+      fprintf(stderr, "published %lu of %lu flow records in %lu calls (%lu bytes), "
+	      "%lu dropped on full queues, %lu in failed calls\n", pst.published, 
+	      pst.queued + pst.dropped, pst.calls, pst.bytes, pst.dropped, pst.failed);
+    pub_destroy(obj_cfg.publisher);
+  }
   fprintf(stderr, "\nfinished\n");
-  pcap_close(obj_cfg.pcap_dev);
+  if (obj_cfg.pcap_dev != NULL)
+    pcap_close(obj_cfg.pcap_dev);
+  for (i = 0; i < obj_cfg.num_workers; i++)
+    destroy_worker(&obj_cfg.workers[i]);
+  if (obj_cfg.capture_frags != NULL)
+    ipfrag_destroy(obj_cfg.capture_frags);
+  ipoque_exit_detection_config(obj_cfg.dpi_cfg, free);
 
 
   printf("Starting hwdb-opendpi daemon...\n");
@@ -0,0 +1,183 @@
+/*
+ * htable.c - implementation of the open addressing host table used by
+ *            dpilogger
+ */
+
+#include "htable.h"
+#include "mem.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define MIN_SLOTS 64
+#define MAX_LOAD_NUM 3		/* grow when more than 3/4 full */
+#define MAX_LOAD_DEN 4
+
+typedef struct h_slot {
+	HostKey key;
+	void *data;		/* NULL marks an empty slot */
+} HSlot;
+
+typedef struct h_table {
+	HSlot *slots;
+	unsigned long mask;	/* number of slots - 1 */
+	unsigned long count;
+} HTableHead;
+
+/*
+ * murmur3 finalizer over the folded key words
+ */
+static unsigned long hash(const HostKey *k) {
+	uint64_t h;
+
+	h = ((uint64_t)(k->w[0] ^ k->w[2]) << 32 | (k->w[1] ^ k->w[3]))
+	    * 0x9e3779b97f4a7c15ULL;
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return (unsigned long)h;
+}
+
+static int keyeq(const HostKey *a, const HostKey *b) {
+	return a->w[3] == b->w[3] && a->w[2] == b->w[2] &&
+	       a->w[1] == b->w[1] && a->w[0] == b->w[0];
+}
+
+static HSlot *slots_alloc(unsigned long n) {
+	HSlot *s = (HSlot *)mem_alloc(n * sizeof(HSlot));
+	if (s)
+		memset(s, 0, n * sizeof(HSlot));
+	return s;
+}
+
+HTable htable_create(unsigned long size) {
+	HTableHead *th = (HTableHead *)mem_alloc(sizeof(HTableHead));
+	unsigned long n = MIN_SLOTS;
+
+	if (th) {
+		/* size the array so that `size' hosts fit below the load limit */
+		while (n * MAX_LOAD_NUM / MAX_LOAD_DEN < size)
+			n <<= 1;
+		th->mask = n - 1;
+		th->count = 0;
+		if (!(th->slots = slots_alloc(n))) {
+			mem_free(th);
+			th = NULL;
+		}
+	}
+	return (HTable)th;
+}
+
+void *htable_lookup(HTable ht, const HostKey *k) {
+	HTableHead *th = (HTableHead *)ht;
+	unsigned long i = hash(k) & th->mask;
+	HSlot *s;
+
+	for (;;) {
+		s = &th->slots[i];
+		if (s->data == NULL)
+			return NULL;
+		if (keyeq(&s->key, k))
+			return s->data;
+		i = (i + 1) & th->mask;
+	}
+}
+
+void htable_prefetch_ipv4(HTable ht, uint32_t addr) {
+	HTableHead *th = (HTableHead *)ht;
+	HostKey k;
+
+	hostkey_from_ipv4(&k, addr);
+	__builtin_prefetch(&th->slots[hash(&k) & th->mask]);
+}
+
+/*
+ * double the slot array and reinsert every entry
+ * returns 0 on malloc failure, otherwise 1
+ */
+static int grow(HTableHead *th) {
+	unsigned long i, j, n = (th->mask + 1) << 1;
+	HSlot *old = th->slots, *nslots;
+
+	if (!(nslots = slots_alloc(n)))
+		return 0;
+	for (i = 0; i <= th->mask; i++) {
+		if (old[i].data == NULL)
+			continue;
+		j = hash(&old[i].key) & (n - 1);
+		while (nslots[j].data != NULL)
+			j = (j + 1) & (n - 1);
+		nslots[j] = old[i];
+	}
+	th->slots = nslots;
+	th->mask = n - 1;
+	mem_free(old);
+	return 1;
+}
+
+int htable_insert(HTable ht, const HostKey *k, void *data) {
+	HTableHead *th = (HTableHead *)ht;
+	unsigned long i;
+	HSlot *s;
+
+	if (data == NULL)
+		return 0;
+	if ((th->count + 1) * MAX_LOAD_DEN > (th->mask + 1) * MAX_LOAD_NUM)
+		if (!grow(th))
+			return 0;
+	for (i = hash(k) & th->mask; ; i = (i + 1) & th->mask) {
+		s = &th->slots[i];
+		if (s->data == NULL)
+			break;
+		if (keyeq(&s->key, k))
+			return 0;
+	}
+	s->key = *k;
+	s->data = data;
+	th->count++;
+	return 1;
+}
+
+/*
+ * linear probing cannot leave a hole behind: the entries following the
+ * removed one in its cluster are shifted back into the hole, unless that
+ * would move them in front of their home slot
+ */
+void *htable_remove(HTable ht, const HostKey *k) {
+	HTableHead *th = (HTableHead *)ht;
+	unsigned long i, j, home;
+	void *data;
+
+	for (i = hash(k) & th->mask; ; i = (i + 1) & th->mask) {
+		if (th->slots[i].data == NULL)
+			return NULL;
+		if (keyeq(&th->slots[i].key, k))
+			break;
+	}
+	data = th->slots[i].data;
+	for (j = (i + 1) & th->mask; th->slots[j].data != NULL;
+	     j = (j + 1) & th->mask) {
+		home = hash(&th->slots[j].key) & th->mask;
+		/* stays if its home lies cyclically in (i, j] */
+		if (i <= j ? (i < home && home <= j) : (i < home || home <= j))
+			continue;
+		th->slots[i] = th->slots[j];
+		i = j;
+	}
+	th->slots[i].data = NULL;
+	th->count--;
+	return data;
+}
+
+void htable_destroy(HTable ht, void (*freefn)(void *data)) {
+	HTableHead *th = (HTableHead *)ht;
+	unsigned long i;
+
+	if (freefn)
+		for (i = 0; i <= th->mask; i++)
+			if (th->slots[i].data != NULL)
+				freefn(th->slots[i].data);
+	mem_free(th->slots);
+	mem_free(th);
+}
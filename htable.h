@@ -0,0 +1,84 @@
+/*
+ * htable.h - public data structures and entry points for the host table
+ *            used by dpilogger to map host addresses to their per-host
+ *            detection state
+ *
+ * the table uses open addressing (linear probing) over a power-of-two
+ * array of slots; keys are compared and hashed as fixed-width integers,
+ * there is no string formatting or allocation on the lookup path
+ *
+ * keys are 128 bits wide: IPv4 addresses are stored as IPv4-mapped IPv6
+ * addresses (::ffff:a.b.c.d) so that both address families can live in the
+ * same table; all address words are in NETWORK order
+ *
+ * the table is not thread-safe - each packet-processing thread owns its own
+ */
+
+#ifndef _HTABLE_H_INCLUDED_
+#define _HTABLE_H_INCLUDED_
+
+#include <stdint.h>
+#include <string.h>
+#include <netinet/in.h>
+
+typedef struct host_key {
+	uint32_t w[4];
+} HostKey;
+
+typedef void *HTable;
+
+/*
+ * fill in `k' from an IPv4 address in network order
+ */
+static inline void hostkey_from_ipv4(HostKey *k, uint32_t addr) {
+	k->w[0] = 0;
+	k->w[1] = 0;
+	k->w[2] = htonl(0x0000ffff);
+	k->w[3] = addr;
+}
+
+/*
+ * fill in `k' from a 16 byte IPv6 address in network order
+ */
+static inline void hostkey_from_ipv6(HostKey *k, const uint8_t *addr) {
+	memcpy(k->w, addr, sizeof(k->w));
+}
+
+/* constructor - `size' is a hint for the expected number of hosts
+ * returns NULL if error */
+HTable htable_create(unsigned long size);
+
+/*
+ * lookup the data associated with `k'
+ *
+ * if successful, returns the associated data
+ * if not, returns NULL
+ */
+void *htable_lookup(HTable ht, const HostKey *k);
+
+/*
+ * prefetch the slot an IPv4 address in network order maps to, to overlap
+ * the cache miss of a later htable_lookup() with other work
+ */
+void htable_prefetch_ipv4(HTable ht, uint32_t addr);
+
+/*
+ * insert `data' (which must not be NULL) under `k'; the table grows as
+ * needed
+ * returns 0 if failure to insert (malloc failure or duplicate key),
+ * otherwise 1
+ */
+int htable_insert(HTable ht, const HostKey *k, void *data);
+
+/*
+ * remove the entry stored under `k'
+ * returns its data, or NULL if there was none
+ */
+void *htable_remove(HTable ht, const HostKey *k);
+
+/*
+ * destroy the table; `freefn', if not NULL, is called on every data item
+ */
+void htable_destroy(HTable ht, void (*freefn)(void *data));
+
+#endif /* _HTABLE_H_INCLUDED_ */
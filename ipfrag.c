@@ -0,0 +1,353 @@
+/*
+ * ipfrag.c - implementation of IPv4 fragment reassembly
+ */
+
+#include "ipfrag.h"
+#include "mem.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define IPFRAG_BUCKETS 1024		/* power of 2 */
+#define IPFRAG_MAX_RANGES 32		/* disjoint pieces of one datagram */
+#define IPFRAG_MAX_HDR 60
+#define IPFRAG_MAX_DGRAM 65535		/* header and payload, tot_len is 16 bits */
+#define IPFRAG_CHUNK 2048		/* payload buffers grow by that much */
+
+typedef struct frag_range {
+	uint32_t start, end;
+} FragRange;
+
+typedef struct dgram {
+	struct dgram *hnext;		/* hash chain */
+	struct dgram *prev, *next;	/* age list, oldest first */
+	uint32_t saddr, daddr;
+	uint16_t id;
+	uint8_t protocol;
+	uint32_t expires;
+	uint32_t total;			/* payload length, 0 until the last fragment */
+	unsigned hdrlen;		/* 0 until the first fragment */
+	unsigned char hdr[IPFRAG_MAX_HDR];
+	unsigned nranges;		/* received payload, sorted and merged */
+	FragRange ranges[IPFRAG_MAX_RANGES];
+	unsigned char *buf;		/* headroom, IP header, payload */
+	unsigned bufsize;		/* payload capacity of buf */
+} Dgram;
+
+typedef struct ipfrag_head {
+	Dgram *buckets[IPFRAG_BUCKETS];
+	Dgram *oldest, *newest;
+	Dgram *done;			/* handed out by the last ipfrag_add() */
+	unsigned long max_mem;
+	unsigned timeout;
+	enum ipfrag_overlap policy;
+	unsigned headroom;
+	IPFragStats st;
+} IPFragHead;
+
+static unsigned bucket_of(uint32_t saddr, uint32_t daddr, uint16_t id,
+			  uint8_t protocol) {
+	uint32_t h = (saddr ^ daddr) * 0x9e3779b1;
+
+	h ^= ((uint32_t)id << 8 | protocol) * 0x85ebca6b;
+	return (h ^ (h >> 16)) & (IPFRAG_BUCKETS - 1);
+}
+
+static unsigned long dgram_mem(IPFragHead *fh, Dgram *d) {
+	return sizeof(Dgram) + (d->buf ? fh->headroom + IPFRAG_MAX_HDR +
+					 d->bufsize : 0);
+}
+
+static void dgram_free(IPFragHead *fh, Dgram *d) {
+	fh->st.mem_in_use -= dgram_mem(fh, d);
+	if (d->buf)
+		mem_free(d->buf);
+	mem_free(d);
+}
+
+/* take `d' off the hash chain and the age list */
+static void dgram_unlink(IPFragHead *fh, Dgram *d) {
+	Dgram **pp = &fh->buckets[bucket_of(d->saddr, d->daddr, d->id,
+					    d->protocol)];
+
+	while (*pp != d)
+		pp = &(*pp)->hnext;
+	*pp = d->hnext;
+	if (d->prev)
+		d->prev->next = d->next;
+	else
+		fh->oldest = d->next;
+	if (d->next)
+		d->next->prev = d->prev;
+	else
+		fh->newest = d->prev;
+	fh->st.in_progress--;
+}
+
+static void dgram_drop(IPFragHead *fh, Dgram *d) {
+	dgram_unlink(fh, d);
+	dgram_free(fh, d);
+}
+
+static Dgram *dgram_get(IPFragHead *fh, const struct iphdr *ip,
+			uint32_t now) {
+	unsigned b = bucket_of(ip->saddr, ip->daddr, ip->id, ip->protocol);
+	Dgram *d;
+
+	for (d = fh->buckets[b]; d; d = d->hnext)
+		if (d->saddr == ip->saddr && d->daddr == ip->daddr &&
+		    d->id == ip->id && d->protocol == ip->protocol)
+			return d;
+	if (!(d = (Dgram *)mem_alloc(sizeof(Dgram))))
+		return NULL;
+	memset(d, 0, sizeof(Dgram));
+	d->saddr = ip->saddr;
+	d->daddr = ip->daddr;
+	d->id = ip->id;
+	d->protocol = ip->protocol;
+	d->expires = now + fh->timeout;
+	d->hnext = fh->buckets[b];
+	fh->buckets[b] = d;
+	d->prev = fh->newest;
+	if (fh->newest)
+		fh->newest->next = d;
+	else
+		fh->oldest = d;
+	fh->newest = d;
+	fh->st.in_progress++;
+	fh->st.mem_in_use += sizeof(Dgram);
+	return d;
+}
+
+/* make the payload buffer of `d' hold `end' bytes, dropping the oldest
+ * other datagrams if the memory budget requires; returns 0 if successful */
+static int dgram_grow(IPFragHead *fh, Dgram *d, uint32_t end) {
+	unsigned size = (end + IPFRAG_CHUNK - 1) & ~(IPFRAG_CHUNK - 1);
+	unsigned long old = dgram_mem(fh, d);
+	unsigned long delta = sizeof(Dgram) + fh->headroom + IPFRAG_MAX_HDR +
+			      size - old;
+	unsigned char *buf;
+	unsigned pre = fh->headroom + IPFRAG_MAX_HDR;
+
+	if (end <= d->bufsize)
+		return 0;
+	while (fh->st.mem_in_use + delta > fh->max_mem && fh->oldest &&
+	       fh->oldest != d) {
+		fh->st.evicted++;
+		dgram_drop(fh, fh->oldest);
+	}
+	if (fh->st.mem_in_use + delta > fh->max_mem)
+		return -1;
+	if (!(buf = (unsigned char *)mem_alloc(pre + size)))
+		return -1;
+	if (d->buf) {
+		memcpy(buf + pre, d->buf + pre, d->bufsize);
+		mem_free(d->buf);
+	}
+	d->buf = buf;
+	d->bufsize = size;
+	fh->st.mem_in_use += delta;
+	if (fh->st.mem_in_use > fh->st.mem_peak)
+		fh->st.mem_peak = fh->st.mem_in_use;
+	return 0;
+}
+
+/* add [start, end) to the received ranges of `d', merging neighbours
+ * returns 0 if successful, -1 if there are too many holes */
+static int add_range(Dgram *d, uint32_t start, uint32_t end) {
+	unsigned i = 0, j;
+
+	while (i < d->nranges && d->ranges[i].end < start)
+		i++;
+	j = i;
+	while (j < d->nranges && d->ranges[j].start <= end) {
+		if (d->ranges[j].start < start)
+			start = d->ranges[j].start;
+		if (d->ranges[j].end > end)
+			end = d->ranges[j].end;
+		j++;
+	}
+	if (i == j) {
+		/* nothing to merge with, open a slot at i */
+		if (d->nranges == IPFRAG_MAX_RANGES)
+			return -1;
+		memmove(&d->ranges[i + 1], &d->ranges[i],
+			(d->nranges - i) * sizeof(FragRange));
+		d->nranges++;
+	} else if (j > i + 1) {
+		memmove(&d->ranges[i + 1], &d->ranges[j],
+			(d->nranges - j) * sizeof(FragRange));
+		d->nranges -= j - i - 1;
+	}
+	d->ranges[i].start = start;
+	d->ranges[i].end = end;
+	return 0;
+}
+
+/* copy the parts of [start, end) nothing has been received for yet */
+static void copy_gaps(Dgram *d, unsigned char *payload,
+		      const unsigned char *data, uint32_t start, uint32_t end) {
+	uint32_t pos = start;
+	unsigned i;
+
+	for (i = 0; i < d->nranges && pos < end; i++) {
+		if (d->ranges[i].end <= pos)
+			continue;
+		if (d->ranges[i].start >= end)
+			break;
+		if (d->ranges[i].start > pos)
+			memcpy(payload + pos, data + (pos - start),
+			       d->ranges[i].start - pos);
+		pos = d->ranges[i].end;
+	}
+	if (pos < end)
+		memcpy(payload + pos, data + (pos - start), end - pos);
+}
+
+static uint16_t ip_checksum(const unsigned char *p, unsigned len) {
+	uint32_t sum = 0;
+
+	for (; len > 1; p += 2, len -= 2)
+		sum += (p[0] << 8) | p[1];
+	while (sum >> 16)
+		sum = (sum & 0xffff) + (sum >> 16);
+	return htons(~sum & 0xffff);
+}
+
+IPFrag ipfrag_create(unsigned long max_mem, unsigned timeout,
+		     enum ipfrag_overlap policy, unsigned headroom) {
+	IPFragHead *fh;
+
+	if (!(fh = (IPFragHead *)mem_alloc(sizeof(IPFragHead))))
+		return NULL;
+	memset(fh, 0, sizeof(IPFragHead));
+	fh->max_mem = max_mem;
+	fh->timeout = timeout;
+	fh->policy = policy;
+	fh->headroom = headroom;
+	return (IPFrag)fh;
+}
+
+unsigned ipfrag_add(IPFrag f, const struct iphdr *ip, unsigned len,
+		    uint32_t now, unsigned char **out) {
+	IPFragHead *fh = (IPFragHead *)f;
+	unsigned hl = ip->ihl * 4, tot = ntohs(ip->tot_len), i;
+	uint32_t start, end;
+	int mf = (ip->frag_off & htons(IPFRAG_MF)) != 0, overlap = 0;
+	unsigned char *payload;
+	struct iphdr *h;
+	Dgram *d;
+
+	if (fh->done) {
+		dgram_free(fh, fh->done);
+		fh->done = NULL;
+	}
+	fh->st.fragments++;
+	ipfrag_expire(f, now);
+
+	/* whole fragments only: no truncated captures, and all but the last
+	 * fragment carry a multiple of 8 bytes */
+	if (hl < 20 || tot < hl || len < tot) {
+		fh->st.dropped++;
+		return 0;
+	}
+	start = (ntohs(ip->frag_off) & IPFRAG_OFFMASK) * 8;
+	end = start + tot - hl;
+	if (end > IPFRAG_MAX_DGRAM - hl || (mf && (end == start || (end - start) & 7))) {
+		fh->st.dropped++;
+		return 0;
+	}
+	if (!(d = dgram_get(fh, ip, now))) {
+		fh->st.dropped++;
+		return 0;
+	}
+	/* the last fragment fixes the length, nothing may go beyond it */
+	if ((!mf && ((d->total && d->total != end) ||
+		     (d->nranges && d->ranges[d->nranges - 1].end > end))) ||
+	    (d->total && end > d->total)) {
+		fh->st.dropped++;
+		dgram_drop(fh, d);
+		return 0;
+	}
+	for (i = 0; i < d->nranges; i++)
+		if (d->ranges[i].start < end && start < d->ranges[i].end)
+			overlap = 1;
+	if (overlap) {
+		fh->st.overlaps++;
+		if (fh->policy == IPFRAG_DROP) {
+			dgram_drop(fh, d);
+			return 0;
+		}
+	}
+	if (dgram_grow(fh, d, end)) {
+		fh->st.evicted++;
+		dgram_drop(fh, d);
+		return 0;
+	}
+
+	payload = d->buf + fh->headroom + IPFRAG_MAX_HDR;
+	if (overlap && fh->policy == IPFRAG_KEEP_FIRST)
+		copy_gaps(d, payload, (const unsigned char *)ip + hl, start, end);
+	else
+		memcpy(payload + start, (const unsigned char *)ip + hl,
+		       end - start);
+	if (start == 0 && (!d->hdrlen || fh->policy != IPFRAG_KEEP_FIRST)) {
+		memcpy(d->hdr, ip, hl);
+		d->hdrlen = hl;
+	}
+	if (!mf)
+		d->total = end;
+	if (add_range(d, start, end)) {
+		fh->st.dropped++;
+		dgram_drop(fh, d);
+		return 0;
+	}
+
+	if (!d->total || !d->hdrlen || d->nranges != 1 ||
+	    d->ranges[0].start != 0 || d->ranges[0].end != d->total)
+		return 0;
+	/* the other fragments may have come with a shorter header */
+	if (d->hdrlen + d->total > IPFRAG_MAX_DGRAM) {
+		fh->st.dropped++;
+		dgram_drop(fh, d);
+		return 0;
+	}
+
+	/* complete: put the header of the first fragment in front of the
+	 * payload and make it describe an unfragmented datagram */
+	*out = payload - d->hdrlen;
+	memcpy(*out, d->hdr, d->hdrlen);
+	h = (struct iphdr *)*out;
+	h->tot_len = htons(d->hdrlen + d->total);
+	h->frag_off = 0;
+	h->check = 0;
+	h->check = ip_checksum(*out, d->hdrlen);
+	dgram_unlink(fh, d);
+	fh->done = d;
+	fh->st.reassembled++;
+	return d->hdrlen + d->total;
+}
+
+void ipfrag_expire(IPFrag f, uint32_t now) {
+	IPFragHead *fh = (IPFragHead *)f;
+
+	/* datagrams are on the age list in the order they started, and all
+	 * share the same timeout */
+	while (fh->oldest && (int32_t)(now - fh->oldest->expires) >= 0) {
+		fh->st.timeouts++;
+		dgram_drop(fh, fh->oldest);
+	}
+}
+
+void ipfrag_stats(IPFrag f, IPFragStats *st) {
+	*st = ((IPFragHead *)f)->st;
+}
+
+void ipfrag_destroy(IPFrag f) {
+	IPFragHead *fh = (IPFragHead *)f;
+
+	while (fh->oldest)
+		dgram_drop(fh, fh->oldest);
+	if (fh->done)
+		dgram_free(fh, fh->done);
+	mem_free(fh);
+}
@@ -0,0 +1,77 @@
+/*
+ * ipfrag.h - public data structures and entry points for IPv4 fragment
+ *            reassembly
+ *
+ * fragments are collected per datagram (source, destination, protocol
+ * and IP id) until the datagram is complete; it is then handed back as
+ * one unfragmented IP packet that can go through parsing and detection
+ * like any other
+ *
+ * memory is bounded: the buffers of all datagrams in progress never
+ * exceed the budget given at creation, the oldest datagrams are dropped
+ * to make room. Datagrams not completed within the timeout are dropped
+ * as well
+ *
+ * a reassembler is not thread-safe - each thread owns its own
+ */
+
+#ifndef _IPFRAG_H_INCLUDED_
+#define _IPFRAG_H_INCLUDED_
+
+#include <stdint.h>
+#include <arpa/inet.h>
+#include <linux/ip.h>
+
+typedef void *IPFrag;
+
+/* what to do with a fragment overlapping data already received */
+enum ipfrag_overlap {
+	IPFRAG_KEEP_FIRST,	/* keep the bytes received first */
+	IPFRAG_KEEP_LAST,	/* the later fragment overwrites them */
+	IPFRAG_DROP,		/* drop the whole datagram (RFC 5722 style) */
+};
+
+typedef struct ipfrag_stats {
+	unsigned long fragments;	/* fragments handed to ipfrag_add() */
+	unsigned long reassembled;	/* datagrams completed */
+	unsigned long timeouts;		/* datagrams dropped on timeout */
+	unsigned long evicted;		/* datagrams dropped for memory */
+	unsigned long overlaps;		/* fragments overlapping earlier data */
+	unsigned long dropped;		/* malformed or unmanageable fragments */
+	unsigned long in_progress;	/* datagrams currently collected */
+	unsigned long mem_in_use;	/* bytes of reassembly buffers */
+	unsigned long mem_peak;
+} IPFragStats;
+
+#define IPFRAG_MF 0x2000	/* more fragments, in host order frag_off */
+#define IPFRAG_OFFMASK 0x1fff	/* offset in 8 byte units */
+
+/* true if `ip' is a fragment rather than a whole datagram */
+#define IPFRAG_IS_FRAGMENT(ip) \
+	(((ip)->frag_off & htons(IPFRAG_MF | IPFRAG_OFFMASK)) != 0)
+
+/* constructor - buffers of the datagrams in progress are limited to
+ * `max_mem' bytes in total, a datagram is dropped `timeout' seconds after
+ * its first fragment; `headroom' bytes in front of every reassembled
+ * datagram are left free for the caller to put a link header in
+ * returns NULL if error */
+IPFrag ipfrag_create(unsigned long max_mem, unsigned timeout,
+		     enum ipfrag_overlap policy, unsigned headroom);
+
+/* add the fragment `ip' of `len' captured bytes seen at `now' (seconds)
+ * returns the length of the reassembled datagram, with *out pointing at
+ * its IP header, when this fragment completed it; 0 otherwise. The
+ * datagram stays valid until the next call */
+unsigned ipfrag_add(IPFrag f, const struct iphdr *ip, unsigned len,
+		    uint32_t now, unsigned char **out);
+
+/* drop datagrams whose timeout passed at `now' */
+void ipfrag_expire(IPFrag f, uint32_t now);
+
+/* fill in the counters */
+void ipfrag_stats(IPFrag f, IPFragStats *st);
+
+/* destructor */
+void ipfrag_destroy(IPFrag f);
+
+#endif /* _IPFRAG_H_INCLUDED_ */
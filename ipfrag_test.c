@@ -0,0 +1,227 @@
+/*
+ * ipfrag_test.c - test driver for the IPv4 fragment reassembly
+ *
+ * feeds hand made fragments to ipfrag_add() and checks the datagrams
+ * handed back and the counters; exits non-zero on the first failure
+ */
+
+#include "ipfrag.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#define HEADROOM 14
+#define TIMEOUT 30
+
+static unsigned char pkt[65536 + 60];
+
+/* build the fragment of datagram `id' covering payload [off, off + len)
+ * with a `hl' byte header; payload byte i of the datagram is `fill' + i */
+static struct iphdr *fragment(uint16_t id, unsigned hl, unsigned off,
+			      unsigned len, int mf, unsigned char fill) {
+	struct iphdr *ip = (struct iphdr *)pkt;
+	unsigned i;
+
+	memset(pkt, 0, hl);
+	ip->version = 4;
+	ip->ihl = hl / 4;
+	ip->tot_len = htons(hl + len);
+	ip->id = htons(id);
+	ip->frag_off = htons((mf ? IPFRAG_MF : 0) | off / 8);
+	ip->ttl = 64;
+	ip->protocol = IPPROTO_UDP;
+	ip->saddr = htonl(0x0a000001);
+	ip->daddr = htonl(0x0a000002);
+	for (i = 0; i < len; i++)
+		pkt[hl + i] = (unsigned char)(fill + off + i);
+	return ip;
+}
+
+static unsigned add(IPFrag f, struct iphdr *ip, uint32_t now,
+		    unsigned char **out) {
+	return ipfrag_add(f, ip, ntohs(ip->tot_len), now, out);
+}
+
+/* the reassembled datagram `out' carries `len' bytes filled from `fill' */
+static void check_dgram(unsigned char *out, unsigned n, unsigned hl,
+			unsigned len, unsigned char fill) {
+	struct iphdr *ip = (struct iphdr *)out;
+	unsigned i;
+
+	assert(n == hl + len);
+	assert(ntohs(ip->tot_len) == n);
+	assert(!IPFRAG_IS_FRAGMENT(ip));
+	for (i = 0; i < len; i++)
+		assert(out[hl + i] == (unsigned char)(fill + i));
+}
+
+static void test_in_order(void) {
+	IPFrag f = ipfrag_create(1 << 20, TIMEOUT, IPFRAG_KEEP_FIRST, HEADROOM);
+	unsigned char *out;
+	unsigned n;
+	IPFragStats st;
+
+	fputs("in order reassembly: ", stdout);
+	assert(f);
+	assert(add(f, fragment(1, 20, 0, 1480, 1, 0), 0, &out) == 0);
+	assert(add(f, fragment(1, 20, 1480, 1480, 1, 0), 0, &out) == 0);
+	n = add(f, fragment(1, 20, 2960, 100, 0, 0), 0, &out);
+	check_dgram(out, n, 20, 3060, 0);
+	ipfrag_stats(f, &st);
+	assert(st.fragments == 3 && st.reassembled == 1 && st.in_progress == 0);
+	ipfrag_destroy(f);
+	puts("passed");
+}
+
+static void test_out_of_order(void) {
+	IPFrag f = ipfrag_create(1 << 20, TIMEOUT, IPFRAG_KEEP_FIRST, HEADROOM);
+	unsigned char *out;
+	unsigned n;
+
+	fputs("out of order reassembly: ", stdout);
+	assert(add(f, fragment(2, 24, 3000, 40, 0, 0), 0, &out) == 0);
+	assert(add(f, fragment(2, 20, 1000, 2000, 1, 0), 0, &out) == 0);
+	n = add(f, fragment(2, 24, 0, 1000, 1, 0), 0, &out);
+	/* the header is the one of the first fragment */
+	check_dgram(out, n, 24, 3040, 0);
+	ipfrag_destroy(f);
+	puts("passed");
+}
+
+/* fragment 2 overwrites [800, 1200) of fragment 1 with other bytes */
+static unsigned overlap(enum ipfrag_overlap policy, unsigned char **out,
+			IPFragStats *st, IPFrag *f) {
+	unsigned n;
+
+	*f = ipfrag_create(1 << 20, TIMEOUT, policy, HEADROOM);
+	assert(add(*f, fragment(3, 20, 0, 1200, 1, 0), 0, out) == 0);
+	n = add(*f, fragment(3, 20, 800, 800, 1, 0x55), 0, out);
+	if (!n)
+		n = add(*f, fragment(3, 20, 1600, 16, 0, 0), 0, out);
+	ipfrag_stats(*f, st);
+	return n;
+}
+
+static void test_overlap(void) {
+	IPFrag f;
+	unsigned char *out;
+	IPFragStats st;
+	unsigned i, n;
+
+	fputs("overlap, keep first: ", stdout);
+	n = overlap(IPFRAG_KEEP_FIRST, &out, &st, &f);
+	assert(n == 20 + 1616 && st.overlaps == 1);
+	for (i = 0; i < 1200; i++)
+		assert(out[20 + i] == (unsigned char)i);
+	for (; i < 1600; i++)
+		assert(out[20 + i] == (unsigned char)(0x55 + i));
+	ipfrag_destroy(f);
+	puts("passed");
+
+	fputs("overlap, keep last: ", stdout);
+	n = overlap(IPFRAG_KEEP_LAST, &out, &st, &f);
+	assert(n == 20 + 1616 && st.overlaps == 1);
+	for (i = 0; i < 800; i++)
+		assert(out[20 + i] == (unsigned char)i);
+	for (; i < 1600; i++)
+		assert(out[20 + i] == (unsigned char)(0x55 + i));
+	ipfrag_destroy(f);
+	puts("passed");
+
+	fputs("overlap, drop: ", stdout);
+	n = overlap(IPFRAG_DROP, &out, &st, &f);
+	/* the last fragment starts a new datagram that is never completed */
+	assert(n == 0 && st.overlaps == 1 && st.reassembled == 0);
+	ipfrag_destroy(f);
+	puts("passed");
+}
+
+static void test_timeout(void) {
+	IPFrag f = ipfrag_create(1 << 20, TIMEOUT, IPFRAG_KEEP_FIRST, HEADROOM);
+	unsigned char *out;
+	IPFragStats st;
+
+	fputs("timeout: ", stdout);
+	assert(add(f, fragment(4, 20, 0, 8, 1, 0), 100, &out) == 0);
+	ipfrag_expire(f, 100 + TIMEOUT - 1);
+	ipfrag_stats(f, &st);
+	assert(st.timeouts == 0 && st.in_progress == 1);
+	/* the rest comes too late, the datagram is gone by then */
+	assert(add(f, fragment(4, 20, 8, 8, 0, 0), 100 + TIMEOUT, &out) == 0);
+	ipfrag_stats(f, &st);
+	assert(st.timeouts == 1 && st.reassembled == 0 && st.in_progress == 1);
+	ipfrag_expire(f, 100 + 2 * TIMEOUT);
+	ipfrag_stats(f, &st);
+	assert(st.timeouts == 2 && st.in_progress == 0 && st.mem_in_use == 0);
+	ipfrag_destroy(f);
+	puts("passed");
+}
+
+static void test_eviction(void) {
+	IPFrag f;
+	unsigned char *out;
+	IPFragStats st;
+	unsigned long one;
+
+	fputs("eviction: ", stdout);
+	f = ipfrag_create(1 << 20, TIMEOUT, IPFRAG_KEEP_FIRST, HEADROOM);
+	assert(add(f, fragment(5, 20, 0, 8, 1, 0), 0, &out) == 0);
+	ipfrag_stats(f, &st);
+	one = st.mem_in_use;
+	ipfrag_destroy(f);
+
+	/* room for two datagrams in progress: the third pushes out the
+	 * oldest, which can then no longer be completed */
+	f = ipfrag_create(2 * one, TIMEOUT, IPFRAG_KEEP_FIRST, HEADROOM);
+	assert(add(f, fragment(5, 20, 0, 8, 1, 0), 0, &out) == 0);
+	assert(add(f, fragment(6, 20, 0, 8, 1, 0), 1, &out) == 0);
+	assert(add(f, fragment(7, 20, 0, 8, 1, 0), 2, &out) == 0);
+	ipfrag_stats(f, &st);
+	assert(st.evicted == 1 && st.in_progress == 2);
+	assert(st.mem_in_use <= 2 * one && st.mem_peak <= 2 * one);
+	assert(add(f, fragment(7, 20, 8, 8, 0, 0), 3, &out) == 16 + 20);
+	assert(add(f, fragment(5, 20, 8, 8, 0, 0), 4, &out) == 0);
+	ipfrag_destroy(f);
+	puts("passed");
+}
+
+static void test_length_limit(void) {
+	IPFrag f = ipfrag_create(1 << 20, TIMEOUT, IPFRAG_KEEP_FIRST, HEADROOM);
+	unsigned char *out;
+	IPFragStats st;
+	unsigned n;
+
+	fputs("length limit: ", stdout);
+	/* 20 + 65512 = 65532 bytes fit */
+	assert(add(f, fragment(8, 20, 0, 65504, 1, 0), 0, &out) == 0);
+	n = add(f, fragment(8, 20, 65504, 8, 0, 0), 0, &out);
+	check_dgram(out, n, 20, 65512, 0);
+
+	/* with 40 bytes of options the same payload exceeds tot_len */
+	assert(add(f, fragment(9, 60, 0, 1000, 1, 0), 0, &out) == 0);
+	assert(add(f, fragment(9, 60, 65504, 8, 0, 0), 0, &out) == 0);
+	ipfrag_stats(f, &st);
+	assert(st.dropped == 1);
+
+	/* a short header on the last fragment does not get it past the
+	 * limit, the first fragment's header counts */
+	assert(add(f, fragment(10, 20, 65504, 8, 0, 0), 0, &out) == 0);
+	assert(add(f, fragment(10, 20, 1000, 64504, 1, 0), 0, &out) == 0);
+	assert(add(f, fragment(10, 60, 0, 1000, 1, 0), 0, &out) == 0);
+	ipfrag_stats(f, &st);
+	assert(st.dropped == 2 && st.reassembled == 1);
+	ipfrag_destroy(f);
+	puts("passed");
+}
+
+int main(void) {
+	test_in_order();
+	test_out_of_order();
+	test_overlap();
+	test_timeout();
+	test_eviction();
+	test_length_limit();
+	puts("all ipfrag tests passed");
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,68 @@
+/*
+ * lhist.c - implementation of log-bucket latency histograms
+ */
+
+#include "lhist.h"
+#include <string.h>
+
+/* largest value falling into bucket `b' */
+static uint64_t bucket_max(unsigned b) {
+	unsigned shift;
+
+	if (b < LHIST_SUB_BUCKETS)
+		return b;
+	shift = (b >> LHIST_SUB_BITS) - 1;
+	return (((uint64_t)(LHIST_SUB_BUCKETS | (b & (LHIST_SUB_BUCKETS - 1))) + 1)
+		<< shift) - 1;
+}
+
+void lhist_merge(LHist *dst, const LHist *src) {
+	unsigned i;
+
+	for (i = 0; i < LHIST_BUCKETS; i++)
+		dst->count[i] += __atomic_load_n(&src->count[i], __ATOMIC_RELAXED);
+}
+
+uint64_t lhist_total(const LHist *h) {
+	uint64_t n = 0;
+	unsigned i;
+
+	for (i = 0; i < LHIST_BUCKETS; i++)
+		n += __atomic_load_n(&h->count[i], __ATOMIC_RELAXED);
+	return n;
+}
+
+uint64_t lhist_quantile(const LHist *h, double q) {
+	uint64_t total, rank, n = 0;
+	unsigned i;
+
+	if ((total = lhist_total(h)) == 0)
+		return 0;
+	rank = (uint64_t)(q * total + 0.5);
+	if (rank < 1)
+		rank = 1;
+	for (i = 0; i < LHIST_BUCKETS; i++) {
+		n += __atomic_load_n(&h->count[i], __ATOMIC_RELAXED);
+		if (n >= rank)
+			return bucket_max(i);
+	}
+	return bucket_max(LHIST_BUCKETS - 1);
+}
+
+double lhist_cycles_per_ns(void) {
+	static double ratio = 0.0;
+	struct timespec nap = {0, 10000000}, t0, t1;
+	uint64_t c0, c1;
+	double ns;
+
+	if (ratio > 0.0)
+		return ratio;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	c0 = lhist_now();
+	nanosleep(&nap, NULL);
+	c1 = lhist_now();
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+	ratio = ns > 0 ? (c1 - c0) / ns : 1.0;
+	return ratio;
+}
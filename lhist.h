@@ -0,0 +1,84 @@
+/*
+ * lhist.h - public data structures and entry points for log-bucket latency
+ *           histograms
+ *
+ * values (cycles, as read by lhist_now()) go into buckets in the style of
+ * HdrHistogram: each power of two is split into 1 << LHIST_SUB_BITS
+ * linear sub-buckets, so a value is known to within 12.5% whatever its
+ * magnitude, and a histogram is a flat array of counters of fixed size
+ *
+ * recording is a bucket computation and one counter increment, done inline;
+ * a histogram has a single writer, which stores its counters with relaxed
+ * atomics, so other threads may merge and read it at any time without
+ * holding up the writer
+ */
+
+#ifndef _LHIST_H_INCLUDED_
+#define _LHIST_H_INCLUDED_
+
+#include <stdint.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define LHIST_SUB_BITS 3
+#define LHIST_SUB_BUCKETS (1 << LHIST_SUB_BITS)
+#define LHIST_BUCKETS ((64 - LHIST_SUB_BITS + 1) << LHIST_SUB_BITS)
+
+typedef struct lhist {
+	uint64_t count[LHIST_BUCKETS];
+} LHist;
+
+/*
+ * the current time in cycles - the TSC where there is one, nanoseconds
+ * otherwise
+ */
+static inline uint64_t lhist_now(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+/*
+ * the bucket of value `v'; values below LHIST_SUB_BUCKETS are exact
+ */
+static inline unsigned lhist_bucket(uint64_t v) {
+	unsigned msb;
+
+	if (v < LHIST_SUB_BUCKETS)
+		return (unsigned)v;
+	msb = 63 - __builtin_clzll(v);
+	return ((msb - LHIST_SUB_BITS + 1) << LHIST_SUB_BITS) |
+	       ((v >> (msb - LHIST_SUB_BITS)) & (LHIST_SUB_BUCKETS - 1));
+}
+
+/*
+ * writer: count value `v' in `h'
+ */
+static inline void lhist_record(LHist *h, uint64_t v) {
+	uint64_t *c = &h->count[lhist_bucket(v)];
+
+	__atomic_store_n(c, *c + 1, __ATOMIC_RELAXED);
+}
+
+/* add the counters of `src' to `dst'; `src' may be written concurrently */
+void lhist_merge(LHist *dst, const LHist *src);
+
+/* number of values counted in `h' */
+uint64_t lhist_total(const LHist *h);
+
+/* the value below which a fraction `q' (0 < q <= 1) of the values in `h'
+ * lie, as the upper bound of its bucket; 0 if `h' is empty */
+uint64_t lhist_quantile(const LHist *h, double q);
+
+/* rough number of lhist_now() cycles per nanosecond, measured over a few
+ * milliseconds on the first call */
+double lhist_cycles_per_ns(void);
+
+#endif /* _LHIST_H_INCLUDED_ */
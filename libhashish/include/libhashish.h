@@ -239,6 +239,7 @@ int hi_cmp_int16_t(const uint8_t *, const uint8_t *);
 int hi_cmp_uint16_t(const uint8_t *, const uint8_t *);
 int hi_cmp_int32_t(const uint8_t *, const uint8_t *);
 int hi_cmp_uint32_t(const uint8_t *, const uint8_t *);
+int hi_cmp_flow(const uint8_t *, const uint8_t *);
 
 /* hi_operations */
 int hi_insert(hi_handle_t *, const void *, uint32_t, const void *);
@@ -260,6 +261,47 @@ static inline uint32_t hi_table_size(hi_handle_t *h)
 
 double hi_table_load_factor(hi_handle_t *);
 
+/* Prefetch helpers for callers that look up several keys at once: first
+ * call hi_prefetch_bucket() for every key, then hi_prefetch_chain() for
+ * every key, then do the lookups. This overlaps the cache misses of the
+ * table walk. Only the list based collision engines are supported, the
+ * helpers are no-ops for all others. The hash value is the one returned
+ * by the table's hash function for the key.
+ */
+static inline void hi_prefetch_bucket(const hi_handle_t *h, uint32_t hash)
+{
+	switch (h->coll_eng) {
+	case COLL_ENG_LIST:
+	case COLL_ENG_LIST_HASH:
+	case COLL_ENG_LIST_MTF:
+	case COLL_ENG_LIST_MTF_HASH:
+		__builtin_prefetch(&h->eng_list.bucket_table[hash % h->table_size]);
+		break;
+	default:
+		break;
+	}
+}
+
+static inline void hi_prefetch_chain(const hi_handle_t *h, uint32_t hash)
+{
+	hi_bucket_obj_t *b_obj;
+
+	switch (h->coll_eng) {
+	case COLL_ENG_LIST:
+	case COLL_ENG_LIST_HASH:
+	case COLL_ENG_LIST_MTF:
+	case COLL_ENG_LIST_MTF_HASH:
+		b_obj = h->eng_list.bucket_table[hash % h->table_size];
+		if (b_obj != NULL) {
+			__builtin_prefetch(b_obj);
+			__builtin_prefetch(b_obj->key);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
 /* string specific functions */
 int hi_init_str(hi_handle_t **, const uint32_t);
 int hi_insert_str(hi_handle_t *, const char *, const void *);
@@ -287,6 +329,48 @@ int hi_insert_uint32_t(hi_handle_t *, const uint32_t, const void *);
 int hi_get_uint32_t(hi_handle_t *, const uint32_t, void **);
 int hi_remove_uint32_t(hi_handle_t *, const uint32_t, void **);
 
+/* IPv4 flow (5-tuple) specific functions
+ *
+ * The key is a packed, canonical representation of a bidirectional flow:
+ * the numerically lower address (and its port) always comes first, so both
+ * directions of a connection map to the same key. All fields are kept in
+ * network byte order, exactly as found in the packet. The structure is
+ * 16 bytes wide and hashed/compared as two 64 bit words - make sure the
+ * padding is zeroed (hi_flow_key_init() does that for you).
+ *
+ * NOTE: like every other key type the handle stores a pointer to the key,
+ * so an inserted key must stay valid as long as the entry lives in the
+ * table (e.g. embed it into the data object).
+ */
+struct hi_flow_key {
+	uint32_t lower_ip;
+	uint32_t upper_ip;
+	uint16_t lower_port;
+	uint16_t upper_port;
+	uint8_t  protocol;
+	uint8_t  pad[3];
+};
+
+static inline void hi_flow_key_init(struct hi_flow_key *k, uint32_t saddr,
+		uint16_t sport, uint32_t daddr, uint16_t dport, uint8_t protocol)
+{
+	if (saddr < daddr || (saddr == daddr && sport < dport)) {
+		k->lower_ip = saddr; k->lower_port = sport;
+		k->upper_ip = daddr; k->upper_port = dport;
+	} else {
+		k->lower_ip = daddr; k->lower_port = dport;
+		k->upper_ip = saddr; k->upper_port = sport;
+	}
+	k->protocol = protocol;
+	k->pad[0] = k->pad[1] = k->pad[2] = 0;
+}
+
+uint32_t hi_hash_flow(const uint8_t *, uint32_t);
+int hi_init_flow(hi_handle_t **, const uint32_t);
+int hi_insert_flow(hi_handle_t *, const struct hi_flow_key *, const void *);
+int hi_get_flow(hi_handle_t *, const struct hi_flow_key *, void **);
+int hi_remove_flow(hi_handle_t *, const struct hi_flow_key *, void **);
+
 
 
 /* BLOOM Filter Implementation */
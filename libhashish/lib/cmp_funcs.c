@@ -67,4 +67,19 @@ int hi_cmp_uint16_t(const uint8_t *key1, const uint8_t *key2)
 	return *a - *b;
 }
 
+/* struct hi_flow_key is 16 bytes - compare it as two 64 bit words */
+int hi_cmp_flow(const uint8_t *key1, const uint8_t *key2)
+{
+	uint64_t a[2], b[2];
+
+	memcpy(a, key1, sizeof(a));
+	memcpy(b, key2, sizeof(b));
+
+	if (a[0] != b[0])
+		return a[0] < b[0] ? -1 : 1;
+	if (a[1] != b[1])
+		return a[1] < b[1] ? -1 : 1;
+	return 0;
+}
+
 /* vim:set ts=4 sw=4 tw=78 noet: */
@@ -0,0 +1,86 @@
+/*
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#include <string.h>
+
+#include "privlibhashish.h"
+
+/**
+ * hi_hash_flow is a fixed width hash function for struct hi_flow_key. The
+ * key is folded into two 64 bit words and mixed with the murmur3 finalizer,
+ * no byte loop is involved. The length argument is ignored, it is only
+ * present to match the generic hash function signature.
+ *
+ * @arg key pointer to a struct hi_flow_key
+ * @arg len ignored
+ * @returns the 32 bit hash value
+ */
+uint32_t hi_hash_flow(const uint8_t *key, uint32_t len)
+{
+	uint64_t w[2], h;
+
+	(void) len;
+
+	memcpy(w, key, sizeof(w));
+
+	h = w[0] ^ (w[1] * 0x9e3779b97f4a7c15ULL);
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+
+	return (uint32_t) h;
+}
+
+/**
+ * This is the default initialize function for struct hi_flow_key. It takes
+ * hi_hash_flow() as the hash function, hi_cmp_flow() as the compare function
+ * and select as the collision engine the list (COLL_ENG_LIST) based one.
+ *
+ * @arg hi_hndl	this become out new hashish handle
+ * @arg table_size dedicates the table size
+ * @returns negativ error value or zero on success
+ */
+int hi_init_flow(hi_handle_t **hi_hndl, const uint32_t table_size)
+{
+	struct hi_init_set hi_set;
+
+	hi_set_zero(&hi_set);
+	hi_set_bucket_size(&hi_set, table_size);
+	hi_set_hash_func(&hi_set, hi_hash_flow);
+	hi_set_coll_eng(&hi_set, COLL_ENG_LIST);
+	hi_set_key_cmp_func(&hi_set, hi_cmp_flow);
+
+	return hi_create(hi_hndl, &hi_set);
+}
+
+int hi_insert_flow(hi_handle_t *hi_hndl, const struct hi_flow_key *key, const void *data)
+{
+	return hi_insert(hi_hndl, key, sizeof(struct hi_flow_key), data);
+}
+
+int hi_get_flow(hi_handle_t *hi_hndl, const struct hi_flow_key *key, void **data)
+{
+	return hi_get(hi_hndl, key, sizeof(struct hi_flow_key), data);
+}
+
+int hi_remove_flow(hi_handle_t *hi_hndl, const struct hi_flow_key *key, void **data)
+{
+	return hi_remove(hi_hndl, (void *) key, sizeof(struct hi_flow_key), data);
+}
+
+/* vim:set ts=4 sw=4 sts=4 tw=78 ff=unix noet: */
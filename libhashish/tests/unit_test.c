@@ -626,6 +626,49 @@ static void check_uint32_wrapper(void)
 	puts(" passed");
 }
 
+static void check_flow_wrapper(void)
+{
+	int ret;
+	hi_handle_t *hi_handle;
+	struct hi_flow_key key, rkey, okey;
+	int data = 666, *val;
+	void *data_ptr;
+
+	fputs(" o check flow wrapper functions tests ...", stdout);
+
+	/* both directions of a connection must map to the same key */
+	hi_flow_key_init(&key, 0x0a000001, 80, 0x0a000002, 1234, 6);
+	hi_flow_key_init(&rkey, 0x0a000002, 1234, 0x0a000001, 80, 6);
+	assert(hi_cmp_flow((uint8_t *) &key, (uint8_t *) &rkey) == 0);
+	assert(hi_hash_flow((uint8_t *) &key, 0) == hi_hash_flow((uint8_t *) &rkey, 0));
+
+	/* ... but another transport protocol is another flow */
+	hi_flow_key_init(&okey, 0x0a000001, 80, 0x0a000002, 1234, 17);
+	assert(hi_cmp_flow((uint8_t *) &key, (uint8_t *) &okey) != 0);
+
+	ret = hi_init_flow(&hi_handle, 23);
+	assert(ret == 0);
+
+	ret = hi_insert_flow(hi_handle, &key, &data);
+	assert(ret == 0);
+
+	ret = hi_get_flow(hi_handle, &rkey, &data_ptr);
+	assert(ret == 0);
+	val = data_ptr;
+	assert(*val == data);
+
+	ret = hi_get_flow(hi_handle, &okey, &data_ptr);
+	assert(ret == HI_ERR_NOKEY);
+
+	ret = hi_remove_flow(hi_handle, &rkey, &data_ptr);
+	assert(ret == 0);
+	assert(hi_no_objects(hi_handle) == 0);
+
+	ret = hi_fini(hi_handle);
+	assert(ret == 0);
+
+	puts(" passed");
+}
 
 
 
@@ -675,6 +718,7 @@ main(void)
 	check_uint16_wrapper();
 	check_int32_wrapper();
 	check_uint32_wrapper();
+	check_flow_wrapper();
 	check_hi_load_factor();
 
 	puts("\nall tests passed - great!");
@@ -58,6 +58,7 @@ extern "C" {
 #define IPOQUE_CONVERT_PROTOCOL_TO_BITMASK(p) ( ((IPOQUE_PROTOCOL_BITMASK)1) << (p) )
 #define IPOQUE_SAVE_AS_BITMASK(bitmask,value) (bitmask)=(((IPOQUE_PROTOCOL_BITMASK)1)<<(value))
 #define IPOQUE_BITMASK_COMPARE(a,b)	((a) & (b))
+#define IPOQUE_BITMASK_INTERSECTS(a,b)	(((a) & (b)) != 0)
 #define IPOQUE_BITMASK_MATCH(x,y)	((x) == (y))
 
 // all protocols in b are also in a
@@ -98,6 +99,9 @@ extern "C" {
 
 #define IPOQUE_BITMASK_COMPARE(a,b)	(((a).bitmask[0]) & ((b).bitmask[0]) || ((a).bitmask[1]) & ((b).bitmask[1]))
 
+// same as IPOQUE_BITMASK_COMPARE without branches, for the hot loops
+#define IPOQUE_BITMASK_INTERSECTS(a,b)	(((((a).bitmask[0]) & ((b).bitmask[0])) | (((a).bitmask[1]) & ((b).bitmask[1]))) != 0)
+
 #define IPOQUE_BITMASK_MATCH(a,b)	(((a).bitmask[0]) == ((b).bitmask[0]) && ((a).bitmask[1]) == ((b).bitmask[1]))
 
 // all protocols in b are also in a
@@ -145,6 +149,9 @@ extern "C" {
 
 #define IPOQUE_BITMASK_COMPARE(a,b) (((a).bitmask[0]) & ((b).bitmask[0]) || ((a).bitmask[1]) & ((b).bitmask[1]) || ((a).bitmask[2]) & ((b).bitmask[2]))
 
+// same as IPOQUE_BITMASK_COMPARE without branches, for the hot loops
+#define IPOQUE_BITMASK_INTERSECTS(a,b) (((((a).bitmask[0]) & ((b).bitmask[0])) | (((a).bitmask[1]) & ((b).bitmask[1])) | (((a).bitmask[2]) & ((b).bitmask[2]))) != 0)
+
 #define IPOQUE_BITMASK_MATCH(a,b) (((a).bitmask[0]) == ((b).bitmask[0]) && ((a).bitmask[1]) == ((b).bitmask[1]) && ((a).bitmask[2]) == ((b).bitmask[2]))
 
 // all protocols in b are also in a
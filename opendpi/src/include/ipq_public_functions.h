@@ -45,6 +45,54 @@ extern "C" {
 	u32 ipoque_detection_get_sizeof_ipoque_id_struct(void);
 
 
+	/* the configuration - protocol selection and parameters - can be set up
+	 * once and shared read-only by the workspaces of several threads; the
+	 * module functions below keep a private configuration per module */
+	struct ipoque_detection_config_struct *ipoque_init_detection_config(u32 ticks_per_second, void
+																		*(*ipoque_malloc)
+																		 (unsigned
+																		  long size),
+																		ipoque_debug_function_ptr ipoque_debug_printf);
+	void
+	 ipoque_exit_detection_config(struct ipoque_detection_config_struct
+								  *cfg, void (*ipoque_free) (void *ptr));
+
+	void
+	 ipoque_set_config_detection_bitmask(struct
+										 ipoque_detection_config_struct
+										 *cfg, const IPOQUE_PROTOCOL_BITMASK * detection_bitmask);
+
+	/* port hints: a packet of a flow without protocol goes to the dissector
+	 * of the protocol hinted for its destination, or else source, port
+	 * first; ipoque_init_detection_config() installs hints for well-known
+	 * ports. `port' is in host order, IPOQUE_PROTOCOL_UNKNOWN removes the
+	 * hint of the port; returns 1 if successful, 0 if the table is full */
+	int ipoque_set_config_port_hint(struct ipoque_detection_config_struct *cfg, u16 port, u32 protocol);
+
+	/* remove all port hints, which turns the fast path off */
+	void ipoque_clear_config_port_hints(struct ipoque_detection_config_struct *cfg);
+
+	/* refinable protocols are those later dissectors may still turn into
+	 * another one, as HTTP into its sub-protocols; detecting any other
+	 * protocol is final and ends the dissector loop of the packet.
+	 * ipoque_set_config_detection_bitmask() takes them from the dissectors,
+	 * call this afterwards to replace them */
+	void ipoque_set_config_refinable_protocols(struct ipoque_detection_config_struct *cfg,
+											   const IPOQUE_PROTOCOL_BITMASK * refinable);
+
+	/* number of dissectors enabled in `cfg'; the per-flow set of excluded
+	 * dissectors is indexed by their position, so flow state saved under
+	 * another count must not be reused */
+	u32 ipoque_get_config_callback_count(const struct ipoque_detection_config_struct *cfg);
+
+	/* a workspace on `cfg', which has to outlive it; it is freed with
+	 * ipoque_exit_detection_module() */
+	struct ipoque_detection_module_struct *ipoque_init_detection_workspace(const struct
+																		   ipoque_detection_config_struct
+																		   *cfg, void
+																		   *(*ipoque_malloc)
+																		    (unsigned long size));
+
 	struct ipoque_detection_module_struct *ipoque_init_detection_module(u32 ticks_per_second, void
 																		*(*ipoque_malloc)
 																		 (unsigned
@@ -54,6 +102,9 @@ extern "C" {
 	 ipoque_exit_detection_module(struct ipoque_detection_module_struct
 								  *ipoque_struct, void (*ipoque_free) (void *ptr));
 
+	/* only for a module from ipoque_init_detection_module(); on a workspace
+	 * the shared configuration is read-only and this does nothing, set its
+	 * protocols with ipoque_set_config_detection_bitmask() instead */
 	void
 	 ipoque_set_protocol_detection_bitmask2(struct
 											ipoque_detection_module_struct
@@ -64,6 +115,10 @@ extern "C" {
 									 const unsigned char *packet,
 									 const unsigned short packetlen,
 									 const IPOQUE_TIMESTAMP_COUNTER_SIZE current_tick, void *src, void *dst);
+
+	/* 1 if the protocol detected for the last packet is final, no later
+	 * packet of the flow can change it */
+	u8 ipoque_detection_is_final(const struct ipoque_detection_module_struct *ipoque_struct);
 #ifdef __cplusplus
 }
 #endif
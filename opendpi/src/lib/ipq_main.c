@@ -34,57 +34,325 @@ u32 ipoque_detection_get_sizeof_ipoque_id_struct(void)
 }
 
 
-struct ipoque_detection_module_struct *ipoque_init_detection_module(u32 ticks_per_second, void
+/* default port hints, the ports the dissectors check themselves and the
+ * well-known ports of the common protocols */
+static const struct {
+	u16 port;
+	u8 protocol;
+} ipq_default_port_hints[] = {
+#ifdef IPOQUE_PROTOCOL_FTP
+	{21, IPOQUE_PROTOCOL_FTP},
+#endif
+#ifdef IPOQUE_PROTOCOL_SSH
+	{22, IPOQUE_PROTOCOL_SSH},
+#endif
+#ifdef IPOQUE_PROTOCOL_TELNET
+	{23, IPOQUE_PROTOCOL_TELNET},
+#endif
+#ifdef IPOQUE_PROTOCOL_MAIL_SMTP
+	{25, IPOQUE_PROTOCOL_MAIL_SMTP},
+	{587, IPOQUE_PROTOCOL_MAIL_SMTP},
+#endif
+#ifdef IPOQUE_PROTOCOL_DNS
+	{53, IPOQUE_PROTOCOL_DNS},
+#endif
+#ifdef IPOQUE_PROTOCOL_DHCP
+	{67, IPOQUE_PROTOCOL_DHCP},
+	{68, IPOQUE_PROTOCOL_DHCP},
+#endif
+#ifdef IPOQUE_PROTOCOL_TFTP
+	{69, IPOQUE_PROTOCOL_TFTP},
+#endif
+#ifdef IPOQUE_PROTOCOL_HTTP
+	{80, IPOQUE_PROTOCOL_HTTP},
+	{8080, IPOQUE_PROTOCOL_HTTP},
+#endif
+#ifdef IPOQUE_PROTOCOL_MAIL_POP
+	{110, IPOQUE_PROTOCOL_MAIL_POP},
+#endif
+#ifdef IPOQUE_PROTOCOL_USENET
+	{119, IPOQUE_PROTOCOL_USENET},
+#endif
+#ifdef IPOQUE_PROTOCOL_NTP
+	{123, IPOQUE_PROTOCOL_NTP},
+#endif
+#ifdef IPOQUE_PROTOCOL_NETBIOS
+	{137, IPOQUE_PROTOCOL_NETBIOS},
+	{138, IPOQUE_PROTOCOL_NETBIOS},
+	{139, IPOQUE_PROTOCOL_NETBIOS},
+#endif
+#ifdef IPOQUE_PROTOCOL_MAIL_IMAP
+	{143, IPOQUE_PROTOCOL_MAIL_IMAP},
+#endif
+#ifdef IPOQUE_PROTOCOL_SNMP
+	{161, IPOQUE_PROTOCOL_SNMP},
+	{162, IPOQUE_PROTOCOL_SNMP},
+#endif
+#ifdef IPOQUE_PROTOCOL_BGP
+	{179, IPOQUE_PROTOCOL_BGP},
+#endif
+#ifdef IPOQUE_PROTOCOL_SSL
+	{443, IPOQUE_PROTOCOL_SSL},
+#endif
+#ifdef IPOQUE_PROTOCOL_SMB
+	{445, IPOQUE_PROTOCOL_SMB},
+#endif
+#ifdef IPOQUE_PROTOCOL_SYSLOG
+	{514, IPOQUE_PROTOCOL_SYSLOG},
+#endif
+#ifdef IPOQUE_PROTOCOL_RTSP
+	{554, IPOQUE_PROTOCOL_RTSP},
+#endif
+#ifdef IPOQUE_PROTOCOL_IPP
+	{631, IPOQUE_PROTOCOL_IPP},
+#endif
+#ifdef IPOQUE_PROTOCOL_TDS
+	{1433, IPOQUE_PROTOCOL_TDS},
+#endif
+#ifdef IPOQUE_PROTOCOL_IMESH
+	{1864, IPOQUE_PROTOCOL_IMESH},
+#endif
+#ifdef IPOQUE_PROTOCOL_SSDP
+	{1900, IPOQUE_PROTOCOL_SSDP},
+#endif
+#ifdef IPOQUE_PROTOCOL_NFS
+	{2049, IPOQUE_PROTOCOL_NFS},
+#endif
+#ifdef IPOQUE_PROTOCOL_MYSQL
+	{3306, IPOQUE_PROTOCOL_MYSQL},
+#endif
+#ifdef IPOQUE_PROTOCOL_RDP
+	{3389, IPOQUE_PROTOCOL_RDP},
+#endif
+#ifdef IPOQUE_PROTOCOL_STUN
+	{3478, IPOQUE_PROTOCOL_STUN},
+#endif
+#ifdef IPOQUE_PROTOCOL_WORLDOFWARCRAFT
+	{3724, IPOQUE_PROTOCOL_WORLDOFWARCRAFT},
+#endif
+#ifdef IPOQUE_PROTOCOL_IAX
+	{4569, IPOQUE_PROTOCOL_IAX},
+#endif
+#ifdef IPOQUE_PROTOCOL_EDONKEY
+	{4662, IPOQUE_PROTOCOL_EDONKEY},
+#endif
+#ifdef IPOQUE_PROTOCOL_ZATTOO
+	{5003, IPOQUE_PROTOCOL_ZATTOO},
+#endif
+#ifdef IPOQUE_PROTOCOL_SIP
+	{5060, IPOQUE_PROTOCOL_SIP},
+#endif
+#ifdef IPOQUE_PROTOCOL_YAHOO
+	{5100, IPOQUE_PROTOCOL_YAHOO},
+#endif
+#ifdef IPOQUE_PROTOCOL_UNENCRYPED_JABBER
+	{5222, IPOQUE_PROTOCOL_UNENCRYPED_JABBER},
+#endif
+#ifdef IPOQUE_PROTOCOL_MDNS
+	{5353, IPOQUE_PROTOCOL_MDNS},
+#endif
+#ifdef IPOQUE_PROTOCOL_POSTGRES
+	{5432, IPOQUE_PROTOCOL_POSTGRES},
+#endif
+#ifdef IPOQUE_PROTOCOL_PCANYWHERE
+	{5632, IPOQUE_PROTOCOL_PCANYWHERE},
+#endif
+#ifdef IPOQUE_PROTOCOL_VNC
+	{5900, IPOQUE_PROTOCOL_VNC},
+#endif
+#ifdef IPOQUE_PROTOCOL_IRC
+	{6667, IPOQUE_PROTOCOL_IRC},
+#endif
+#ifdef IPOQUE_PROTOCOL_BITTORRENT
+	{6881, IPOQUE_PROTOCOL_BITTORRENT},
+#endif
+#ifdef IPOQUE_PROTOCOL_QQ
+	{9000, IPOQUE_PROTOCOL_QQ},
+#endif
+#ifdef IPOQUE_PROTOCOL_MANOLITO
+	{41170, IPOQUE_PROTOCOL_MANOLITO},
+#endif
+};
+
+static inline u32 ipq_port_hint_slot(u16 port)
+{
+	return ((u32) port * 0x9E37) >> 8 & (IPQ_PORT_HINT_SLOTS - 1);
+}
+
+int ipoque_set_config_port_hint(struct ipoque_detection_config_struct *cfg, u16 port, u32 protocol)
+{
+	u32 i, n;
+
+	if (port == 0 || protocol > IPOQUE_MAX_SUPPORTED_PROTOCOLS) {
+		return 0;
+	}
+	for (i = ipq_port_hint_slot(port), n = 0; n < IPQ_PORT_HINT_SLOTS; i = (i + 1) & (IPQ_PORT_HINT_SLOTS - 1), n++) {
+		if (cfg->port_hint[i].port == port) {
+			cfg->port_hint[i].protocol = protocol;
+			return 1;
+		}
+		if (cfg->port_hint[i].port == 0) {
+			if (protocol == IPOQUE_PROTOCOL_UNKNOWN) {
+				return 1;
+			}
+			/* keep a slot free, it ends the lookups */
+			if (cfg->port_hint_count + 1 >= IPQ_PORT_HINT_SLOTS) {
+				return 0;
+			}
+			cfg->port_hint[i].port = port;
+			cfg->port_hint[i].protocol = protocol;
+			cfg->port_hint_count++;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+void ipoque_clear_config_port_hints(struct ipoque_detection_config_struct *cfg)
+{
+	memset(cfg->port_hint, 0, sizeof(cfg->port_hint));
+	cfg->port_hint_count = 0;
+}
+
+void ipoque_set_config_refinable_protocols(struct ipoque_detection_config_struct *cfg,
+										   const IPOQUE_PROTOCOL_BITMASK * refinable)
+{
+	IPOQUE_BITMASK_SET(cfg->refinable_bitmask, *refinable);
+}
+
+u8 ipoque_detection_is_final(const struct ipoque_detection_module_struct *ipoque_struct)
+{
+	u32 protocol = ipoque_struct->packet.detected_protocol;
+
+	return protocol != IPOQUE_PROTOCOL_UNKNOWN
+		&& IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(ipoque_struct->cfg->refinable_bitmask, protocol) == 0;
+}
+
+u32 ipoque_get_config_callback_count(const struct ipoque_detection_config_struct *cfg)
+{
+	return cfg->callback_buffer_size;
+}
+
+/* hinted protocol of `port', in network order */
+static inline u32 ipq_port_hint(const struct ipoque_detection_config_struct *cfg, u16 port)
+{
+	u32 i;
+
+	port = ntohs(port);
+	for (i = ipq_port_hint_slot(port); cfg->port_hint[i].port != 0; i = (i + 1) & (IPQ_PORT_HINT_SLOTS - 1)) {
+		if (cfg->port_hint[i].port == port) {
+			return cfg->port_hint[i].protocol;
+		}
+	}
+	return IPOQUE_PROTOCOL_UNKNOWN;
+}
+
+struct ipoque_detection_config_struct *ipoque_init_detection_config(u32 ticks_per_second, void
 																	*(*ipoque_malloc)
 																	 (unsigned
 																	  long size),
 																	ipoque_debug_function_ptr ipoque_debug_printf)
 {
-	struct ipoque_detection_module_struct *ipq_str;
-	ipq_str = ipoque_malloc(sizeof(struct ipoque_detection_module_struct));
+	struct ipoque_detection_config_struct *cfg;
+	u32 i;
 
-	if (ipq_str == NULL) {
-		ipoque_debug_printf(0, NULL, IPQ_LOG_DEBUG, "ipoque_init_detection_module initial malloc failed\n");
+	cfg = ipoque_malloc(sizeof(struct ipoque_detection_config_struct));
+
+	if (cfg == NULL) {
+		ipoque_debug_printf(0, NULL, IPQ_LOG_DEBUG, "ipoque_init_detection_config initial malloc failed\n");
 		return NULL;
 	}
-	memset(ipq_str, 0, sizeof(struct ipoque_detection_module_struct));
+	memset(cfg, 0, sizeof(struct ipoque_detection_config_struct));
 
 
-	IPOQUE_BITMASK_RESET(ipq_str->detection_bitmask);
+	IPOQUE_BITMASK_RESET(cfg->detection_bitmask);
 #ifdef IPOQUE_ENABLE_DEBUG_MESSAGES
-	ipq_str->ipoque_debug_printf = ipoque_debug_printf;
-	ipq_str->user_data = NULL;
+	cfg->ipoque_debug_printf = ipoque_debug_printf;
 #endif
 
 
-	ipq_str->ticks_per_second = ticks_per_second;
-	ipq_str->tcp_max_retransmission_window_size = IPOQUE_DEFAULT_MAX_TCP_RETRANSMISSION_WINDOW_SIZE;
-	ipq_str->directconnect_connection_ip_tick_timeout =
+	cfg->ticks_per_second = ticks_per_second;
+	cfg->tcp_max_retransmission_window_size = IPOQUE_DEFAULT_MAX_TCP_RETRANSMISSION_WINDOW_SIZE;
+	cfg->directconnect_connection_ip_tick_timeout =
 		IPOQUE_DIRECTCONNECT_CONNECTION_IP_TICK_TIMEOUT * ticks_per_second;
 
-	ipq_str->gadugadu_peer_connection_timeout = IPOQUE_GADGADU_PEER_CONNECTION_TIMEOUT * ticks_per_second;
-	ipq_str->edonkey_upper_ports_only = IPOQUE_EDONKEY_UPPER_PORTS_ONLY;
-	ipq_str->ftp_connection_timeout = IPOQUE_FTP_CONNECTION_TIMEOUT * ticks_per_second;
+	cfg->gadugadu_peer_connection_timeout = IPOQUE_GADGADU_PEER_CONNECTION_TIMEOUT * ticks_per_second;
+	cfg->edonkey_upper_ports_only = IPOQUE_EDONKEY_UPPER_PORTS_ONLY;
+	cfg->ftp_connection_timeout = IPOQUE_FTP_CONNECTION_TIMEOUT * ticks_per_second;
+
+	cfg->imesh_connection_timeout = IPOQUE_IMESH_CONNECTION_TIMEOUT * ticks_per_second;
+	cfg->pplive_connection_timeout = IPOQUE_PPLIVE_CONNECTION_TIMEOUT * ticks_per_second;
+
+	cfg->rtsp_connection_timeout = IPOQUE_RTSP_CONNECTION_TIMEOUT * ticks_per_second;
+	cfg->tvants_connection_timeout = IPOQUE_TVANTS_CONNECTION_TIMEOUT * ticks_per_second;
+	cfg->irc_timeout = IPOQUE_IRC_CONNECTION_TIMEOUT * ticks_per_second;
+	cfg->gnutella_timeout = IPOQUE_GNUTELLA_CONNECTION_TIMEOUT * ticks_per_second;
+
+	cfg->battlefield_timeout = IPOQUE_BATTLEFIELD_CONNECTION_TIMEOUT * ticks_per_second;
+
+	cfg->thunder_timeout = IPOQUE_THUNDER_CONNECTION_TIMEOUT * ticks_per_second;
+	cfg->yahoo_detect_http_connections = IPOQUE_YAHOO_DETECT_HTTP_CONNECTIONS;
 
-	ipq_str->imesh_connection_timeout = IPOQUE_IMESH_CONNECTION_TIMEOUT * ticks_per_second;
-	ipq_str->pplive_connection_timeout = IPOQUE_PPLIVE_CONNECTION_TIMEOUT * ticks_per_second;
+	cfg->yahoo_lan_video_timeout = IPOQUE_YAHOO_LAN_VIDEO_TIMEOUT * ticks_per_second;
+	cfg->zattoo_connection_timeout = IPOQUE_ZATTOO_CONNECTION_TIMEOUT * ticks_per_second;
+	cfg->jabber_stun_timeout = IPOQUE_JABBER_STUN_TIMEOUT * ticks_per_second;
+	cfg->jabber_file_transfer_timeout = IPOQUE_JABBER_FT_TIMEOUT * ticks_per_second;
+	cfg->soulseek_connection_ip_tick_timeout = IPOQUE_SOULSEEK_CONNECTION_IP_TICK_TIMEOUT * ticks_per_second;
+	cfg->manolito_subscriber_timeout = IPOQUE_MANOLITO_SUBSCRIBER_TIMEOUT;
+
+	for (i = 0; i < sizeof(ipq_default_port_hints) / sizeof(ipq_default_port_hints[0]); i++) {
+		ipoque_set_config_port_hint(cfg, ipq_default_port_hints[i].port, ipq_default_port_hints[i].protocol);
+	}
+	return cfg;
+}
+
+void ipoque_exit_detection_config(struct ipoque_detection_config_struct
+								  *cfg, void (*ipoque_free) (void *ptr))
+{
+	if (cfg != NULL) {
+		ipoque_free(cfg);
+	}
+}
 
-	ipq_str->rtsp_connection_timeout = IPOQUE_RTSP_CONNECTION_TIMEOUT * ticks_per_second;
-	ipq_str->tvants_connection_timeout = IPOQUE_TVANTS_CONNECTION_TIMEOUT * ticks_per_second;
-	ipq_str->irc_timeout = IPOQUE_IRC_CONNECTION_TIMEOUT * ticks_per_second;
-	ipq_str->gnutella_timeout = IPOQUE_GNUTELLA_CONNECTION_TIMEOUT * ticks_per_second;
+struct ipoque_detection_module_struct *ipoque_init_detection_workspace(const struct
+																	   ipoque_detection_config_struct
+																	   *cfg, void
+																	   *(*ipoque_malloc)
+																	    (unsigned long size))
+{
+	struct ipoque_detection_module_struct *ipq_str;
+	ipq_str = ipoque_malloc(sizeof(struct ipoque_detection_module_struct));
 
-	ipq_str->battlefield_timeout = IPOQUE_BATTLEFIELD_CONNECTION_TIMEOUT * ticks_per_second;
+	if (ipq_str == NULL) {
+		return NULL;
+	}
+	memset(ipq_str, 0, sizeof(struct ipoque_detection_module_struct));
+	ipq_str->cfg = cfg;
+#ifdef IPOQUE_ENABLE_DEBUG_MESSAGES
+	ipq_str->user_data = NULL;
+#endif
+	return ipq_str;
+}
 
-	ipq_str->thunder_timeout = IPOQUE_THUNDER_CONNECTION_TIMEOUT * ticks_per_second;
-	ipq_str->yahoo_detect_http_connections = IPOQUE_YAHOO_DETECT_HTTP_CONNECTIONS;
+struct ipoque_detection_module_struct *ipoque_init_detection_module(u32 ticks_per_second, void
+																	*(*ipoque_malloc)
+																	 (unsigned
+																	  long size),
+																	ipoque_debug_function_ptr ipoque_debug_printf)
+{
+	struct ipoque_detection_config_struct *cfg;
+	struct ipoque_detection_module_struct *ipq_str;
 
-	ipq_str->yahoo_lan_video_timeout = IPOQUE_YAHOO_LAN_VIDEO_TIMEOUT * ticks_per_second;
-	ipq_str->zattoo_connection_timeout = IPOQUE_ZATTOO_CONNECTION_TIMEOUT * ticks_per_second;
-	ipq_str->jabber_stun_timeout = IPOQUE_JABBER_STUN_TIMEOUT * ticks_per_second;
-	ipq_str->jabber_file_transfer_timeout = IPOQUE_JABBER_FT_TIMEOUT * ticks_per_second;
-	ipq_str->soulseek_connection_ip_tick_timeout = IPOQUE_SOULSEEK_CONNECTION_IP_TICK_TIMEOUT * ticks_per_second;
-	ipq_str->manolito_subscriber_timeout = IPOQUE_MANOLITO_SUBSCRIBER_TIMEOUT;
+	cfg = ipoque_init_detection_config(ticks_per_second, ipoque_malloc, ipoque_debug_printf);
+	if (cfg == NULL) {
+		return NULL;
+	}
+	ipq_str = ipoque_init_detection_workspace(cfg, ipoque_malloc);
+	if (ipq_str == NULL) {
+		ipoque_debug_printf(0, NULL, IPQ_LOG_DEBUG, "ipoque_init_detection_module initial malloc failed\n");
+		return NULL;
+	}
+	ipq_str->own_cfg = cfg;
 	return ipq_str;
 }
 
@@ -92,23 +360,95 @@ void ipoque_exit_detection_module(struct ipoque_detection_module_struct
 								  *ipoque_struct, void (*ipoque_free) (void *ptr))
 {
 	if (ipoque_struct != NULL) {
+		ipoque_exit_detection_config(ipoque_struct->own_cfg, ipoque_free);
 		ipoque_free(ipoque_struct);
 	}
 }
 
 void ipoque_set_protocol_detection_bitmask2(struct ipoque_detection_module_struct
 											*ipoque_struct, const IPOQUE_PROTOCOL_BITMASK * dbm)
+{
+	/* a shared configuration is set up through its own handle */
+	if (ipoque_struct->own_cfg != NULL) {
+		ipoque_set_config_detection_bitmask(ipoque_struct->own_cfg, dbm);
+	} else if (ipoque_struct->cfg->ipoque_debug_printf != NULL) {
+		ipoque_struct->cfg->ipoque_debug_printf(0, NULL, IPQ_LOG_DEBUG,
+				"ipoque_set_protocol_detection_bitmask2 ignored on a workspace, "
+				"use ipoque_set_config_detection_bitmask on its config\n");
+	}
+}
+
+/* selection bits of the packets of dispatch class `c' */
+static IPQ_SELECTION_BITMASK_PROTOCOL_SIZE ipq_dispatch_class_selection(u32 c)
+{
+	IPQ_SELECTION_BITMASK_PROTOCOL_SIZE sel;
+
+	/* only ipv4 packets get past ipq_init_packet_header() */
+	sel = IPQ_SELECTION_BITMASK_PROTOCOL_COMPLETE_TRAFFIC
+		| IPQ_SELECTION_BITMASK_PROTOCOL_IP | IPQ_SELECTION_BITMASK_PROTOCOL_IPV4_OR_IPV6;
+	if ((c & IPQ_DISPATCH_CLASS_TCP) != 0) {
+		sel |= IPQ_SELECTION_BITMASK_PROTOCOL_INT_TCP | IPQ_SELECTION_BITMASK_PROTOCOL_INT_TCP_OR_UDP;
+	}
+	if ((c & IPQ_DISPATCH_CLASS_UDP) != 0) {
+		sel |= IPQ_SELECTION_BITMASK_PROTOCOL_INT_UDP | IPQ_SELECTION_BITMASK_PROTOCOL_INT_TCP_OR_UDP;
+	}
+	if ((c & IPQ_DISPATCH_CLASS_PAYLOAD) != 0) {
+		sel |= IPQ_SELECTION_BITMASK_PROTOCOL_HAS_PAYLOAD;
+	}
+	if ((c & IPQ_DISPATCH_CLASS_NO_RETRANSMISSION) != 0) {
+		sel |= IPQ_SELECTION_BITMASK_PROTOCOL_NO_TCP_RETRANSMISSION;
+	}
+	return sel;
+}
+
+/* whether a dissector registered with selection bitmask `sel' is called for
+ * the packets of dispatch class `c': tcp and udp packets only go to the
+ * dissectors of their transport or of the complete traffic, the others to
+ * those of neither transport, and the packet has to have every selected
+ * property */
+static int ipq_dispatch_class_applies(u32 c, IPQ_SELECTION_BITMASK_PROTOCOL_SIZE sel)
+{
+	IPQ_SELECTION_BITMASK_PROTOCOL_SIZE transport;
+
+	if ((c & IPQ_DISPATCH_CLASS_TCP) != 0 && (c & IPQ_DISPATCH_CLASS_UDP) != 0) {
+		return 0;
+	}
+	if ((c & IPQ_DISPATCH_CLASS_TCP) != 0) {
+		transport = IPQ_SELECTION_BITMASK_PROTOCOL_INT_TCP | IPQ_SELECTION_BITMASK_PROTOCOL_INT_TCP_OR_UDP
+			| IPQ_SELECTION_BITMASK_PROTOCOL_COMPLETE_TRAFFIC;
+		if ((sel & transport) == 0) {
+			return 0;
+		}
+	} else if ((c & IPQ_DISPATCH_CLASS_UDP) != 0) {
+		transport = IPQ_SELECTION_BITMASK_PROTOCOL_INT_UDP | IPQ_SELECTION_BITMASK_PROTOCOL_INT_TCP_OR_UDP
+			| IPQ_SELECTION_BITMASK_PROTOCOL_COMPLETE_TRAFFIC;
+		if ((sel & transport) == 0) {
+			return 0;
+		}
+	} else {
+		transport = IPQ_SELECTION_BITMASK_PROTOCOL_INT_TCP | IPQ_SELECTION_BITMASK_PROTOCOL_INT_UDP
+			| IPQ_SELECTION_BITMASK_PROTOCOL_INT_TCP_OR_UDP;
+		if ((sel & transport) != 0 && (sel & IPQ_SELECTION_BITMASK_PROTOCOL_COMPLETE_TRAFFIC) == 0) {
+			return 0;
+		}
+	}
+	return (sel & ipq_dispatch_class_selection(c)) == sel;
+}
+
+void ipoque_set_config_detection_bitmask(struct ipoque_detection_config_struct
+										 *cfg, const IPOQUE_PROTOCOL_BITMASK * dbm)
 {
 	IPOQUE_PROTOCOL_BITMASK detection_bitmask_local;
 	IPOQUE_PROTOCOL_BITMASK *detection_bitmask = &detection_bitmask_local;
 
 	u32 a = 0;
+	u32 c;
 
 	IPOQUE_BITMASK_SET(detection_bitmask_local, *dbm);
-	IPOQUE_BITMASK_SET(ipoque_struct->detection_bitmask, *dbm);
+	IPOQUE_BITMASK_SET(cfg->detection_bitmask, *dbm);
 
 	/* set this here to zero to be interrupt safe */
-	ipoque_struct->callback_buffer_size = 0;
+	cfg->callback_buffer_size = 0;
 
 #ifdef IPOQUE_PROTOCOL_HTTP
 #ifdef IPOQUE_PROTOCOL_MPEG
@@ -168,91 +508,91 @@ void ipoque_set_protocol_detection_bitmask2(struct ipoque_detection_module_struc
 
 	  hack_do_http_detection:
 
-		ipoque_struct->callback_buffer[a].func = ipoque_search_http_tcp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_V4_V6_TCP_WITH_PAYLOAD;
+		cfg->callback_buffer[a].func = ipoque_search_http_tcp;
+		cfg->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_V4_V6_TCP_WITH_PAYLOAD;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_HTTP);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_HTTP);
 
 #ifdef IPOQUE_PROTOCOL_MPEG
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_MPEG);
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_MPEG);
 #endif
 #ifdef IPOQUE_PROTOCOL_FLASH
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_FLASH);
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_FLASH);
 #endif
 #ifdef IPOQUE_PROTOCOL_QUICKTIME
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_QUICKTIME);
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_QUICKTIME);
 #endif
 #ifdef IPOQUE_PROTOCOL_REALMEDIA
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_REALMEDIA);
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_REALMEDIA);
 #endif
 #ifdef IPOQUE_PROTOCOL_WINDOWSMEDIA
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask,
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask,
 									   IPOQUE_PROTOCOL_WINDOWSMEDIA);
 #endif
 #ifdef IPOQUE_PROTOCOL_MMS
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_MMS);
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_MMS);
 #endif
 #ifdef IPOQUE_PROTOCOL_OFF
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_OFF);
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_OFF);
 #endif
 #ifdef IPOQUE_PROTOCOL_XBOX
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_XBOX);
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_XBOX);
 #endif
 #ifdef IPOQUE_PROTOCOL_QQ
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_QQ);
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_QQ);
 #endif
 #ifdef IPOQUE_PROTOCOL_AVI
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_AVI);
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_AVI);
 #endif
 #ifdef IPOQUE_PROTOCOL_OGG
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_OGG);
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_OGG);
 #endif
 #ifdef IPOQUE_PROTOCOL_MOVE
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_MOVE);
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_MOVE);
 #endif
 #ifdef IPOQUE_PROTOCOL_RTSP
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_RTSP);
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_RTSP);
 #endif
 
-		IPOQUE_BITMASK_SET(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask,
-						   ipoque_struct->callback_buffer[a].detection_bitmask);
-		IPOQUE_DEL_PROTOCOL_FROM_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask,
+		IPOQUE_BITMASK_SET(cfg->callback_buffer[a].excluded_protocol_bitmask,
+						   cfg->callback_buffer[a].detection_bitmask);
+		IPOQUE_DEL_PROTOCOL_FROM_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask,
 										 IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_DEL_PROTOCOL_FROM_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask,
+		IPOQUE_DEL_PROTOCOL_FROM_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask,
 										 IPOQUE_PROTOCOL_QQ);
 
 #ifdef IPOQUE_PROTOCOL_FLASH
-		IPOQUE_DEL_PROTOCOL_FROM_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask,
+		IPOQUE_DEL_PROTOCOL_FROM_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask,
 										 IPOQUE_PROTOCOL_FLASH);
 #endif
 
-		IPOQUE_DEL_PROTOCOL_FROM_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask,
+		IPOQUE_DEL_PROTOCOL_FROM_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask,
 										 IPOQUE_PROTOCOL_MMS);
 
-		IPOQUE_DEL_PROTOCOL_FROM_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask,
+		IPOQUE_DEL_PROTOCOL_FROM_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask,
 										 IPOQUE_PROTOCOL_RTSP);
 
-		IPOQUE_DEL_PROTOCOL_FROM_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask,
+		IPOQUE_DEL_PROTOCOL_FROM_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask,
 										 IPOQUE_PROTOCOL_XBOX);
 
-		IPOQUE_BITMASK_SET(ipoque_struct->generic_http_packet_bitmask,
-						   ipoque_struct->callback_buffer[a].detection_bitmask);
+		IPOQUE_BITMASK_SET(cfg->generic_http_packet_bitmask,
+						   cfg->callback_buffer[a].detection_bitmask);
 
-		IPOQUE_DEL_PROTOCOL_FROM_BITMASK(ipoque_struct->generic_http_packet_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_DEL_PROTOCOL_FROM_BITMASK(cfg->generic_http_packet_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_SSL
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_SSL) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_ssl_tcp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_TCP_WITH_PAYLOAD;
+		cfg->callback_buffer[a].func = ipoque_search_ssl_tcp;
+		cfg->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_TCP_WITH_PAYLOAD;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_SSL);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_SSL);
 		a++;
 	}
 #endif
@@ -262,123 +602,123 @@ void ipoque_set_protocol_detection_bitmask2(struct ipoque_detection_module_struc
 		|| IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_RTP) != 0
 #endif
 		) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_stun_udp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_UDP_WITH_PAYLOAD;
+		cfg->callback_buffer[a].func = ipoque_search_stun_udp;
+		cfg->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_UDP_WITH_PAYLOAD;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_STUN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_STUN);
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_RTP
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_RTP) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_rtp_udp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_UDP_WITH_PAYLOAD;
+		cfg->callback_buffer[a].func = ipoque_search_rtp_udp;
+		cfg->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_UDP_WITH_PAYLOAD;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
 #ifdef IPOQUE_PROTOCOL_STUN
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_STUN);
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_STUN);
 #endif
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_RTP);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_RTP);
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_SIP
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_SIP) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_sip;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_sip;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_OR_UDP_WITH_PAYLOAD;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_SIP);
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_SIP);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_SIP);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_SIP);
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_BITTORRENT
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_BITTORRENT) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_bittorrent;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_TCP_OR_UDP;
+		cfg->callback_buffer[a].func = ipoque_search_bittorrent;
+		cfg->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_TCP_OR_UDP;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_BITTORRENT);
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_BITTORRENT);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_BITTORRENT);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_BITTORRENT);
 
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_EDONKEY
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_EDONKEY) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_edonkey;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_TCP_OR_UDP;
+		cfg->callback_buffer[a].func = ipoque_search_edonkey;
+		cfg->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_TCP_OR_UDP;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_EDONKEY);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_EDONKEY);
 #ifdef IPOQUE_PROTOCOL_BITTORRENT
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_BITTORRENT);
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_BITTORRENT);
 #endif
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_EDONKEY);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_EDONKEY);
 
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_FASTTRACK
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_FASTTRACK) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_fasttrack_tcp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_fasttrack_tcp;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_FASTTRACK);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_FASTTRACK);
 		a++;
 
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_GNUTELLA
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_GNUTELLA) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_gnutella;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_gnutella;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_OR_UDP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
 #ifdef IPOQUE_PROTOCOL_XBOX
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_XBOX);
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_XBOX);
 #endif
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_GNUTELLA);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_GNUTELLA);
 
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_WINMX
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_WINMX) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_winmx_tcp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_winmx_tcp;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_WINMX);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_WINMX);
 
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_DIRECTCONNECT
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_DIRECTCONNECT) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_directconnect;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_directconnect;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_OR_UDP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask,
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask,
 									   IPOQUE_PROTOCOL_DIRECTCONNECT);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask,
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask,
 							   IPOQUE_PROTOCOL_DIRECTCONNECT);
 
 		a++;
@@ -386,32 +726,32 @@ void ipoque_set_protocol_detection_bitmask2(struct ipoque_detection_module_struc
 #endif
 #ifdef IPOQUE_PROTOCOL_MSN
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_MSN) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_msn;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_msn;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_OR_UDP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_MSN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_MSN);
 #ifdef IPOQUE_PROTOCOL_HTTP
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_HTTP);
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_HTTP);
 #endif
 #ifdef IPOQUE_PROTOCOL_SSL
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_SSL);
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_SSL);
 #endif
-		IPOQUE_BITMASK_RESET(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask);
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask,IPOQUE_PROTOCOL_MSN);
+		IPOQUE_BITMASK_RESET(cfg->callback_buffer[a].excluded_protocol_bitmask);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask,IPOQUE_PROTOCOL_MSN);
 
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_YAHOO
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_YAHOO) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_yahoo;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_TCP_OR_UDP;
+		cfg->callback_buffer[a].func = ipoque_search_yahoo;
+		cfg->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_TCP_OR_UDP;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_YAHOO);
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_YAHOO);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_YAHOO);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_YAHOO);
 
 		a++;
 	}
@@ -419,38 +759,38 @@ void ipoque_set_protocol_detection_bitmask2(struct ipoque_detection_module_struc
 
 #ifdef IPOQUE_PROTOCOL_OSCAR
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_OSCAR) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_oscar;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_oscar;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_OR_UDP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_OSCAR);
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_OSCAR);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_OSCAR);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_OSCAR);
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_APPLEJUICE
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_APPLEJUICE) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_applejuice_tcp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_applejuice_tcp;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_APPLEJUICE);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_APPLEJUICE);
 
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_SOULSEEK
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_SOULSEEK) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_soulseek_tcp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_TCP_WITH_PAYLOAD;
+		cfg->callback_buffer[a].func = ipoque_search_soulseek_tcp;
+		cfg->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_TCP_WITH_PAYLOAD;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_SOULSEEK);
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_SOULSEEK);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_SOULSEEK);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_SOULSEEK);
 
 
 		a++;
@@ -458,31 +798,31 @@ void ipoque_set_protocol_detection_bitmask2(struct ipoque_detection_module_struc
 #endif
 #ifdef IPOQUE_PROTOCOL_IRC
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_IRC) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_irc_tcp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_irc_tcp;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_IRC);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_IRC);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_IRC);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_IRC);
 
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_UNENCRYPED_JABBER
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_UNENCRYPED_JABBER) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_jabber_tcp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_jabber_tcp;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_OR_UDP_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask,
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask,
 									   IPOQUE_PROTOCOL_UNENCRYPED_JABBER);
 #ifdef IPOQUE_PROTOCOL_SSL
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_SSL);
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_SSL);
 #endif
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask,
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask,
 							   IPOQUE_PROTOCOL_UNENCRYPED_JABBER);
 
 		a++;
@@ -490,145 +830,145 @@ void ipoque_set_protocol_detection_bitmask2(struct ipoque_detection_module_struc
 #endif
 #ifdef IPOQUE_PROTOCOL_MAIL_POP
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_MAIL_POP) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_mail_pop_tcp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_mail_pop_tcp;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_MAIL_POP);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_MAIL_POP);
 
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_MAIL_IMAP
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_MAIL_IMAP) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_mail_imap_tcp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_mail_imap_tcp;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_MAIL_IMAP);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_MAIL_IMAP);
 
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_MAIL_SMTP
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_MAIL_SMTP) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_mail_smtp_tcp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_mail_smtp_tcp;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_MAIL_SMTP);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_MAIL_SMTP);
 
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_FTP
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_FTP) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_ftp_tcp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_ftp_tcp;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_FTP);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_FTP);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_FTP);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_FTP);
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_USENET
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_USENET) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_usenet_tcp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_usenet_tcp;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_USENET);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_USENET);
 
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_DNS
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_DNS) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_dns;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_dns;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_OR_UDP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_DNS);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_DNS);
 
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_FILETOPIA
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_FILETOPIA) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_filetopia_tcp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_filetopia_tcp;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_FILETOPIA);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_FILETOPIA);
 
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_MANOLITO
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_MANOLITO) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_manolito_tcp_udp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_manolito_tcp_udp;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_OR_UDP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_MANOLITO);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_MANOLITO);
 
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_IMESH
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_IMESH) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_imesh_tcp_udp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_imesh_tcp_udp;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_OR_UDP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_IMESH);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_IMESH);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_IMESH);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_IMESH);
 
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_MMS
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_MMS) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_mms_tcp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_mms_tcp;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_MMS);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_MMS);
 
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_PANDO
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_PANDO) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_pando_tcp_udp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_pando_tcp_udp;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_OR_UDP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_PANDO);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_PANDO);
 
 		a++;
 	}
@@ -636,41 +976,41 @@ void ipoque_set_protocol_detection_bitmask2(struct ipoque_detection_module_struc
 #if defined(IPOQUE_PROTOCOL_IPSEC) || defined(IPOQUE_PROTOCOL_GRE) || defined(IPOQUE_PROTOCOL_ICMP) || defined(IPOQUE_PROTOCOL_IGMP) || defined(IPOQUE_PROTOCOL_EGP) || defined(IPOQUE_PROTOCOL_SCTP) || defined(IPOQUE_PROTOCOL_OSPF) || defined(IPOQUE_PROTOCOL_IP_IN_IP)
 	/* always add non tcp/udp if one protocol is compiled in */
 	if (1) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_in_non_tcp_udp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_IP;
+		cfg->callback_buffer[a].func = ipoque_search_in_non_tcp_udp;
+		cfg->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_IP;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
-		IPOQUE_BITMASK_RESET(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_BITMASK_RESET(cfg->callback_buffer[a].excluded_protocol_bitmask);
 #ifdef IPOQUE_PROTOCOL_IPSEC
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask,
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask,
 									   IPOQUE_PROTOCOL_IPSEC);
 #endif
 #ifdef IPOQUE_PROTOCOL_GRE
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask,
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask,
 									   IPOQUE_PROTOCOL_GRE);
 #endif
 #ifdef IPOQUE_PROTOCOL_IGMP
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask,
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask,
 									   IPOQUE_PROTOCOL_ICMP);
 #endif
 #ifdef IPOQUE_PROTOCOL_IGMP
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask,
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask,
 									   IPOQUE_PROTOCOL_IGMP);
 #endif
 #ifdef IPOQUE_PROTOCOL_EGP
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask,
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask,
 									   IPOQUE_PROTOCOL_EGP);
 #endif
 #ifdef IPOQUE_PROTOCOL_SCTP
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask,
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask,
 									   IPOQUE_PROTOCOL_SCTP);
 #endif
 #ifdef IPOQUE_PROTOCOL_OSPF
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask,
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask,
 									   IPOQUE_PROTOCOL_OSPF);
 #endif
 #ifdef IPOQUE_PROTOCOL_IP_IN_IP
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask,
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask,
 									   IPOQUE_PROTOCOL_IP_IN_IP);
 #endif
 		a++;
@@ -678,422 +1018,422 @@ void ipoque_set_protocol_detection_bitmask2(struct ipoque_detection_module_struc
 #endif
 #ifdef IPOQUE_PROTOCOL_TVANTS
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_TVANTS) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_tvants_udp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_tvants_udp;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_OR_UDP_WITH_PAYLOAD;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_TVANTS);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_TVANTS);
 
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_SOPCAST
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_SOPCAST) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_sopcast;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_sopcast;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_OR_UDP_WITH_PAYLOAD;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_SOPCAST);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_SOPCAST);
 
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_TVUPLAYER
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_TVUPLAYER) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_tvuplayer;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_tvuplayer;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_OR_UDP_WITH_PAYLOAD;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_TVUPLAYER);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_TVUPLAYER);
 
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_PPSTREAM
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_PPSTREAM) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_ppstream_tcp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_ppstream_tcp;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_OR_UDP_WITH_PAYLOAD;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_PPSTREAM);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_PPSTREAM);
 
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_PPLIVE
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_PPLIVE) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_pplive_tcp_udp;
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_PPLIVE);
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_pplive_tcp_udp;
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_PPLIVE);
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_OR_UDP_WITH_PAYLOAD;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_PPLIVE);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_PPLIVE);
 
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_IAX
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_IAX) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_iax;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_UDP_WITH_PAYLOAD;
+		cfg->callback_buffer[a].func = ipoque_search_iax;
+		cfg->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_UDP_WITH_PAYLOAD;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_IAX);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_IAX);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_IAX);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_IAX);
 
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_MGCP
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_MGCP) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_mgcp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_UDP_WITH_PAYLOAD;
+		cfg->callback_buffer[a].func = ipoque_search_mgcp;
+		cfg->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_UDP_WITH_PAYLOAD;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
-		//IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_MGCP);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		//IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_MGCP);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_MGCP);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_MGCP);
 
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_GADUGADU
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_GADUGADU) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_gadugadu;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_gadugadu;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_OR_UDP_WITH_PAYLOAD;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 #ifdef IPOQUE_PROTOCOL_HTTP
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_HTTP);
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_HTTP);
 #endif
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_GADUGADU);
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_GADUGADU);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_GADUGADU);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_GADUGADU);
 
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_ZATTOO
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_ZATTOO) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_zattoo_tcp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_zattoo_tcp;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_OR_UDP_WITH_PAYLOAD;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_ZATTOO);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_ZATTOO);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_ZATTOO);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_ZATTOO);
 
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_QQ
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_QQ) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_qq;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_qq;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_OR_UDP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_QQ);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_QQ);
 
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_FEIDIAN
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_FEIDIAN) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_feidian;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_feidian;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_OR_UDP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_FEIDIAN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_FEIDIAN);
 
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_SSH
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_SSH) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_ssh_tcp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_ssh_tcp;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_SSH);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_SSH);
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_POPO
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_POPO) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_popo_tcp_udp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_popo_tcp_udp;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_OR_UDP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_POPO);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_POPO);
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_THUNDER
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_THUNDER) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_thunder;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_thunder;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_OR_UDP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_THUNDER);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_THUNDER);
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_VNC
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_VNC) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_vnc_tcp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_vnc_tcp;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_VNC);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_VNC);
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_DHCP
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_DHCP) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_dhcp_udp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_UDP_WITH_PAYLOAD;
+		cfg->callback_buffer[a].func = ipoque_search_dhcp_udp;
+		cfg->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_UDP_WITH_PAYLOAD;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_DHCP);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_DHCP);
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_I23V5
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_I23V5) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_i23v5;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_i23v5;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_I23V5);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_I23V5);
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_SOCRATES
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_SOCRATES) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_socrates;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_socrates;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_OR_UDP_WITH_PAYLOAD;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_SOCRATES);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_SOCRATES);
 		a++;
 	}
 #endif
 
 #ifdef IPOQUE_PROTOCOL_STEAM
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_STEAM) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_steam;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_steam;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_STEAM);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_STEAM);
 		a++;
 	}
 #endif
 
 #ifdef IPOQUE_PROTOCOL_HALFLIFE2
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_HALFLIFE2) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_halflife2;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_UDP_WITH_PAYLOAD;
+		cfg->callback_buffer[a].func = ipoque_search_halflife2;
+		cfg->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_UDP_WITH_PAYLOAD;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_HALFLIFE2);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_HALFLIFE2);
 		a++;
 	}
 #endif
 
 #ifdef IPOQUE_PROTOCOL_XBOX
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_XBOX) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_xbox;
+		cfg->callback_buffer[a].func = ipoque_search_xbox;
 
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_OR_UDP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_XBOX);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_XBOX);
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_SMB
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_SMB) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_smb_tcp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_smb_tcp;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_SMB);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_SMB);
 		a++;
 	}
 #endif
 
 #ifdef IPOQUE_PROTOCOL_TELNET
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_TELNET) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_telnet_tcp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_telnet_tcp;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_TELNET);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_TELNET);
 		a++;
 	}
 #endif
 
 #ifdef IPOQUE_PROTOCOL_NTP
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_NTP) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_ntp_udp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_UDP_WITH_PAYLOAD;
+		cfg->callback_buffer[a].func = ipoque_search_ntp_udp;
+		cfg->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_UDP_WITH_PAYLOAD;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_NTP);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_NTP);
 		a++;
 	}
 #endif
 
 #ifdef IPOQUE_PROTOCOL_NFS
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_NFS) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_nfs;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_nfs;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_OR_UDP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_NFS);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_NFS);
 		a++;
 	}
 #endif
 
 #ifdef IPOQUE_PROTOCOL_SSDP
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_SSDP) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_ssdp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_UDP_WITH_PAYLOAD;
+		cfg->callback_buffer[a].func = ipoque_search_ssdp;
+		cfg->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_UDP_WITH_PAYLOAD;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_SSDP);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_SSDP);
 		a++;
 	}
 #endif
 
 #ifdef IPOQUE_PROTOCOL_WORLDOFWARCRAFT
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_WORLDOFWARCRAFT) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_worldofwarcraft;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_worldofwarcraft;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask,
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask,
 							   IPOQUE_PROTOCOL_WORLDOFWARCRAFT);
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_FLASH
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_FLASH) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_flash;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_flash;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_FLASH);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_FLASH);
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_POSTGRES
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_POSTGRES) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_postgres_tcp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_postgres_tcp;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_POSTGRES);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_POSTGRES);
 		a++;
 	}
 #endif
 
 #ifdef IPOQUE_PROTOCOL_MYSQL
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_MYSQL) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_mysql_tcp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_mysql_tcp;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_MYSQL);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_MYSQL);
 		a++;
 	}
 #endif
 
 #ifdef IPOQUE_PROTOCOL_BGP
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_BGP) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_bgp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_bgp;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_BGP);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_BGP);
 		a++;
 	}
 #endif
 
 #ifdef IPOQUE_PROTOCOL_QUAKE
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_QUAKE) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_quake;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_UDP_WITH_PAYLOAD;
+		cfg->callback_buffer[a].func = ipoque_search_quake;
+		cfg->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_UDP_WITH_PAYLOAD;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_QUAKE);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_QUAKE);
 		a++;
 	}
 #endif
 
 #ifdef IPOQUE_PROTOCOL_BATTLEFIELD
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_BATTLEFIELD) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_battlefield;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_UDP_WITH_PAYLOAD;
+		cfg->callback_buffer[a].func = ipoque_search_battlefield;
+		cfg->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_UDP_WITH_PAYLOAD;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask,
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask,
 							   IPOQUE_PROTOCOL_BATTLEFIELD);
 		a++;
 	}
@@ -1101,122 +1441,122 @@ void ipoque_set_protocol_detection_bitmask2(struct ipoque_detection_module_struc
 
 #ifdef IPOQUE_PROTOCOL_SECONDLIFE
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_SECONDLIFE) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_secondlife;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_UDP_WITH_PAYLOAD;
+		cfg->callback_buffer[a].func = ipoque_search_secondlife;
+		cfg->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_UDP_WITH_PAYLOAD;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_SECONDLIFE);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_SECONDLIFE);
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_PCANYWHERE
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_PCANYWHERE) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_pcanywhere;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_pcanywhere;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_OR_UDP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_PCANYWHERE);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_PCANYWHERE);
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_RDP
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_RDP) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_rdp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_rdp;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_RDP);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_RDP);
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_SNMP
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_SNMP) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_snmp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_UDP_WITH_PAYLOAD;
+		cfg->callback_buffer[a].func = ipoque_search_snmp;
+		cfg->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_UDP_WITH_PAYLOAD;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_SNMP);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_SNMP);
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_KONTIKI
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_KONTIKI) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_kontiki;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_UDP_WITH_PAYLOAD;
+		cfg->callback_buffer[a].func = ipoque_search_kontiki;
+		cfg->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_UDP_WITH_PAYLOAD;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_KONTIKI);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_KONTIKI);
 		a++;
 	}
 #endif
 
 #ifdef IPOQUE_PROTOCOL_ICECAST
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_ICECAST) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_icecast_tcp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_icecast_tcp;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_ICECAST);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_ICECAST);
 		a++;
 	}
 #endif
 
 #ifdef IPOQUE_PROTOCOL_SHOUTCAST
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_SHOUTCAST) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_shoutcast_tcp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_shoutcast_tcp;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 #ifdef	IPOQUE_PROTOCOL_HTTP
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_HTTP);
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_HTTP);
 #endif
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_SHOUTCAST);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_SHOUTCAST);
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_VEOHTV
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_VEOHTV) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_veohtv_tcp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_veohtv_tcp;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_VEOHTV);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_VEOHTV);
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_OPENFT
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_OPENFT) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_openft_tcp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_openft_tcp;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_OPENFT);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_OPENFT);
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_SYSLOG
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_SYSLOG) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_syslog;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_syslog;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_OR_UDP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_SYSLOG);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_SYSLOG);
 
 		a++;
 	}
@@ -1224,28 +1564,28 @@ void ipoque_set_protocol_detection_bitmask2(struct ipoque_detection_module_struc
 
 #ifdef IPOQUE_PROTOCOL_TDS
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_TDS) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_tds_tcp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_tds_tcp;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_TDS);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_TDS);
 
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_DIRECT_DOWNLOAD_LINK
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_DIRECT_DOWNLOAD_LINK) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_direct_download_link_tcp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_TCP_WITH_PAYLOAD;
+		cfg->callback_buffer[a].func = ipoque_search_direct_download_link_tcp;
+		cfg->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_TCP_WITH_PAYLOAD;
 
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask,
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask,
 									   IPOQUE_PROTOCOL_DIRECT_DOWNLOAD_LINK);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask,
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask,
 							   IPOQUE_PROTOCOL_DIRECT_DOWNLOAD_LINK);
 
 		a++;
@@ -1254,13 +1594,13 @@ void ipoque_set_protocol_detection_bitmask2(struct ipoque_detection_module_struc
 
 #ifdef IPOQUE_PROTOCOL_NETBIOS
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_NETBIOS) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_netbios;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_netbios;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_OR_UDP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_NETBIOS);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_NETBIOS);
 
 		a++;
 	}
@@ -1268,13 +1608,13 @@ void ipoque_set_protocol_detection_bitmask2(struct ipoque_detection_module_struc
 
 #ifdef IPOQUE_PROTOCOL_MDNS
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_MDNS) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_mdns;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_UDP_WITH_PAYLOAD;
+		cfg->callback_buffer[a].func = ipoque_search_mdns;
+		cfg->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_UDP_WITH_PAYLOAD;
 
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_MDNS);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_MDNS);
 
 		a++;
 	}
@@ -1282,141 +1622,115 @@ void ipoque_set_protocol_detection_bitmask2(struct ipoque_detection_module_struc
 
 #ifdef IPOQUE_PROTOCOL_IPP
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_IPP) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_ipp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_ipp;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_OR_UDP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_IPP);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_IPP);
 
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_XDMCP
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_XDMCP) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_xdmcp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_xdmcp;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_TCP_OR_UDP_WITH_PAYLOAD;
 
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
-		IPOQUE_ADD_PROTOCOL_TO_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_XDMCP);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_XDMCP);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_XDMCP);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_XDMCP);
 
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_TFTP
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_TFTP) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_tftp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_V4_V6_UDP_WITH_PAYLOAD;
+		cfg->callback_buffer[a].func = ipoque_search_tftp;
+		cfg->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_V4_V6_UDP_WITH_PAYLOAD;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_TFTP);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_TFTP);
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_STEALTHNET
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_STEALTHNET) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_stealthnet;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_stealthnet;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_V4_V6_TCP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_STEALTHNET);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_STEALTHNET);
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_AFP
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_AFP) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_afp;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask =
+		cfg->callback_buffer[a].func = ipoque_search_afp;
+		cfg->callback_buffer[a].ipq_selection_bitmask =
 			IPQ_SELECTION_BITMASK_PROTOCOL_V4_V6_TCP_WITH_PAYLOAD_WITHOUT_RETRANSMISSION;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_AFP);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_AFP);
 		a++;
 	}
 #endif
 #ifdef IPOQUE_PROTOCOL_AIMINI
 	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(*detection_bitmask, IPOQUE_PROTOCOL_AIMINI) != 0) {
-		ipoque_struct->callback_buffer[a].func = ipoque_search_aimini;
-		ipoque_struct->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_V4_V6_UDP_WITH_PAYLOAD;
+		cfg->callback_buffer[a].func = ipoque_search_aimini;
+		cfg->callback_buffer[a].ipq_selection_bitmask = IPQ_SELECTION_BITMASK_PROTOCOL_V4_V6_UDP_WITH_PAYLOAD;
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].detection_bitmask, IPOQUE_PROTOCOL_UNKNOWN);
 
-		IPOQUE_SAVE_AS_BITMASK(ipoque_struct->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_AIMINI);
+		IPOQUE_SAVE_AS_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, IPOQUE_PROTOCOL_AIMINI);
 		a++;
 	}
 #endif
-	ipoque_struct->callback_buffer_size = a;
+	cfg->callback_buffer_size = a;
 
-	IPQ_LOG(IPOQUE_PROTOCOL_UNKNOWN, ipoque_struct, IPQ_LOG_DEBUG,
-			"callback_buffer_size is %u\n", ipoque_struct->callback_buffer_size);
+	IPQ_CFG_LOG(IPOQUE_PROTOCOL_UNKNOWN, cfg, IPQ_LOG_DEBUG,
+			"callback_buffer_size is %u\n", cfg->callback_buffer_size);
 
-	/* now build the specific buffer for tcp, udp and non_tcp_udp */
-	ipoque_struct->callback_buffer_size_tcp_payload = 0;
-	ipoque_struct->callback_buffer_size_tcp_no_payload = 0;
-	for (a = 0; a < ipoque_struct->callback_buffer_size; a++) {
-		if ((ipoque_struct->callback_buffer[a].ipq_selection_bitmask & (IPQ_SELECTION_BITMASK_PROTOCOL_INT_TCP |
-																		IPQ_SELECTION_BITMASK_PROTOCOL_INT_TCP_OR_UDP |
-																		IPQ_SELECTION_BITMASK_PROTOCOL_COMPLETE_TRAFFIC))
-			!= 0) {
-			IPQ_LOG(IPOQUE_PROTOCOL_UNKNOWN, ipoque_struct, IPQ_LOG_DEBUG,
-					"callback_buffer_tcp_payload, adding buffer %u as entry %u\n", a,
-					ipoque_struct->callback_buffer_size_tcp_payload);
-
-			memcpy(&ipoque_struct->callback_buffer_tcp_payload[ipoque_struct->callback_buffer_size_tcp_payload],
-				   &ipoque_struct->callback_buffer[a], sizeof(struct ipq_call_function_struct));
-			ipoque_struct->callback_buffer_size_tcp_payload++;
-
-			if ((ipoque_struct->
-				 callback_buffer[a].ipq_selection_bitmask & IPQ_SELECTION_BITMASK_PROTOCOL_HAS_PAYLOAD) == 0) {
-				IPQ_LOG(IPOQUE_PROTOCOL_UNKNOWN, ipoque_struct, IPQ_LOG_DEBUG,
-						"callback_buffer_tcp_no_payload, additional adding buffer %u to no_payload process\n", a);
-
-				memcpy(&ipoque_struct->callback_buffer_tcp_no_payload
-					   [ipoque_struct->callback_buffer_size_tcp_no_payload], &ipoque_struct->callback_buffer[a],
-					   sizeof(struct ipq_call_function_struct));
-				ipoque_struct->callback_buffer_size_tcp_no_payload++;
+	/* now build the dispatch set of every packet class */
+	for (c = 0; c < IPQ_DISPATCH_CLASSES; c++) {
+		memset(cfg->dispatch[c], 0, sizeof(cfg->dispatch[c]));
+		for (a = 0; a < cfg->callback_buffer_size; a++) {
+			if (ipq_dispatch_class_applies(c, cfg->callback_buffer[a].ipq_selection_bitmask) == 0) {
+				continue;
 			}
+			IPQ_CFG_LOG(IPOQUE_PROTOCOL_UNKNOWN, cfg, IPQ_LOG_DEBUG,
+						"dispatch class %u, adding buffer %u\n", c, a);
+			cfg->dispatch[c][a >> 6] |= ((u64) 1) << (a & 0x3F);
 		}
 	}
 
-	ipoque_struct->callback_buffer_size_udp = 0;
-	for (a = 0; a < ipoque_struct->callback_buffer_size; a++) {
-		if ((ipoque_struct->callback_buffer[a].ipq_selection_bitmask & (IPQ_SELECTION_BITMASK_PROTOCOL_INT_UDP |
-																		IPQ_SELECTION_BITMASK_PROTOCOL_INT_TCP_OR_UDP |
-																		IPQ_SELECTION_BITMASK_PROTOCOL_COMPLETE_TRAFFIC))
-			!= 0) {
-			IPQ_LOG(IPOQUE_PROTOCOL_UNKNOWN, ipoque_struct, IPQ_LOG_DEBUG,
-					"callback_buffer_size_udp, adding buffer %u\n", a);
-
-			memcpy(&ipoque_struct->callback_buffer_udp[ipoque_struct->callback_buffer_size_udp],
-				   &ipoque_struct->callback_buffer[a], sizeof(struct ipq_call_function_struct));
-			ipoque_struct->callback_buffer_size_udp++;
+	/* protocols which dissectors other than their own take are refinable */
+	IPOQUE_BITMASK_RESET(cfg->refinable_bitmask);
+	for (a = 0; a < cfg->callback_buffer_size; a++) {
+		for (c = 1; c <= IPOQUE_MAX_SUPPORTED_PROTOCOLS; c++) {
+			if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].detection_bitmask, c) != 0
+				&& IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, c) == 0) {
+				IPOQUE_ADD_PROTOCOL_TO_BITMASK(cfg->refinable_bitmask, c);
+			}
 		}
 	}
 
-	ipoque_struct->callback_buffer_size_non_tcp_udp = 0;
-	for (a = 0; a < ipoque_struct->callback_buffer_size; a++) {
-		if ((ipoque_struct->callback_buffer[a].ipq_selection_bitmask & (IPQ_SELECTION_BITMASK_PROTOCOL_INT_TCP |
-																		IPQ_SELECTION_BITMASK_PROTOCOL_INT_UDP |
-																		IPQ_SELECTION_BITMASK_PROTOCOL_INT_TCP_OR_UDP))
-			== 0
-			|| (ipoque_struct->
-				callback_buffer[a].ipq_selection_bitmask & IPQ_SELECTION_BITMASK_PROTOCOL_COMPLETE_TRAFFIC) != 0) {
-			IPQ_LOG(IPOQUE_PROTOCOL_UNKNOWN, ipoque_struct, IPQ_LOG_DEBUG,
-					"callback_buffer_size_non_tcp_udp, adding buffer %u\n", a);
-
-			memcpy(&ipoque_struct->callback_buffer_non_tcp_udp[ipoque_struct->callback_buffer_size_non_tcp_udp],
-				   &ipoque_struct->callback_buffer[a], sizeof(struct ipq_call_function_struct));
-			ipoque_struct->callback_buffer_size_non_tcp_udp++;
+	/* the dissector of a protocol is the one which is excluded with it */
+	for (c = 0; c <= IPOQUE_MAX_SUPPORTED_PROTOCOLS; c++) {
+		cfg->protocol_callback[c] = IPQ_NO_CALLBACK;
+		for (a = 0; a < cfg->callback_buffer_size; a++) {
+			if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(cfg->callback_buffer[a].excluded_protocol_bitmask, c) != 0) {
+				cfg->protocol_callback[c] = a;
+				break;
+			}
 		}
 	}
 }
@@ -1568,7 +1882,7 @@ static inline void ipoque_connection_tracking(struct ipoque_detection_module_str
 			if (((u32)
 				 (ntohl(tcph->seq) -
 				  flow->next_tcp_seq_nr[packet->packet_direction])) >
-				ipoque_struct->tcp_max_retransmission_window_size) {
+				ipoque_struct->cfg->tcp_max_retransmission_window_size) {
 
 				packet->tcp_retransmission = 1;
 
@@ -1610,6 +1924,26 @@ static inline void ipoque_connection_tracking(struct ipoque_detection_module_str
 
 }
 
+/* call dissector `a' for the packet in work, unless the flow rules it out,
+ * which is remembered, or it does not take flows of the detected protocol;
+ * returns 1 if called */
+static inline int ipq_try_callback(struct ipoque_detection_module_struct *ipoque_struct, u32 a,
+								   const IPOQUE_PROTOCOL_BITMASK * detection_bitmask)
+{
+	const struct ipq_call_function_struct *cb = &ipoque_struct->cfg->callback_buffer[a];
+
+	if (ipoque_struct->flow != NULL &&
+		IPOQUE_BITMASK_INTERSECTS(ipoque_struct->flow->excluded_protocol_bitmask, cb->excluded_protocol_bitmask) != 0) {
+		ipoque_struct->flow->excluded_callbacks[a >> 6] |= ((u64) 1) << (a & 0x3F);
+		return 0;
+	}
+	if (IPOQUE_BITMASK_COMPARE(cb->detection_bitmask, *detection_bitmask) == 0) {
+		return 0;
+	}
+	cb->func(ipoque_struct);
+	return 1;
+}
+
 unsigned int ipoque_detection_process_packet(struct ipoque_detection_module_struct
 											 *ipoque_struct, void *flow,
 											 const unsigned char *packet,
@@ -1617,8 +1951,17 @@ unsigned int ipoque_detection_process_packet(struct ipoque_detection_module_stru
 											 const IPOQUE_TIMESTAMP_COUNTER_SIZE current_tick, void *src, void *dst)
 {
 	u32 a;
-	IPQ_SELECTION_BITMASK_PROTOCOL_SIZE ipq_selection_packet;
+	u32 w;
+	u64 candidates;
+	u32 ipq_dispatch_class;
+	u32 hint;
+	u32 detected;
+	u32 refine_from;
+	u8 refining;
+	u8 final;
+	const struct ipoque_detection_config_struct *cfg;
 	IPOQUE_PROTOCOL_BITMASK detection_bitmask;
+	IPOQUE_PROTOCOL_BITMASK refine_bitmask;
 
 
 	/* need at least 20 bytes for ip header */
@@ -1648,92 +1991,104 @@ unsigned int ipoque_detection_process_packet(struct ipoque_detection_module_stru
 		return (IPOQUE_PROTOCOL_UNKNOWN);
 	}
 
-	/* build ipq_selction packet bitmask */
-	ipq_selection_packet = IPQ_SELECTION_BITMASK_PROTOCOL_COMPLETE_TRAFFIC;
-	if (ipoque_struct->packet.iph != NULL) {
-		ipq_selection_packet |= IPQ_SELECTION_BITMASK_PROTOCOL_IP | IPQ_SELECTION_BITMASK_PROTOCOL_IPV4_OR_IPV6;
-
-	}
+	/* the dispatch class stands for the selection bits of the packet */
+	ipq_dispatch_class = 0;
 	if (ipoque_struct->packet.tcp != NULL) {
-		ipq_selection_packet |=
-			(IPQ_SELECTION_BITMASK_PROTOCOL_INT_TCP | IPQ_SELECTION_BITMASK_PROTOCOL_INT_TCP_OR_UDP);
-
+		ipq_dispatch_class |= IPQ_DISPATCH_CLASS_TCP;
 	}
 	if (ipoque_struct->packet.udp != NULL) {
-		ipq_selection_packet |=
-			(IPQ_SELECTION_BITMASK_PROTOCOL_INT_UDP | IPQ_SELECTION_BITMASK_PROTOCOL_INT_TCP_OR_UDP);
+		ipq_dispatch_class |= IPQ_DISPATCH_CLASS_UDP;
 	}
 	if (ipoque_struct->packet.payload_packet_len != 0) {
-		ipq_selection_packet |= IPQ_SELECTION_BITMASK_PROTOCOL_HAS_PAYLOAD;
+		ipq_dispatch_class |= IPQ_DISPATCH_CLASS_PAYLOAD;
 	}
-
 	if (ipoque_struct->packet.tcp_retransmission == 0) {
-		ipq_selection_packet |= IPQ_SELECTION_BITMASK_PROTOCOL_NO_TCP_RETRANSMISSION;
-
+		ipq_dispatch_class |= IPQ_DISPATCH_CLASS_NO_RETRANSMISSION;
 	}
 
 
 	IPOQUE_SAVE_AS_BITMASK(detection_bitmask, ipoque_struct->packet.detected_protocol);
 
 
-	if (flow != NULL && ipoque_struct->packet.tcp != NULL) {
-		if (ipoque_struct->packet.payload_packet_len != 0) {
-			for (a = 0; a < ipoque_struct->callback_buffer_size_tcp_payload; a++) {
-				if ((ipoque_struct->callback_buffer_tcp_payload[a].ipq_selection_bitmask & ipq_selection_packet) ==
-					ipoque_struct->callback_buffer_tcp_payload[a].ipq_selection_bitmask
-					&& IPOQUE_BITMASK_COMPARE(ipoque_struct->flow->excluded_protocol_bitmask,
-											  ipoque_struct->callback_buffer_tcp_payload[a].excluded_protocol_bitmask) == 0
-					&& IPOQUE_BITMASK_COMPARE(ipoque_struct->callback_buffer_tcp_payload[a].detection_bitmask,
-											  detection_bitmask) != 0) {
-					ipoque_struct->callback_buffer_tcp_payload[a].func(ipoque_struct);
-				}
+	cfg = ipoque_struct->cfg;
+	detected = ipoque_struct->packet.detected_protocol;
+	final = 0;
+	refining = 0;
+	refine_from = 0;
+
+	/* a flow without protocol first tries the dissector hinted by its ports */
+	hint = IPQ_NO_CALLBACK;
+	if (ipoque_struct->flow != NULL && cfg->port_hint_count != 0 && detected == IPOQUE_PROTOCOL_UNKNOWN) {
+		u32 protocol = IPOQUE_PROTOCOL_UNKNOWN;
+
+		if (ipoque_struct->packet.tcp != NULL) {
+			protocol = ipq_port_hint(cfg, ipoque_struct->packet.tcp->dest);
+			if (protocol == IPOQUE_PROTOCOL_UNKNOWN) {
+				protocol = ipq_port_hint(cfg, ipoque_struct->packet.tcp->source);
 			}
-		} else {				/* no payload */
-
-			for (a = 0; a < ipoque_struct->callback_buffer_size_tcp_no_payload; a++) {
-				if ((ipoque_struct->callback_buffer_tcp_no_payload[a].ipq_selection_bitmask & ipq_selection_packet) ==
-					ipoque_struct->callback_buffer_tcp_no_payload[a].ipq_selection_bitmask
-					&& IPOQUE_BITMASK_COMPARE(ipoque_struct->flow->excluded_protocol_bitmask,
-											  ipoque_struct->callback_buffer_tcp_no_payload[a].excluded_protocol_bitmask) == 0
-					&& IPOQUE_BITMASK_COMPARE(ipoque_struct->callback_buffer_tcp_no_payload[a].detection_bitmask,
-											  detection_bitmask) != 0) {
-					ipoque_struct->callback_buffer_tcp_no_payload[a].func(ipoque_struct);
-				}
+		} else if (ipoque_struct->packet.udp != NULL) {
+			protocol = ipq_port_hint(cfg, ipoque_struct->packet.udp->dest);
+			if (protocol == IPOQUE_PROTOCOL_UNKNOWN) {
+				protocol = ipq_port_hint(cfg, ipoque_struct->packet.udp->source);
 			}
 		}
-	} else if (flow != NULL && ipoque_struct->packet.udp != NULL) {
-		for (a = 0; a < ipoque_struct->callback_buffer_size_udp; a++) {
-			if ((ipoque_struct->callback_buffer_udp[a].ipq_selection_bitmask & ipq_selection_packet) ==
-				ipoque_struct->callback_buffer_udp[a].ipq_selection_bitmask
-				&& IPOQUE_BITMASK_COMPARE(ipoque_struct->flow->excluded_protocol_bitmask,
-										  ipoque_struct->callback_buffer_udp[a].excluded_protocol_bitmask) == 0
-				&& IPOQUE_BITMASK_COMPARE(ipoque_struct->callback_buffer_udp[a].detection_bitmask,
-										  detection_bitmask) != 0) {
-				ipoque_struct->callback_buffer_udp[a].func(ipoque_struct);
-
+		hint = cfg->protocol_callback[protocol];
+		if (hint != IPQ_NO_CALLBACK
+			&& (cfg->dispatch[ipq_dispatch_class][hint >> 6]
+				& ~ipoque_struct->flow->excluded_callbacks[hint >> 6] & (((u64) 1) << (hint & 0x3F))) != 0
+			&& ipq_try_callback(ipoque_struct, hint, &detection_bitmask) != 0
+			&& ipoque_struct->packet.detected_protocol != detected) {
+			detected = ipoque_struct->packet.detected_protocol;
+			if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(cfg->refinable_bitmask, detected) == 0) {
+				final = 1;
+			} else {
+				IPOQUE_SAVE_AS_BITMASK(refine_bitmask, detected);
+				refining = 1;
+				refine_from = hint;
 			}
 		}
-	} else {
+	}
 
-		for (a = 0; a < ipoque_struct->callback_buffer_size_non_tcp_udp; a++) {
-			if ((ipoque_struct->callback_buffer_non_tcp_udp[a].ipq_selection_bitmask & ipq_selection_packet) ==
-				ipoque_struct->callback_buffer_non_tcp_udp[a].ipq_selection_bitmask
-				&& (ipoque_struct->flow == NULL ||
-					IPOQUE_BITMASK_COMPARE(ipoque_struct->flow->excluded_protocol_bitmask,
-										   ipoque_struct->callback_buffer_non_tcp_udp[a].excluded_protocol_bitmask) == 0)
-				&& IPOQUE_BITMASK_COMPARE(ipoque_struct->callback_buffer_non_tcp_udp[a].detection_bitmask,
-										  detection_bitmask) != 0) {
+	/* candidates are the callbacks whose selection bitmask matches, except
+	 * those already found excluded for the flow. A final protocol ends the
+	 * loop, a refinable one leaves it to the later dissectors which take
+	 * flows of that protocol */
+	for (w = 0; final == 0 && w < IPQ_CALLBACK_SET_WORDS; w++) {
+		candidates = cfg->dispatch[ipq_dispatch_class][w];
+		if (ipoque_struct->flow != NULL) {
+			candidates &= ~ipoque_struct->flow->excluded_callbacks[w];
+		}
+		while (candidates != 0) {
+			a = (w << 6) + __builtin_ctzll(candidates);
+			candidates &= candidates - 1;
 
-				ipoque_struct->callback_buffer_non_tcp_udp[a].func(ipoque_struct);
+			if (a == hint) {
+				continue;
 			}
-
+			if (refining != 0
+				&& (a < refine_from
+					|| IPOQUE_BITMASK_COMPARE(cfg->callback_buffer[a].detection_bitmask, refine_bitmask) == 0)) {
+				continue;
+			}
+			if (ipq_try_callback(ipoque_struct, a, &detection_bitmask) == 0
+				|| ipoque_struct->packet.detected_protocol == detected) {
+				continue;
+			}
+			detected = ipoque_struct->packet.detected_protocol;
+			if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(cfg->refinable_bitmask, detected) == 0) {
+				final = 1;
+				break;
+			}
+			IPOQUE_SAVE_AS_BITMASK(refine_bitmask, detected);
+			refining = 1;
+			refine_from = a;
 		}
 	}
 
 
 
 	a = ipoque_struct->packet.detected_protocol;
-	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(ipoque_struct->detection_bitmask, a)
+	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(ipoque_struct->cfg->detection_bitmask, a)
 		== 0)
 		a = IPOQUE_PROTOCOL_UNKNOWN;
 
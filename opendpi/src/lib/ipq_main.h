@@ -171,10 +171,17 @@
       mod->ipoque_debug_print_file=__FILE__;                      \
       mod->ipoque_debug_print_function=__FUNCTION__;              \
       mod->ipoque_debug_print_line=__LINE__;                      \
-      mod->ipoque_debug_printf(proto, mod, log_level, args);      \
+      mod->cfg->ipoque_debug_printf(proto, mod, log_level, args); \
     }                                                             \
 }
 
+/* logging while a configuration is set up, there is no module yet */
+#define IPQ_CFG_LOG(proto, cfg, log_level, args...)               \
+{                                                                 \
+    if(cfg->ipoque_debug_printf != NULL)                          \
+      cfg->ipoque_debug_printf(proto, NULL, log_level, args);     \
+}
+
 
 #else							/* IPOQUE_ENABLE_DEBUG_MESSAGES */
 
@@ -184,8 +191,27 @@
 
 #define IPQ_LOG_EDONKEY(proto, mod, log_level, args...) {}
 #define IPQ_LOG(proto, mod, log_level, args...) {}
+#define IPQ_CFG_LOG(proto, cfg, log_level, args...) {}
 
 #endif							/* IPOQUE_ENABLE_DEBUG_MESSAGES */
+/* packet classes of the dispatch, each stands for the selection bits of
+ * its packets; every packet is ipv4, tcp and udp exclude each other */
+#define IPQ_DISPATCH_CLASS_TCP			(1<<0)
+#define IPQ_DISPATCH_CLASS_UDP			(1<<1)
+#define IPQ_DISPATCH_CLASS_PAYLOAD		(1<<2)
+#define IPQ_DISPATCH_CLASS_NO_RETRANSMISSION	(1<<3)
+#define IPQ_DISPATCH_CLASSES			16
+
+/* port hints, an open addressed table on the port; a slot with port 0 is
+ * free, one with protocol IPOQUE_PROTOCOL_UNKNOWN a removed hint */
+#define IPQ_PORT_HINT_SLOTS			256
+#define IPQ_NO_CALLBACK				0xFF
+
+typedef struct ipq_port_hint_struct {
+	u16 port;
+	u8 protocol;
+} ipq_port_hint_struct_t;
+
 typedef struct ipq_call_function_struct {
 	IPOQUE_PROTOCOL_BITMASK detection_bitmask;
 	IPOQUE_PROTOCOL_BITMASK excluded_protocol_bitmask;
@@ -247,48 +273,36 @@ typedef struct ipoque_packet_struct {
 
 
 
-typedef struct ipoque_detection_module_struct {
+/* detection configuration: the callback tables of the selected protocols
+ * and the protocol parameters; it is only written while being set up and
+ * may then be shared read-only by any number of detection modules, one
+ * per thread */
+typedef struct ipoque_detection_config_struct {
 	IPOQUE_PROTOCOL_BITMASK detection_bitmask;
 	IPOQUE_PROTOCOL_BITMASK generic_http_packet_bitmask;
 
-	IPOQUE_TIMESTAMP_COUNTER_SIZE current_ts;
 	u32 ticks_per_second;
 
-#ifdef IPOQUE_ENABLE_DEBUG_MESSAGES
-	void *user_data;
-#endif
-	/* internal structures to save functions calls */
-	struct ipoque_packet_struct packet;
-	struct ipoque_flow_struct *flow;
-	struct ipoque_id_struct *src;
-	struct ipoque_id_struct *dst;
 	/* callback function buffer */
 	struct ipq_call_function_struct
 	 callback_buffer[IPOQUE_MAX_SUPPORTED_PROTOCOLS + 1];
 	u32 callback_buffer_size;
 
-	struct ipq_call_function_struct
-	 callback_buffer_tcp_no_payload[IPOQUE_MAX_SUPPORTED_PROTOCOLS + 1];
-	u32 callback_buffer_size_tcp_no_payload;
-
-	struct ipq_call_function_struct
-	 callback_buffer_tcp_payload[IPOQUE_MAX_SUPPORTED_PROTOCOLS + 1];
-	u32 callback_buffer_size_tcp_payload;
-
-
-	struct ipq_call_function_struct
-	 callback_buffer_udp[IPOQUE_MAX_SUPPORTED_PROTOCOLS + 1];
-	u32 callback_buffer_size_udp;
-
-	struct ipq_call_function_struct
-	 callback_buffer_non_tcp_udp[IPOQUE_MAX_SUPPORTED_PROTOCOLS + 1];
-	u32 callback_buffer_size_non_tcp_udp;
+	/* dispatch sets, per packet class the entries of callback_buffer whose
+	 * selection bitmask the packets satisfy */
+	u64 dispatch[IPQ_DISPATCH_CLASSES][IPQ_CALLBACK_SET_WORDS];
+	/* per protocol, the entry of callback_buffer of its dissector or
+	 * IPQ_NO_CALLBACK */
+	u8 protocol_callback[IPOQUE_MAX_SUPPORTED_PROTOCOLS + 1];
+	/* protocols later dissectors may still turn into others, detecting any
+	 * other one is final */
+	IPOQUE_PROTOCOL_BITMASK refinable_bitmask;
+	/* likely protocol of the flows on a port, its dissector is tried first */
+	struct ipq_port_hint_struct port_hint[IPQ_PORT_HINT_SLOTS];
+	u32 port_hint_count;
 #ifdef IPOQUE_ENABLE_DEBUG_MESSAGES
 	/* debug callback, only set when debug is used */
 	ipoque_debug_function_ptr ipoque_debug_printf;
-	const char *ipoque_debug_print_file;
-	const char *ipoque_debug_print_function;
-	u32 ipoque_debug_print_line;
 #endif
 	void (*direct_download_link_counter_callback) (u32 ddl_id, u16 packet_size);
 	/* misc parameters */
@@ -329,7 +343,28 @@ typedef struct ipoque_detection_module_struct {
 	u32 jabber_stun_timeout;
 	u32 jabber_file_transfer_timeout;
 	u32 manolito_subscriber_timeout;
+} ipoque_detection_config_struct_t;
+
+/* per thread workspace of the detection, state of the packet in work */
+typedef struct ipoque_detection_module_struct {
+	const struct ipoque_detection_config_struct *cfg;
+	/* configuration allocated by ipoque_init_detection_module(), if any */
+	struct ipoque_detection_config_struct *own_cfg;
+
+	IPOQUE_TIMESTAMP_COUNTER_SIZE current_ts;
+
+#ifdef IPOQUE_ENABLE_DEBUG_MESSAGES
+	void *user_data;
+#endif
+	/* internal structures to save functions calls */
+	struct ipoque_packet_struct packet;
+	struct ipoque_flow_struct *flow;
+	struct ipoque_id_struct *src;
+	struct ipoque_id_struct *dst;
 #ifdef IPOQUE_ENABLE_DEBUG_MESSAGES
+	const char *ipoque_debug_print_file;
+	const char *ipoque_debug_print_function;
+	u32 ipoque_debug_print_line;
 #define IPOQUE_IP_STRING_SIZE 40
 	char ip_string[IPOQUE_IP_STRING_SIZE];
 #endif
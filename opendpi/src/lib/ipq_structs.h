@@ -167,6 +167,10 @@ typedef struct ipoque_id_struct {
 	u32 pplive_last_packet_time_set:1;
 #endif
 } ipoque_id_struct;
+
+/* u64 words of a set of callbacks, one bit per entry of the callback buffer */
+#define IPQ_CALLBACK_SET_WORDS	((IPOQUE_MAX_SUPPORTED_PROTOCOLS + 1 + 63) / 64)
+
 typedef struct ipoque_flow_struct {
 
 
@@ -174,6 +178,9 @@ typedef struct ipoque_flow_struct {
 
 	/* protocols which have marked a connection as this connection cannot be protocol XXX, multiple u64 */
 	IPOQUE_PROTOCOL_BITMASK excluded_protocol_bitmask;
+	/* callbacks found ruled out by excluded_protocol_bitmask, they are not
+	 * tried again for this flow; exclusions are never taken back */
+	u64 excluded_callbacks[IPQ_CALLBACK_SET_WORDS];
 	u32 detected_protocol;
 
 
@@ -57,12 +57,12 @@ void ipoque_search_battlefield(struct ipoque_detection_module_struct
 
 	if (packet->detected_protocol == IPOQUE_PROTOCOL_BATTLEFIELD) {
 		if (src != NULL && ((IPOQUE_TIMESTAMP_COUNTER_SIZE)
-							(packet->tick_timestamp - src->battlefield_ts) < ipoque_struct->battlefield_timeout)) {
+							(packet->tick_timestamp - src->battlefield_ts) < ipoque_struct->cfg->battlefield_timeout)) {
 			IPQ_LOG(IPOQUE_PROTOCOL_BATTLEFIELD, ipoque_struct, IPQ_LOG_DEBUG,
 					"battlefield : save src connection packet detected\n");
 			src->battlefield_ts = packet->tick_timestamp;
 		} else if (dst != NULL && ((IPOQUE_TIMESTAMP_COUNTER_SIZE)
-								   (packet->tick_timestamp - dst->battlefield_ts) < ipoque_struct->battlefield_timeout)) {
+								   (packet->tick_timestamp - dst->battlefield_ts) < ipoque_struct->cfg->battlefield_timeout)) {
 			IPQ_LOG(IPOQUE_PROTOCOL_BATTLEFIELD, ipoque_struct, IPQ_LOG_DEBUG,
 					"battlefield : save dst connection packet detected\n");
 			dst->battlefield_ts = packet->tick_timestamp;
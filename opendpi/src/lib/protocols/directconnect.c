@@ -175,7 +175,7 @@ static void ipoque_search_directconnect_tcp(struct ipoque_detection_module_struc
 		if (src->detected_directconnect_port == packet->tcp->source) {
 			if ((IPOQUE_TIMESTAMP_COUNTER_SIZE)
 				(packet->tick_timestamp -
-				 src->directconnect_last_safe_access_time) < ipoque_struct->directconnect_connection_ip_tick_timeout) {
+				 src->directconnect_last_safe_access_time) < ipoque_struct->cfg->directconnect_connection_ip_tick_timeout) {
 				flow->detected_protocol = IPOQUE_PROTOCOL_DIRECTCONNECT;
 				packet->detected_protocol = IPOQUE_PROTOCOL_DIRECTCONNECT;
 				src->directconnect_last_safe_access_time = packet->tick_timestamp;
@@ -192,7 +192,7 @@ static void ipoque_search_directconnect_tcp(struct ipoque_detection_module_struc
 		if (src->detected_directconnect_ssl_port == packet->tcp->dest) {
 			if ((IPOQUE_TIMESTAMP_COUNTER_SIZE)
 				(packet->tick_timestamp -
-				 src->directconnect_last_safe_access_time) < ipoque_struct->directconnect_connection_ip_tick_timeout) {
+				 src->directconnect_last_safe_access_time) < ipoque_struct->cfg->directconnect_connection_ip_tick_timeout) {
 				flow->detected_protocol = IPOQUE_PROTOCOL_DIRECTCONNECT;
 				packet->detected_protocol = IPOQUE_PROTOCOL_DIRECTCONNECT;
 				src->directconnect_last_safe_access_time = packet->tick_timestamp;
@@ -213,7 +213,7 @@ static void ipoque_search_directconnect_tcp(struct ipoque_detection_module_struc
 		if (dst->detected_directconnect_port == packet->tcp->dest) {
 			if ((IPOQUE_TIMESTAMP_COUNTER_SIZE)
 				(packet->tick_timestamp -
-				 dst->directconnect_last_safe_access_time) < ipoque_struct->directconnect_connection_ip_tick_timeout) {
+				 dst->directconnect_last_safe_access_time) < ipoque_struct->cfg->directconnect_connection_ip_tick_timeout) {
 				flow->detected_protocol = IPOQUE_PROTOCOL_DIRECTCONNECT;
 				packet->detected_protocol = IPOQUE_PROTOCOL_DIRECTCONNECT;
 				dst->directconnect_last_safe_access_time = packet->tick_timestamp;
@@ -230,7 +230,7 @@ static void ipoque_search_directconnect_tcp(struct ipoque_detection_module_struc
 		if (dst->detected_directconnect_ssl_port == packet->tcp->dest) {
 			if ((IPOQUE_TIMESTAMP_COUNTER_SIZE)
 				(packet->tick_timestamp -
-				 dst->directconnect_last_safe_access_time) < ipoque_struct->directconnect_connection_ip_tick_timeout) {
+				 dst->directconnect_last_safe_access_time) < ipoque_struct->cfg->directconnect_connection_ip_tick_timeout) {
 				flow->detected_protocol = IPOQUE_PROTOCOL_DIRECTCONNECT;
 				packet->detected_protocol = IPOQUE_PROTOCOL_DIRECTCONNECT;
 				dst->directconnect_last_safe_access_time = packet->tick_timestamp;
@@ -362,7 +362,7 @@ static void ipoque_search_directconnect_udp(struct ipoque_detection_module_struc
 	if (dst != NULL && dst->detected_directconnect_udp_port == packet->udp->dest) {
 		if ((IPOQUE_TIMESTAMP_COUNTER_SIZE)
 			(packet->tick_timestamp -
-			 dst->directconnect_last_safe_access_time) < ipoque_struct->directconnect_connection_ip_tick_timeout) {
+			 dst->directconnect_last_safe_access_time) < ipoque_struct->cfg->directconnect_connection_ip_tick_timeout) {
 			flow->detected_protocol = IPOQUE_PROTOCOL_DIRECTCONNECT;
 			packet->detected_protocol = IPOQUE_PROTOCOL_DIRECTCONNECT;
 			dst->directconnect_last_safe_access_time = packet->tick_timestamp;
@@ -460,13 +460,13 @@ void ipoque_search_directconnect(struct ipoque_detection_module_struct
 		if (src != NULL && ((IPOQUE_TIMESTAMP_COUNTER_SIZE)
 							(packet->tick_timestamp -
 							 src->directconnect_last_safe_access_time) <
-							ipoque_struct->directconnect_connection_ip_tick_timeout)) {
+							ipoque_struct->cfg->directconnect_connection_ip_tick_timeout)) {
 			src->directconnect_last_safe_access_time = packet->tick_timestamp;
 
 		} else if (dst != NULL && ((IPOQUE_TIMESTAMP_COUNTER_SIZE)
 								   (packet->tick_timestamp -
 									dst->directconnect_last_safe_access_time) <
-								   ipoque_struct->directconnect_connection_ip_tick_timeout)) {
+								   ipoque_struct->cfg->directconnect_connection_ip_tick_timeout)) {
 			dst->directconnect_last_safe_access_time = packet->tick_timestamp;
 		} else {
 			packet->detected_protocol = IPOQUE_PROTOCOL_UNKNOWN;
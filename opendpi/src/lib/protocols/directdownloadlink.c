@@ -689,14 +689,14 @@ void ipoque_search_direct_download_link_tcp(struct
 	struct ipoque_flow_struct *flow = ipoque_struct->flow;
 //      struct ipoque_id_struct         *src=ipoque_struct->src;
 //      struct ipoque_id_struct         *dst=ipoque_struct->dst;
-	if (ipoque_struct->direct_download_link_counter_callback != NULL) {
+	if (ipoque_struct->cfg->direct_download_link_counter_callback != NULL) {
 		if (packet->detected_protocol == IPOQUE_PROTOCOL_DIRECT_DOWNLOAD_LINK) {
 			/* skip packets not requests from the client to the server */
 			if (packet->packet_direction == flow->ddlink_server_direction) {
 				search_ddl_domains(ipoque_struct);	// do the detection again in order to get the URL in keep alive streams
 			} else {
 				// just count the packet
-				ipoque_struct->direct_download_link_counter_callback(flow->hash_id_number, packet->l3_packet_len);
+				ipoque_struct->cfg->direct_download_link_counter_callback(flow->hash_id_number, packet->l3_packet_len);
 			}
 		}
 		return;
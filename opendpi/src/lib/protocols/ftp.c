@@ -264,7 +264,7 @@ void ipoque_search_ftp_tcp(struct ipoque_detection_module_struct *ipoque_struct)
 		IPQ_LOG(IPOQUE_PROTOCOL_FTP, ipoque_struct, IPQ_LOG_DEBUG, "possible ftp data, src!= 0.\n");
 
 		if (((IPOQUE_TIMESTAMP_COUNTER_SIZE)
-			 (packet->tick_timestamp - src->ftp_timer)) >= ipoque_struct->ftp_connection_timeout) {
+			 (packet->tick_timestamp - src->ftp_timer)) >= ipoque_struct->cfg->ftp_connection_timeout) {
 			src->ftp_timer_set = 0;
 		} else if (ntohs(packet->tcp->dest) > 1024
 				   && (ntohs(packet->tcp->source) > 1024 || ntohs(packet->tcp->source) == 20)) {
@@ -282,7 +282,7 @@ void ipoque_search_ftp_tcp(struct ipoque_detection_module_struct *ipoque_struct)
 		IPQ_LOG(IPOQUE_PROTOCOL_FTP, ipoque_struct, IPQ_LOG_DEBUG, "possible ftp data; dst!= 0.\n");
 
 		if (((IPOQUE_TIMESTAMP_COUNTER_SIZE)
-			 (packet->tick_timestamp - dst->ftp_timer)) >= ipoque_struct->ftp_connection_timeout) {
+			 (packet->tick_timestamp - dst->ftp_timer)) >= ipoque_struct->cfg->ftp_connection_timeout) {
 			dst->ftp_timer_set = 0;
 
 		} else if (ntohs(packet->tcp->dest) > 1024
@@ -308,7 +308,7 @@ static void ipoque_search_gadugadu_tcp(struct ipoque_detection_module_struct
 			(src->detected_protocol_bitmask, IPOQUE_PROTOCOL_GADUGADU) != 0
 			&& ((src->gg_ft_ip_address == packet->iph->saddr && src->gg_ft_port == packet->tcp->source)
 				|| (src->gg_ft_ip_address == packet->iph->daddr && src->gg_ft_port == packet->tcp->dest))) {
-			if ((packet->tick_timestamp - src->gg_timeout) < ipoque_struct->gadugadu_peer_connection_timeout) {
+			if ((packet->tick_timestamp - src->gg_timeout) < ipoque_struct->cfg->gadugadu_peer_connection_timeout) {
 				ipoque_int_gadugadu_add_connection(ipoque_struct);
 				IPQ_LOG(IPOQUE_PROTOCOL_GADUGADU, ipoque_struct,
 						IPQ_LOG_DEBUG, "file transfer detected %d\n", ntohs(packet->tcp->dest));
@@ -325,7 +325,7 @@ static void ipoque_search_gadugadu_tcp(struct ipoque_detection_module_struct
 														   || (src->gg_call_id[1][0]
 															   && (memcmp(src->gg_call_id[1], &packet->payload[5], 4)
 																   == 0)))) {
-			if ((packet->tick_timestamp - src->gg_timeout) < ipoque_struct->gadugadu_peer_connection_timeout) {
+			if ((packet->tick_timestamp - src->gg_timeout) < ipoque_struct->cfg->gadugadu_peer_connection_timeout) {
 				ipoque_int_gadugadu_add_connection(ipoque_struct);
 				IPQ_LOG(IPOQUE_PROTOCOL_GADUGADU, ipoque_struct, IPQ_LOG_DEBUG, "http file transfer detetced \n");
 				return;
@@ -345,7 +345,7 @@ static void ipoque_search_gadugadu_tcp(struct ipoque_detection_module_struct
 																				 (src->gg_call_id[1],
 																				  &packet->payload[0], 4)
 																				 == 0)))) {
-			if ((packet->tick_timestamp - src->gg_timeout) < ipoque_struct->gadugadu_peer_connection_timeout) {
+			if ((packet->tick_timestamp - src->gg_timeout) < ipoque_struct->cfg->gadugadu_peer_connection_timeout) {
 				ipoque_int_gadugadu_add_connection(ipoque_struct);
 				IPQ_LOG(IPOQUE_PROTOCOL_GADUGADU, ipoque_struct,
 						IPQ_LOG_DEBUG, "file transfer detetced %d\n", htons(packet->tcp->dest));
@@ -361,7 +361,7 @@ static void ipoque_search_gadugadu_tcp(struct ipoque_detection_module_struct
 			(dst->detected_protocol_bitmask, IPOQUE_PROTOCOL_GADUGADU) != 0
 			&& ((dst->gg_ft_ip_address == packet->iph->saddr && dst->gg_ft_port == packet->tcp->source)
 				|| (dst->gg_ft_ip_address == packet->iph->daddr && dst->gg_ft_port == packet->tcp->dest))) {
-			if ((packet->tick_timestamp - dst->gg_timeout) < ipoque_struct->gadugadu_peer_connection_timeout) {
+			if ((packet->tick_timestamp - dst->gg_timeout) < ipoque_struct->cfg->gadugadu_peer_connection_timeout) {
 				ipoque_int_gadugadu_add_connection(ipoque_struct);
 				IPQ_LOG(IPOQUE_PROTOCOL_GADUGADU, ipoque_struct,
 						IPQ_LOG_DEBUG, "file transfer detected %d\n", ntohs(packet->tcp->dest));
@@ -378,7 +378,7 @@ static void ipoque_search_gadugadu_tcp(struct ipoque_detection_module_struct
 														   || (dst->gg_call_id[1][0]
 															   && (memcmp(dst->gg_call_id[1], &packet->payload[0], 4)
 																   == 0)))) {
-			if ((packet->tick_timestamp - dst->gg_timeout) < ipoque_struct->gadugadu_peer_connection_timeout) {
+			if ((packet->tick_timestamp - dst->gg_timeout) < ipoque_struct->cfg->gadugadu_peer_connection_timeout) {
 				ipoque_int_gadugadu_add_connection(ipoque_struct);
 				IPQ_LOG(IPOQUE_PROTOCOL_GADUGADU, ipoque_struct, IPQ_LOG_DEBUG, "http file transfer detetced \n");
 				return;
@@ -398,7 +398,7 @@ static void ipoque_search_gadugadu_tcp(struct ipoque_detection_module_struct
 																				 (dst->gg_call_id[1],
 																				  &packet->payload[0], 4)
 																				 == 0)))) {
-			if ((packet->tick_timestamp - dst->gg_timeout) < ipoque_struct->gadugadu_peer_connection_timeout) {
+			if ((packet->tick_timestamp - dst->gg_timeout) < ipoque_struct->cfg->gadugadu_peer_connection_timeout) {
 				ipoque_int_gadugadu_add_connection(ipoque_struct);
 				IPQ_LOG(IPOQUE_PROTOCOL_GADUGADU, ipoque_struct,
 						IPQ_LOG_DEBUG, "file transfer detected %d\n", ntohs(packet->tcp->dest));
@@ -75,21 +75,21 @@ void ipoque_search_gnutella(struct ipoque_detection_module_struct *ipoque_struct
 	u16 c;
 	if (packet->detected_protocol == IPOQUE_PROTOCOL_GNUTELLA) {
 		if (src != NULL && ((IPOQUE_TIMESTAMP_COUNTER_SIZE)
-							(packet->tick_timestamp - src->gnutella_ts) < ipoque_struct->gnutella_timeout)) {
+							(packet->tick_timestamp - src->gnutella_ts) < ipoque_struct->cfg->gnutella_timeout)) {
 			IPQ_LOG_GNUTELLA(IPOQUE_PROTOCOL_GNUTELLA, ipoque_struct,
 							 IPQ_LOG_DEBUG, "gnutella : save src connection packet detected\n");
 			src->gnutella_ts = packet->tick_timestamp;
 		} else if (dst != NULL && ((IPOQUE_TIMESTAMP_COUNTER_SIZE)
-								   (packet->tick_timestamp - dst->gnutella_ts) < ipoque_struct->gnutella_timeout)) {
+								   (packet->tick_timestamp - dst->gnutella_ts) < ipoque_struct->cfg->gnutella_timeout)) {
 			IPQ_LOG_GNUTELLA(IPOQUE_PROTOCOL_GNUTELLA, ipoque_struct,
 							 IPQ_LOG_DEBUG, "gnutella : save dst connection packet detected\n");
 			dst->gnutella_ts = packet->tick_timestamp;
 		}
-		if (src != NULL && (packet->tick_timestamp - src->gnutella_ts) > ipoque_struct->gnutella_timeout) {
+		if (src != NULL && (packet->tick_timestamp - src->gnutella_ts) > ipoque_struct->cfg->gnutella_timeout) {
 			src->detected_gnutella_udp_port1 = 0;
 			src->detected_gnutella_udp_port2 = 0;
 		}
-		if (dst != NULL && (packet->tick_timestamp - dst->gnutella_ts) > ipoque_struct->gnutella_timeout) {
+		if (dst != NULL && (packet->tick_timestamp - dst->gnutella_ts) > ipoque_struct->cfg->gnutella_timeout) {
 			dst->detected_gnutella_udp_port1 = 0;
 			dst->detected_gnutella_udp_port2 = 0;
 		}
@@ -233,7 +233,7 @@ void ipoque_search_gnutella(struct ipoque_detection_module_struct *ipoque_struct
 	} else if (packet->udp != NULL) {
 		if (src != NULL && (packet->udp->source == src->detected_gnutella_udp_port1 ||
 							packet->udp->source == src->detected_gnutella_udp_port2) &&
-			(packet->tick_timestamp - src->gnutella_ts) < ipoque_struct->gnutella_timeout) {
+			(packet->tick_timestamp - src->gnutella_ts) < ipoque_struct->cfg->gnutella_timeout) {
 			IPQ_LOG_GNUTELLA(IPOQUE_PROTOCOL_GNUTELLA, ipoque_struct, IPQ_LOG_DEBUG, "port based detection\n\n");
 			ipoque_int_gnutella_add_connection(ipoque_struct);
 		}
@@ -450,39 +450,39 @@ static void check_content_type_and_change_protocol(struct ipoque_detection_modul
 		IPQ_LOG(IPOQUE_PROTOCOL_HTTP, ipoque_struct, IPQ_LOG_DEBUG, "Content Type Line found %.*s\n",
 				ipoque_struct->packet.content_line.len, ipoque_struct->packet.content_line.ptr);
 #ifdef IPOQUE_PROTOCOL_MPEG
-		if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(ipoque_struct->detection_bitmask, IPOQUE_PROTOCOL_MPEG) != 0)
+		if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(ipoque_struct->cfg->detection_bitmask, IPOQUE_PROTOCOL_MPEG) != 0)
 			mpeg_parse_packet_contentline(ipoque_struct);
 #endif
 #ifdef IPOQUE_PROTOCOL_FLASH
-		if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(ipoque_struct->detection_bitmask, IPOQUE_PROTOCOL_FLASH) != 0)
+		if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(ipoque_struct->cfg->detection_bitmask, IPOQUE_PROTOCOL_FLASH) != 0)
 			flash_parse_packet_contentline(ipoque_struct);
 #endif
 #ifdef IPOQUE_PROTOCOL_QUICKTIME
-		if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(ipoque_struct->detection_bitmask, IPOQUE_PROTOCOL_QUICKTIME) != 0)
+		if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(ipoque_struct->cfg->detection_bitmask, IPOQUE_PROTOCOL_QUICKTIME) != 0)
 			qt_parse_packet_contentline(ipoque_struct);
 #endif
 #ifdef IPOQUE_PROTOCOL_REALMEDIA
-		if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(ipoque_struct->detection_bitmask, IPOQUE_PROTOCOL_REALMEDIA) != 0)
+		if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(ipoque_struct->cfg->detection_bitmask, IPOQUE_PROTOCOL_REALMEDIA) != 0)
 			realmedia_parse_packet_contentline(ipoque_struct);
 #endif
 #ifdef IPOQUE_PROTOCOL_WINDOWSMEDIA
-		if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(ipoque_struct->detection_bitmask, IPOQUE_PROTOCOL_WINDOWSMEDIA) != 0)
+		if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(ipoque_struct->cfg->detection_bitmask, IPOQUE_PROTOCOL_WINDOWSMEDIA) != 0)
 			windowsmedia_parse_packet_contentline(ipoque_struct);
 #endif
 #ifdef IPOQUE_PROTOCOL_MMS
-		if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(ipoque_struct->detection_bitmask, IPOQUE_PROTOCOL_MMS) != 0)
+		if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(ipoque_struct->cfg->detection_bitmask, IPOQUE_PROTOCOL_MMS) != 0)
 			mms_parse_packet_contentline(ipoque_struct);
 #endif
 #ifdef IPOQUE_PROTOCOL_OFF
-		if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(ipoque_struct->detection_bitmask, IPOQUE_PROTOCOL_OFF) != 0)
+		if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(ipoque_struct->cfg->detection_bitmask, IPOQUE_PROTOCOL_OFF) != 0)
 			off_parse_packet_contentline(ipoque_struct);
 #endif
 #ifdef IPOQUE_PROTOCOL_OGG
-		if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(ipoque_struct->detection_bitmask, IPOQUE_PROTOCOL_OGG) != 0)
+		if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(ipoque_struct->cfg->detection_bitmask, IPOQUE_PROTOCOL_OGG) != 0)
 			ogg_parse_packet_contentline(ipoque_struct);
 #endif
 #ifdef IPOQUE_PROTOCOL_MOVE
-		if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(ipoque_struct->detection_bitmask, IPOQUE_PROTOCOL_MOVE) != 0)
+		if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(ipoque_struct->cfg->detection_bitmask, IPOQUE_PROTOCOL_MOVE) != 0)
 			move_parse_packet_contentline(ipoque_struct);
 #endif
 	}
@@ -491,11 +491,11 @@ static void check_content_type_and_change_protocol(struct ipoque_detection_modul
 		IPQ_LOG(IPOQUE_PROTOCOL_HTTP, ipoque_struct, IPQ_LOG_DEBUG, "User Agent Type Line found %.*s\n",
 				ipoque_struct->packet.user_agent_line.len, ipoque_struct->packet.user_agent_line.ptr);
 #ifdef IPOQUE_PROTOCOL_XBOX
-		if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(ipoque_struct->detection_bitmask, IPOQUE_PROTOCOL_XBOX) != 0)
+		if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(ipoque_struct->cfg->detection_bitmask, IPOQUE_PROTOCOL_XBOX) != 0)
 			xbox_parse_packet_useragentline(ipoque_struct);
 #endif
 #ifdef IPOQUE_PROTOCOL_WINDOWSMEDIA
-		if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(ipoque_struct->detection_bitmask, IPOQUE_PROTOCOL_WINDOWSMEDIA) != 0)
+		if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(ipoque_struct->cfg->detection_bitmask, IPOQUE_PROTOCOL_WINDOWSMEDIA) != 0)
 			winmedia_parse_packet_useragentline(ipoque_struct);
 #endif
 
@@ -505,7 +505,7 @@ static void check_content_type_and_change_protocol(struct ipoque_detection_modul
 		IPQ_LOG(IPOQUE_PROTOCOL_HTTP, ipoque_struct, IPQ_LOG_DEBUG, "HOST Line found %.*s\n",
 				ipoque_struct->packet.host_line.len, ipoque_struct->packet.host_line.ptr);
 #ifdef IPOQUE_PROTOCOL_QQ
-		if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(ipoque_struct->detection_bitmask, IPOQUE_PROTOCOL_QQ) != 0) {
+		if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(ipoque_struct->cfg->detection_bitmask, IPOQUE_PROTOCOL_QQ) != 0) {
 			qq_parse_packet_URL_and_hostname(ipoque_struct);
 		}
 #endif
@@ -515,7 +515,7 @@ static void check_content_type_and_change_protocol(struct ipoque_detection_modul
 		IPQ_LOG(IPOQUE_PROTOCOL_HTTP, ipoque_struct, IPQ_LOG_DEBUG, "Accept Line found %.*s\n",
 				ipoque_struct->packet.accept_line.len, ipoque_struct->packet.accept_line.ptr);
 #ifdef IPOQUE_PROTOCOL_RTSP
-		if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(ipoque_struct->detection_bitmask, IPOQUE_PROTOCOL_RTSP) != 0) {
+		if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(ipoque_struct->cfg->detection_bitmask, IPOQUE_PROTOCOL_RTSP) != 0) {
 			rtsp_parse_packet_acceptline(ipoque_struct);
 		}
 #endif
@@ -540,11 +540,11 @@ static void check_http_payload(struct ipoque_detection_module_struct *ipoque_str
 	IPQ_LOG(IPOQUE_PROTOCOL_HTTP, ipoque_struct, IPQ_LOG_DEBUG, "called check_http_payload.\n");
 
 #ifdef IPOQUE_PROTOCOL_FLASH
-	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(ipoque_struct->detection_bitmask, IPOQUE_PROTOCOL_FLASH) != 0)
+	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(ipoque_struct->cfg->detection_bitmask, IPOQUE_PROTOCOL_FLASH) != 0)
 		flash_check_http_payload(ipoque_struct);
 #endif
 #ifdef IPOQUE_PROTOCOL_AVI
-	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(ipoque_struct->detection_bitmask, IPOQUE_PROTOCOL_AVI) != 0)
+	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(ipoque_struct->cfg->detection_bitmask, IPOQUE_PROTOCOL_AVI) != 0)
 		avi_check_http_payload(ipoque_struct);
 #endif
 }
@@ -632,7 +632,7 @@ void ipoque_search_http_tcp(struct ipoque_detection_module_struct *ipoque_struct
 		flow->http_setup_dir = 1 + packet->packet_direction;
 	}
 
-	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(ipoque_struct->generic_http_packet_bitmask, packet->detected_protocol) != 0) {
+	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(ipoque_struct->cfg->generic_http_packet_bitmask, packet->detected_protocol) != 0) {
 		IPQ_LOG(IPOQUE_PROTOCOL_HTTP, ipoque_struct, IPQ_LOG_DEBUG,
 				"protocol might be detected earlier as http jump to payload type detection\n");
 		goto http_parse_detection;
@@ -75,7 +75,7 @@ void ipoque_search_imesh_tcp_udp(struct ipoque_detection_module_struct
 		IPQ_LOG(IPOQUE_PROTOCOL_IMESH, ipoque_struct, IPQ_LOG_DEBUG, "UDP FOUND\n");
 
 		// this is the login packet
-		if (					//&& ((IPOQUE_TIMESTAMP_COUNTER_SIZE)(packet->tick_timestamp - src->imesh_timer)) < ipoque_struct->imesh_connection_timeout
+		if (					//&& ((IPOQUE_TIMESTAMP_COUNTER_SIZE)(packet->tick_timestamp - src->imesh_timer)) < ipoque_struct->cfg->imesh_connection_timeout
 			   packet->payload_packet_len == 28 && (get_l32(packet->payload, 0)) == 0x00000002	// PATTERN : 02 00 00 00
 			   && (get_l32(packet->payload, 24)) == 0x00000000	// PATTERN : 00 00 00 00
 			   && (packet->udp->dest == htons(1864) || packet->udp->source == htons(1864))) {
@@ -88,17 +88,17 @@ void ipoque_search_imesh_tcp_udp(struct ipoque_detection_module_struct
 			}
 			ipoque_int_imesh_add_connection(ipoque_struct);
 			return;
-		} else if (				//&& ((IPOQUE_TIMESTAMP_COUNTER_SIZE)(packet->tick_timestamp - src->imesh_timer)) < ipoque_struct->imesh_connection_timeout
+		} else if (				//&& ((IPOQUE_TIMESTAMP_COUNTER_SIZE)(packet->tick_timestamp - src->imesh_timer)) < ipoque_struct->cfg->imesh_connection_timeout
 					  packet->payload_packet_len == 36 && (get_l32(packet->payload, 0)) == 0x00000002	// PATTERN : 02 00 00 00
 					  //&& packet->payload[35]==0x0f
 			) {
 			IPQ_LOG(IPOQUE_PROTOCOL_IMESH, ipoque_struct, IPQ_LOG_DEBUG, "iMesh detected, %u\n",
-					ipoque_struct->imesh_connection_timeout);
+					ipoque_struct->cfg->imesh_connection_timeout);
 			if (src != NULL) {
 				IPQ_LOG(IPOQUE_PROTOCOL_IMESH, ipoque_struct, IPQ_LOG_DEBUG, "iMesh: src < %u, %u, %u\n",
 						(packet->tick_timestamp - src->imesh_timer), packet->tick_timestamp, src->imesh_timer);
 				if (((IPOQUE_TIMESTAMP_COUNTER_SIZE)
-					 (packet->tick_timestamp - src->imesh_timer)) < ipoque_struct->imesh_connection_timeout) {
+					 (packet->tick_timestamp - src->imesh_timer)) < ipoque_struct->cfg->imesh_connection_timeout) {
 					src->imesh_timer = packet->tick_timestamp;
 					ipoque_int_imesh_add_connection(ipoque_struct);
 				}
@@ -107,7 +107,7 @@ void ipoque_search_imesh_tcp_udp(struct ipoque_detection_module_struct
 				IPQ_LOG(IPOQUE_PROTOCOL_IMESH, ipoque_struct, IPQ_LOG_DEBUG, "iMesh: dst < %u, %u, %u\n",
 						(packet->tick_timestamp - dst->imesh_timer), packet->tick_timestamp, dst->imesh_timer);
 				if (((IPOQUE_TIMESTAMP_COUNTER_SIZE)
-					 (packet->tick_timestamp - dst->imesh_timer)) < ipoque_struct->imesh_connection_timeout) {
+					 (packet->tick_timestamp - dst->imesh_timer)) < ipoque_struct->cfg->imesh_connection_timeout) {
 					dst->imesh_timer = packet->tick_timestamp;
 					ipoque_int_imesh_add_connection(ipoque_struct);
 				}
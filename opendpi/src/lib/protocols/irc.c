@@ -336,11 +336,11 @@ void ipoque_search_irc_tcp(struct ipoque_detection_module_struct *ipoque_struct)
 	}
 	if (packet->detected_protocol == IPOQUE_PROTOCOL_IRC) {
 		if (src != NULL && ((IPOQUE_TIMESTAMP_COUNTER_SIZE)
-							(packet->tick_timestamp - src->irc_ts) < ipoque_struct->irc_timeout)) {
+							(packet->tick_timestamp - src->irc_ts) < ipoque_struct->cfg->irc_timeout)) {
 			IPQ_LOG(IPOQUE_PROTOCOL_IRC, ipoque_struct, IPQ_LOG_DEBUG, "irc : save src connection packet detected\n");
 			src->irc_ts = packet->tick_timestamp;
 		} else if (dst != NULL && ((IPOQUE_TIMESTAMP_COUNTER_SIZE)
-								   (packet->tick_timestamp - dst->irc_ts) < ipoque_struct->irc_timeout)) {
+								   (packet->tick_timestamp - dst->irc_ts) < ipoque_struct->cfg->irc_timeout)) {
 			IPQ_LOG(IPOQUE_PROTOCOL_IRC, ipoque_struct, IPQ_LOG_DEBUG, "irc : save dst connection packet detected\n");
 			dst->irc_ts = packet->tick_timestamp;
 		}
@@ -349,12 +349,12 @@ void ipoque_search_irc_tcp(struct ipoque_detection_module_struct *ipoque_struct)
 	if (((dst != NULL && IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(dst->detected_protocol_bitmask, IPOQUE_PROTOCOL_IRC)
 		  && ((IPOQUE_TIMESTAMP_COUNTER_SIZE)
 			  (packet->tick_timestamp - dst->irc_ts)) <
-		  ipoque_struct->irc_timeout)) || (src != NULL
+		  ipoque_struct->cfg->irc_timeout)) || (src != NULL
 										   &&
 										   IPOQUE_COMPARE_PROTOCOL_TO_BITMASK
 										   (src->detected_protocol_bitmask, IPOQUE_PROTOCOL_IRC)
 										   && ((IPOQUE_TIMESTAMP_COUNTER_SIZE)
-											   (packet->tick_timestamp - src->irc_ts)) < ipoque_struct->irc_timeout)) {
+											   (packet->tick_timestamp - src->irc_ts)) < ipoque_struct->cfg->irc_timeout)) {
 		if (packet->tcp != NULL) {
 			sport = packet->tcp->source;
 			dport = packet->tcp->dest;
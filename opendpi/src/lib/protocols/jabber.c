@@ -84,7 +84,7 @@ void ipoque_search_jabber_tcp(struct ipoque_detection_module_struct
 	if (packet->tcp != NULL && packet->tcp->syn != 0 && packet->payload_packet_len == 0) {
 		if (src != NULL && src->jabber_file_transfer_port != 0) {
 			if (((IPOQUE_TIMESTAMP_COUNTER_SIZE)
-				 (packet->tick_timestamp - src->jabber_stun_or_ft_ts)) >= ipoque_struct->jabber_file_transfer_timeout) {
+				 (packet->tick_timestamp - src->jabber_stun_or_ft_ts)) >= ipoque_struct->cfg->jabber_file_transfer_timeout) {
 				IPQ_LOG(IPOQUE_PROTOCOL_UNENCRYPED_JABBER, ipoque_struct,
 						IPQ_LOG_DEBUG, "JABBER src stun timeout %u %u\n", src->jabber_stun_or_ft_ts,
 						packet->tick_timestamp);
@@ -98,7 +98,7 @@ void ipoque_search_jabber_tcp(struct ipoque_detection_module_struct
 		}
 		if (dst != NULL && dst->jabber_file_transfer_port != 0) {
 			if (((IPOQUE_TIMESTAMP_COUNTER_SIZE)
-				 (packet->tick_timestamp - dst->jabber_stun_or_ft_ts)) >= ipoque_struct->jabber_file_transfer_timeout) {
+				 (packet->tick_timestamp - dst->jabber_stun_or_ft_ts)) >= ipoque_struct->cfg->jabber_file_transfer_timeout) {
 				IPQ_LOG(IPOQUE_PROTOCOL_UNENCRYPED_JABBER, ipoque_struct,
 						IPQ_LOG_DEBUG, "JABBER dst stun timeout %u %u\n", dst->jabber_stun_or_ft_ts,
 						packet->tick_timestamp);
@@ -141,25 +141,25 @@ void ipoque_search_manolito_tcp_udp(struct
 				   || packet->udp->dest == htons(41170)) {
 			if (src != NULL && src->manolito_last_pkt_arrival_time != 0
 				&& (packet->tick_timestamp - src->manolito_last_pkt_arrival_time <
-					ipoque_struct->manolito_subscriber_timeout)) {
+					ipoque_struct->cfg->manolito_subscriber_timeout)) {
 				IPQ_LOG(IPOQUE_PROTOCOL_MANOLITO, ipoque_struct, IPQ_LOG_DEBUG, "MANOLITO: UDP detected \n");
 				ipoque_int_manolito_add_connection(ipoque_struct);
 				return;
 			} else if (src != NULL
 					   && (packet->tick_timestamp - src->manolito_last_pkt_arrival_time) >=
-					   ipoque_struct->manolito_subscriber_timeout) {
+					   ipoque_struct->cfg->manolito_subscriber_timeout) {
 				src->manolito_last_pkt_arrival_time = 0;
 			}
 
 			if (dst != NULL && dst->manolito_last_pkt_arrival_time != 0
 				&& (packet->tick_timestamp - dst->manolito_last_pkt_arrival_time <
-					ipoque_struct->manolito_subscriber_timeout)) {
+					ipoque_struct->cfg->manolito_subscriber_timeout)) {
 				IPQ_LOG(IPOQUE_PROTOCOL_MANOLITO, ipoque_struct, IPQ_LOG_DEBUG, "MANOLITO: UDP detected \n");
 				ipoque_int_manolito_add_connection(ipoque_struct);
 				return;
 			} else if (dst != NULL
 					   && (packet->tick_timestamp - dst->manolito_last_pkt_arrival_time) >=
-					   ipoque_struct->manolito_subscriber_timeout) {
+					   ipoque_struct->cfg->manolito_subscriber_timeout) {
 				dst->manolito_last_pkt_arrival_time = 0;
 			}
 
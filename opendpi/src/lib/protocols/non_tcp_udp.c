@@ -44,7 +44,7 @@
 
 #define set_protocol_and_bmask(nprot)	\
 {													\
-	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(ipoque_struct->detection_bitmask,nprot) != 0)		\
+	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(ipoque_struct->cfg->detection_bitmask,nprot) != 0)		\
 	{												\
 		packet->detected_protocol=(nprot);            						\
 		if (flow != NULL)                                                                       \
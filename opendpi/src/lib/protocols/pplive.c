@@ -65,7 +65,7 @@ void ipoque_search_pplive_tcp_udp(struct ipoque_detection_module_struct
 		if (src != NULL && src->pplive_vod_cli_port == packet->udp->source
 			&& IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(src->detected_protocol_bitmask, IPOQUE_PROTOCOL_PPLIVE)) {
 			if (src->pplive_last_packet_time_set == 1 && (IPOQUE_TIMESTAMP_COUNTER_SIZE)
-				(packet->tick_timestamp - src->pplive_last_packet_time) < ipoque_struct->pplive_connection_timeout) {
+				(packet->tick_timestamp - src->pplive_last_packet_time) < ipoque_struct->cfg->pplive_connection_timeout) {
 				ipoque_int_pplive_add_connection(ipoque_struct);
 				src->pplive_last_packet_time_set = 1;
 				src->pplive_last_packet_time = packet->tick_timestamp;
@@ -81,7 +81,7 @@ void ipoque_search_pplive_tcp_udp(struct ipoque_detection_module_struct
 		if (dst != NULL && dst->pplive_vod_cli_port == packet->udp->dest
 			&& IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(dst->detected_protocol_bitmask, IPOQUE_PROTOCOL_PPLIVE)) {
 			if (dst->pplive_last_packet_time_set == 1 && (IPOQUE_TIMESTAMP_COUNTER_SIZE)
-				(packet->tick_timestamp - dst->pplive_last_packet_time) < ipoque_struct->pplive_connection_timeout) {
+				(packet->tick_timestamp - dst->pplive_last_packet_time) < ipoque_struct->cfg->pplive_connection_timeout) {
 				ipoque_int_pplive_add_connection(ipoque_struct);
 				dst->pplive_last_packet_time_set = 1;
 				dst->pplive_last_packet_time = packet->tick_timestamp;
@@ -200,7 +200,7 @@ void ipoque_search_pplive_tcp_udp(struct ipoque_detection_module_struct
 		if (src != NULL && src->pplive_vod_cli_port == packet->tcp->source
 			&& IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(src->detected_protocol_bitmask, IPOQUE_PROTOCOL_PPLIVE)) {
 			if (src->pplive_last_packet_time_set == 1 && (IPOQUE_TIMESTAMP_COUNTER_SIZE)
-				(packet->tick_timestamp - src->pplive_last_packet_time) < ipoque_struct->pplive_connection_timeout) {
+				(packet->tick_timestamp - src->pplive_last_packet_time) < ipoque_struct->cfg->pplive_connection_timeout) {
 				ipoque_int_pplive_add_connection(ipoque_struct);
 				src->pplive_last_packet_time_set = 1;
 				src->pplive_last_packet_time = packet->tick_timestamp;
@@ -216,7 +216,7 @@ void ipoque_search_pplive_tcp_udp(struct ipoque_detection_module_struct
 		if (dst != NULL && dst->pplive_vod_cli_port == packet->tcp->dest
 			&& IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(dst->detected_protocol_bitmask, IPOQUE_PROTOCOL_PPLIVE)) {
 			if (dst->pplive_last_packet_time_set == 1 && (IPOQUE_TIMESTAMP_COUNTER_SIZE)
-				(packet->tick_timestamp - dst->pplive_last_packet_time) < ipoque_struct->pplive_connection_timeout) {
+				(packet->tick_timestamp - dst->pplive_last_packet_time) < ipoque_struct->cfg->pplive_connection_timeout) {
 				flow->detected_protocol = IPOQUE_PROTOCOL_PPLIVE;
 				packet->detected_protocol = IPOQUE_PROTOCOL_PPLIVE;
 				dst->pplive_last_packet_time_set = 1;
@@ -69,7 +69,7 @@ static void ipoque_search_rdt_connection(struct ipoque_detection_module_struct
 		// UDP packets, check in case of timeout, bitmask, packet length and payload -> search the RDT Request which has the type 0xff03
 		if (src->rtsp_ts_set == 1
 			&& ((IPOQUE_TIMESTAMP_COUNTER_SIZE) (packet->tick_timestamp - src->rtsp_timer)) <
-			ipoque_struct->rtsp_connection_timeout) {
+			ipoque_struct->cfg->rtsp_connection_timeout) {
 			if (ipq_packet_dst_ip_eql(packet, &src->rtsp_ip_address)
 				&& IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(src->detected_protocol_bitmask, IPOQUE_PROTOCOL_RTSP) != 0) {
 				if (packet->payload_packet_len == 3 && packet->payload[0] == 0x00 && packet->payload[1] == 0xff
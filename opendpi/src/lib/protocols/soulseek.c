@@ -92,7 +92,7 @@ void ipoque_search_soulseek_tcp(struct ipoque_detection_module_struct
 		if (src != NULL && ((IPOQUE_TIMESTAMP_COUNTER_SIZE)
 							(packet->tick_timestamp -
 							 src->soulseek_last_safe_access_time) <
-							ipoque_struct->soulseek_connection_ip_tick_timeout)) {
+							ipoque_struct->cfg->soulseek_connection_ip_tick_timeout)) {
 			IPQ_LOG(IPOQUE_PROTOCOL_SOULSEEK, ipoque_struct, IPQ_LOG_DEBUG,
 					"Soulseek: SRC update last safe access time and SKIP_FOR_TIME \n");
 			src->soulseek_last_safe_access_time = packet->tick_timestamp;
@@ -101,7 +101,7 @@ void ipoque_search_soulseek_tcp(struct ipoque_detection_module_struct
 		if (dst != NULL && ((IPOQUE_TIMESTAMP_COUNTER_SIZE)
 							(packet->tick_timestamp -
 							 dst->soulseek_last_safe_access_time) <
-							ipoque_struct->soulseek_connection_ip_tick_timeout)) {
+							ipoque_struct->cfg->soulseek_connection_ip_tick_timeout)) {
 			IPQ_LOG(IPOQUE_PROTOCOL_SOULSEEK, ipoque_struct, IPQ_LOG_DEBUG,
 					"Soulseek: DST update last safe access time and SKIP_FOR_TIME \n");
 			dst->soulseek_last_safe_access_time = packet->tick_timestamp;
@@ -112,11 +112,11 @@ void ipoque_search_soulseek_tcp(struct ipoque_detection_module_struct
 	if (dst != NULL && dst->soulseek_listen_port != 0 && dst->soulseek_listen_port == ntohs(packet->tcp->dest)
 		&& ((IPOQUE_TIMESTAMP_COUNTER_SIZE)
 			(packet->tick_timestamp - dst->soulseek_last_safe_access_time) <
-			ipoque_struct->soulseek_connection_ip_tick_timeout)) {
+			ipoque_struct->cfg->soulseek_connection_ip_tick_timeout)) {
 		IPQ_LOG(IPOQUE_PROTOCOL_SOULSEEK, ipoque_struct, IPQ_LOG_DEBUG,
 				"Soulseek: Plain detection on Port : %u packet_tick_timestamp: %u soulseeek_last_safe_access_time: %u soulseek_connection_ip_ticktimeout: %u\n",
 				dst->soulseek_listen_port, packet->tick_timestamp,
-				dst->soulseek_last_safe_access_time, ipoque_struct->soulseek_connection_ip_tick_timeout);
+				dst->soulseek_last_safe_access_time, ipoque_struct->cfg->soulseek_connection_ip_tick_timeout);
 		ipoque_int_soulseek_add_connection(ipoque_struct);
 		return;
 	}
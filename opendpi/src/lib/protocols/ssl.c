@@ -66,11 +66,11 @@ static void ssl_mark_and_payload_search_for_other_protocols(struct
 
 	u32 end;
 #if defined(IPOQUE_PROTOCOL_UNENCRYPED_JABBER)
-	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(ipoque_struct->detection_bitmask, IPOQUE_PROTOCOL_UNENCRYPED_JABBER) != 0)
+	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(ipoque_struct->cfg->detection_bitmask, IPOQUE_PROTOCOL_UNENCRYPED_JABBER) != 0)
 		goto check_for_ssl_payload;
 #endif
 #if defined(IPOQUE_PROTOCOL_OSCAR)
-	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(ipoque_struct->detection_bitmask, IPOQUE_PROTOCOL_OSCAR) != 0)
+	if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK(ipoque_struct->cfg->detection_bitmask, IPOQUE_PROTOCOL_OSCAR) != 0)
 		goto check_for_ssl_payload;
 #endif
 
@@ -84,7 +84,7 @@ static void ssl_mark_and_payload_search_for_other_protocols(struct
 			if (memcmp(&packet->payload[a], "talk.google.com", 15) == 0) {
 				IPQ_LOG(IPOQUE_PROTOCOL_UNENCRYPED_JABBER, ipoque_struct, IPQ_LOG_DEBUG, "ssl jabber packet match\n");
 				if (IPOQUE_COMPARE_PROTOCOL_TO_BITMASK
-					(ipoque_struct->detection_bitmask, IPOQUE_PROTOCOL_UNENCRYPED_JABBER) != 0) {
+					(ipoque_struct->cfg->detection_bitmask, IPOQUE_PROTOCOL_UNENCRYPED_JABBER) != 0) {
 					ipoque_int_ssl_add_connection(ipoque_struct, IPOQUE_PROTOCOL_UNENCRYPED_JABBER);
 					return;
 				}
@@ -138,12 +138,12 @@ static inline void ipoque_int_search_thunder_http(struct ipoque_detection_module
 
 	if (packet->detected_protocol == IPOQUE_PROTOCOL_THUNDER) {
 		if (src != NULL && ((IPOQUE_TIMESTAMP_COUNTER_SIZE)
-							(packet->tick_timestamp - src->thunder_ts) < ipoque_struct->thunder_timeout)) {
+							(packet->tick_timestamp - src->thunder_ts) < ipoque_struct->cfg->thunder_timeout)) {
 			IPQ_LOG(IPOQUE_PROTOCOL_THUNDER, ipoque_struct, IPQ_LOG_DEBUG,
 					"thunder : save src connection packet detected\n");
 			src->thunder_ts = packet->tick_timestamp;
 		} else if (dst != NULL && ((IPOQUE_TIMESTAMP_COUNTER_SIZE)
-								   (packet->tick_timestamp - dst->thunder_ts) < ipoque_struct->thunder_timeout)) {
+								   (packet->tick_timestamp - dst->thunder_ts) < ipoque_struct->cfg->thunder_timeout)) {
 			IPQ_LOG(IPOQUE_PROTOCOL_THUNDER, ipoque_struct, IPQ_LOG_DEBUG,
 					"thunder : save dst connection packet detected\n");
 			dst->thunder_ts = packet->tick_timestamp;
@@ -119,7 +119,7 @@ static void ipoque_search_yahoo_tcp(struct ipoque_detection_module_struct *ipoqu
 		return;
 	}
 	/* now test for http login, at least 100 a bytes packet */
-	if (ipoque_struct->yahoo_detect_http_connections != 0 && packet->payload_packet_len > 100) {
+	if (ipoque_struct->cfg->yahoo_detect_http_connections != 0 && packet->payload_packet_len > 100) {
 		if (memcmp(packet->payload, "POST /relay?token=", 18) == 0
 			|| memcmp(packet->payload, "GET /relay?token=", 17) == 0
 			|| memcmp(packet->payload, "GET /?token=", 12) == 0
@@ -259,7 +259,7 @@ static void ipoque_search_yahoo_tcp(struct ipoque_detection_module_struct *ipoqu
 		}
 		if (src != NULL && packet->tcp->dest == htons(5100)
 			&& ((IPOQUE_TIMESTAMP_COUNTER_SIZE)
-				(packet->tick_timestamp - src->yahoo_video_lan_timer) < ipoque_struct->yahoo_lan_video_timeout)) {
+				(packet->tick_timestamp - src->yahoo_video_lan_timer) < ipoque_struct->cfg->yahoo_lan_video_timeout)) {
 			if (src->yahoo_video_lan_dir == 1) {
 				IPQ_LOG(IPOQUE_PROTOCOL_YAHOO, ipoque_struct, IPQ_LOG_DEBUG, "found YAHOO");
 				ipoque_int_yahoo_add_connection(ipoque_struct);
@@ -270,7 +270,7 @@ static void ipoque_search_yahoo_tcp(struct ipoque_detection_module_struct *ipoqu
 		}
 		if (dst != NULL && packet->tcp->dest == htons(5100)
 			&& ((IPOQUE_TIMESTAMP_COUNTER_SIZE)
-				(packet->tick_timestamp - dst->yahoo_video_lan_timer) < ipoque_struct->yahoo_lan_video_timeout)) {
+				(packet->tick_timestamp - dst->yahoo_video_lan_timer) < ipoque_struct->cfg->yahoo_lan_video_timeout)) {
 			if (dst->yahoo_video_lan_dir == 0) {
 				IPQ_LOG(IPOQUE_PROTOCOL_YAHOO, ipoque_struct, IPQ_LOG_DEBUG, "found YAHOO");
 				ipoque_int_yahoo_add_connection(ipoque_struct);
@@ -61,11 +61,11 @@ void ipoque_search_zattoo_tcp(struct ipoque_detection_module_struct
 
 	if (packet->detected_protocol == IPOQUE_PROTOCOL_ZATTOO) {
 		if (src != NULL && ((IPOQUE_TIMESTAMP_COUNTER_SIZE)
-							(packet->tick_timestamp - src->zattoo_ts) < ipoque_struct->zattoo_connection_timeout)) {
+							(packet->tick_timestamp - src->zattoo_ts) < ipoque_struct->cfg->zattoo_connection_timeout)) {
 			src->zattoo_ts = packet->tick_timestamp;
 		}
 		if (dst != NULL && ((IPOQUE_TIMESTAMP_COUNTER_SIZE)
-							(packet->tick_timestamp - dst->zattoo_ts) < ipoque_struct->zattoo_connection_timeout)) {
+							(packet->tick_timestamp - dst->zattoo_ts) < ipoque_struct->cfg->zattoo_connection_timeout)) {
 			dst->zattoo_ts = packet->tick_timestamp;
 		}
 		return;
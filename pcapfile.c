@@ -0,0 +1,410 @@
+/*
+ * pcapfile.c - implementation of the memory-mapped pcap/pcapng reader
+ */
+
+#include "pcapfile.h"
+#include "mem.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define PCAP_MAGIC 0xa1b2c3d4		/* classic, microsecond timestamps */
+#define PCAP_MAGIC_NSEC 0xa1b23c4d	/* classic, nanosecond timestamps */
+#define PCAP_HDR_LEN 24
+#define PCAP_REC_LEN 16
+
+#define PCAPNG_SHB 0x0a0d0d0a		/* section header block */
+#define PCAPNG_IDB 1			/* interface description block */
+#define PCAPNG_SPB 3			/* simple packet block */
+#define PCAPNG_EPB 6			/* enhanced packet block */
+#define PCAPNG_BYTE_ORDER_MAGIC 0x1a2b3c4d
+#define PCAPNG_OPT_TSRESOL 9
+
+typedef struct pcapng_if {
+	int linktype;
+	uint64_t units;			/* timestamp units per second */
+} PcapngIf;
+
+typedef struct pcap_file {
+	unsigned char *map;
+	size_t size;
+	size_t off;			/* next record/block */
+	int ng;				/* pcapng rather than classic pcap */
+	int swapped;			/* byte order differs from ours */
+	int nsec;			/* classic: nanosecond timestamps */
+	int linktype;
+	PcapngIf *ifs;			/* pcapng: interfaces of this section */
+	unsigned nifs, ifs_size;
+	struct bpf_program fp;
+	int filtered;
+	double speed;
+	uint64_t pace_ts, pace_wall;	/* first record and when it was seen */
+	unsigned long packets, skipped;
+} PcapFileHead;
+
+static uint32_t rd32(PcapFileHead *ph, const unsigned char *p) {
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));	/* classic records are not aligned */
+	return ph->swapped ? __builtin_bswap32(v) : v;
+}
+
+static uint16_t rd16(PcapFileHead *ph, const unsigned char *p) {
+	uint16_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return ph->swapped ? __builtin_bswap16(v) : v;
+}
+
+static uint64_t now_usec(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* sleep until the record stamped `ts' is due in paced replay */
+static void pace(PcapFileHead *ph, const struct timeval *ts) {
+	uint64_t t = (uint64_t)ts->tv_sec * 1000000 + ts->tv_usec;
+	uint64_t due, now;
+	struct timespec d;
+
+	if (!ph->pace_wall) {
+		ph->pace_ts = t;
+		ph->pace_wall = now_usec();
+		return;
+	}
+	if (t < ph->pace_ts)
+		return;
+	due = ph->pace_wall + (uint64_t)((t - ph->pace_ts) / ph->speed);
+	now = now_usec();
+	if (due > now) {
+		d.tv_sec = (due - now) / 1000000;
+		d.tv_nsec = ((due - now) % 1000000) * 1000;
+		nanosleep(&d, NULL);
+	}
+}
+
+/* start a pcapng section at `p'; returns 0 if successful */
+static int read_shb(PcapFileHead *ph, const unsigned char *p, size_t len) {
+	uint32_t magic;
+
+	if (len < 28)
+		return -1;
+	memcpy(&magic, p + 8, sizeof(magic));
+	if (magic == PCAPNG_BYTE_ORDER_MAGIC)
+		ph->swapped = 0;
+	else if (magic == __builtin_bswap32(PCAPNG_BYTE_ORDER_MAGIC))
+		ph->swapped = 1;
+	else
+		return -1;
+	ph->nifs = 0;			/* interface ids are per section */
+	return 0;
+}
+
+static int read_idb(PcapFileHead *ph, const unsigned char *p, size_t len) {
+	const unsigned char *opt = p + 16, *end = p + len - 4;
+	PcapngIf *nif;
+	uint16_t code, olen;
+	unsigned char res;
+	int i;
+
+	if (len < 20)
+		return -1;
+	if (ph->nifs == ph->ifs_size) {
+		nif = (PcapngIf *)mem_alloc((ph->ifs_size + 4) * sizeof(PcapngIf));
+		if (!nif)
+			return -1;
+		if (ph->ifs) {
+			memcpy(nif, ph->ifs, ph->nifs * sizeof(PcapngIf));
+			mem_free(ph->ifs);
+		}
+		ph->ifs = nif;
+		ph->ifs_size += 4;
+	}
+	nif = &ph->ifs[ph->nifs++];
+	nif->linktype = rd16(ph, p + 8);
+	nif->units = 1000000;
+	while (opt + 4 <= end) {
+		code = rd16(ph, opt);
+		olen = rd16(ph, opt + 2);
+		if (code == 0 || opt + 4 + olen > end)
+			break;
+		if (code == PCAPNG_OPT_TSRESOL && olen >= 1) {
+			res = opt[4];
+			nif->units = 1;
+			/* high bit set: negative power of 2, else of 10 */
+			for (i = 0; i < (res & 0x7f) && i < 63; i++)
+				nif->units *= (res & 0x80) ? 2 : 10;
+		}
+		opt += 4 + ((olen + 3) & ~3);
+	}
+	if (ph->linktype < 0)
+		ph->linktype = nif->linktype;
+	return 0;
+}
+
+/* find the next packet; returns 1 and fills in `hdr'/`data', 0 at the end
+ * of the file, -1 on a damaged record */
+static int next_classic(PcapFileHead *ph, struct pcap_pkthdr *hdr,
+			const unsigned char **data) {
+	const unsigned char *p = ph->map + ph->off;
+	uint32_t caplen, frac;
+
+	if (ph->off == ph->size)
+		return 0;
+	if (ph->size - ph->off < PCAP_REC_LEN)
+		return -1;
+	caplen = rd32(ph, p + 8);
+	if (caplen > ph->size - ph->off - PCAP_REC_LEN)
+		return -1;
+	frac = rd32(ph, p + 4);
+	hdr->ts.tv_sec = rd32(ph, p);
+	hdr->ts.tv_usec = ph->nsec ? frac / 1000 : frac;
+	hdr->caplen = caplen;
+	hdr->len = rd32(ph, p + 12);
+	*data = p + PCAP_REC_LEN;
+	ph->off += PCAP_REC_LEN + caplen;
+	return 1;
+}
+
+static int next_ng(PcapFileHead *ph, struct pcap_pkthdr *hdr,
+		   const unsigned char **data) {
+	const unsigned char *p;
+	uint32_t type, len, ifid, caplen;
+	uint64_t ts, units;
+
+	for (;;) {
+		p = ph->map + ph->off;
+		if (ph->off == ph->size)
+			return 0;
+		if (ph->size - ph->off < 12)
+			return -1;
+		type = rd32(ph, p);
+		if (type == PCAPNG_SHB) {
+			/* the length is only readable in the new byte order */
+			if (read_shb(ph, p, ph->size - ph->off))
+				return -1;
+		}
+		len = rd32(ph, p + 4);
+		if (len < 12 || (len & 3) || len > ph->size - ph->off)
+			return -1;
+		ph->off += len;
+
+		switch (type) {
+		case PCAPNG_IDB:
+			if (read_idb(ph, p, len))
+				return -1;
+			break;
+		case PCAPNG_EPB:
+			if (len < 32)
+				return -1;
+			ifid = rd32(ph, p + 8);
+			caplen = rd32(ph, p + 20);
+			if (ifid >= ph->nifs || caplen > len - 32)
+				return -1;
+			if (ph->ifs[ifid].linktype != ph->linktype) {
+				ph->skipped++;
+				break;
+			}
+			units = ph->ifs[ifid].units;
+			ts = ((uint64_t)rd32(ph, p + 12) << 32) | rd32(ph, p + 16);
+			hdr->ts.tv_sec = ts / units;
+			hdr->ts.tv_usec = (ts % units) * 1000000 / units;
+			hdr->caplen = caplen;
+			hdr->len = rd32(ph, p + 24);
+			*data = p + 28;
+			return 1;
+		case PCAPNG_SPB:
+			if (len < 16 || ph->nifs == 0)
+				return -1;
+			if (ph->ifs[0].linktype != ph->linktype) {
+				ph->skipped++;
+				break;
+			}
+			hdr->len = rd32(ph, p + 8);
+			hdr->caplen = hdr->len < len - 16 ? hdr->len : len - 16;
+			hdr->ts.tv_sec = 0;	/* simple packets carry no time */
+			hdr->ts.tv_usec = 0;
+			*data = p + 12;
+			return 1;
+		default:
+			break;		/* statistics, name resolution, ... */
+		}
+	}
+}
+
+PcapFile pcapfile_open(const char *path, char *errbuf) {
+	PcapFileHead *ph;
+	struct stat st;
+	uint32_t magic;
+	int fd;
+
+	if (!(ph = (PcapFileHead *)mem_alloc(sizeof(PcapFileHead)))) {
+		snprintf(errbuf, PCAP_ERRBUF_SIZE, "out of memory");
+		return NULL;
+	}
+	memset(ph, 0, sizeof(PcapFileHead));
+	ph->map = MAP_FAILED;
+	ph->linktype = -1;
+	if ((fd = open(path, O_RDONLY)) < 0 || fstat(fd, &st)) {
+		snprintf(errbuf, PCAP_ERRBUF_SIZE, "%s: %s", path,
+			 strerror(errno));
+		goto err;
+	}
+	ph->size = st.st_size;
+	if (ph->size < PCAP_HDR_LEN) {
+		snprintf(errbuf, PCAP_ERRBUF_SIZE, "%s: file too short", path);
+		goto err;
+	}
+	ph->map = mmap(NULL, ph->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (ph->map == MAP_FAILED) {
+		snprintf(errbuf, PCAP_ERRBUF_SIZE, "mmap %s: %s", path,
+			 strerror(errno));
+		goto err;
+	}
+	close(fd);
+	fd = -1;
+	/* records are read once, front to back */
+	madvise(ph->map, ph->size, MADV_SEQUENTIAL);
+
+	memcpy(&magic, ph->map, sizeof(magic));
+	if (magic == PCAP_MAGIC || magic == PCAP_MAGIC_NSEC) {
+		ph->swapped = 0;
+	} else if (magic == __builtin_bswap32(PCAP_MAGIC) ||
+		   magic == __builtin_bswap32(PCAP_MAGIC_NSEC)) {
+		ph->swapped = 1;
+		magic = __builtin_bswap32(magic);
+	} else if (magic == PCAPNG_SHB) {
+		ph->ng = 1;
+	} else {
+		snprintf(errbuf, PCAP_ERRBUF_SIZE, "%s: not a pcap or pcapng file",
+			 path);
+		goto err;
+	}
+	if (!ph->ng) {
+		ph->nsec = (magic == PCAP_MAGIC_NSEC);
+		ph->linktype = rd32(ph, ph->map + 20) & 0xffff;
+		ph->off = PCAP_HDR_LEN;
+	} else {
+		/* the first interface sets the link type; packets can only
+		 * follow interface descriptions, so a look ahead up to the first
+		 * packet finds it */
+		struct pcap_pkthdr hdr;
+		const unsigned char *data;
+
+		if (read_shb(ph, ph->map, ph->size)) {
+			snprintf(errbuf, PCAP_ERRBUF_SIZE,
+				 "%s: bad pcapng section header", path);
+			goto err;
+		}
+		next_ng(ph, &hdr, &data);	/* stops at the first packet */
+		ph->off = 0;
+		ph->nifs = 0;
+		ph->skipped = 0;
+		if (ph->linktype < 0) {
+			snprintf(errbuf, PCAP_ERRBUF_SIZE,
+				 "%s: no interface description", path);
+			goto err;
+		}
+	}
+	return (PcapFile)ph;
+err:
+	if (fd >= 0)
+		close(fd);
+	pcapfile_close((PcapFile)ph);
+	return NULL;
+}
+
+int pcapfile_linktype(PcapFile f) {
+	return ((PcapFileHead *)f)->linktype;
+}
+
+int pcapfile_setfilter(PcapFile f, const char *filter, char *errbuf) {
+	PcapFileHead *ph = (PcapFileHead *)f;
+	pcap_t *p;
+	int ret = 0;
+
+	if (!(p = pcap_open_dead(ph->linktype, 65535))) {
+		snprintf(errbuf, PCAP_ERRBUF_SIZE, "pcap_open_dead failed");
+		return -1;
+	}
+	if (ph->filtered) {
+		pcap_freecode(&ph->fp);
+		ph->filtered = 0;
+	}
+	if (pcap_compile(p, &ph->fp, filter, 0, 0) == -1) {
+		snprintf(errbuf, PCAP_ERRBUF_SIZE, "%s", pcap_geterr(p));
+		ret = -1;
+	} else {
+		ph->filtered = 1;
+	}
+	pcap_close(p);
+	return ret;
+}
+
+void pcapfile_setspeed(PcapFile f, double speed) {
+	PcapFileHead *ph = (PcapFileHead *)f;
+
+	ph->speed = speed > 0 ? speed : 0;
+	ph->pace_wall = 0;
+}
+
+int pcapfile_dispatch(PcapFile f, int cnt, pcap_handler cb, u_char *user) {
+	PcapFileHead *ph = (PcapFileHead *)f;
+	struct pcap_pkthdr hdr;
+	const unsigned char *data;
+	int n = 0, r;
+
+	while (cnt <= 0 || n < cnt) {
+		r = ph->ng ? next_ng(ph, &hdr, &data) :
+			     next_classic(ph, &hdr, &data);
+		if (r <= 0)
+			return n ? n : r;
+		if (ph->filtered && !pcap_offline_filter(&ph->fp, &hdr, data)) {
+			ph->skipped++;
+			continue;
+		}
+		if (ph->speed > 0)
+			pace(ph, &hdr.ts);
+		cb(user, &hdr, data);
+		ph->packets++;
+		n++;
+	}
+	return n;
+}
+
+int pcapfile_loop(PcapFile f, pcap_handler cb, u_char *user) {
+	int n;
+
+	while ((n = pcapfile_dispatch(f, 1024, cb, user)) > 0)
+		;
+	return n;
+}
+
+void pcapfile_stats(PcapFile f, unsigned long *packets,
+		    unsigned long *skipped) {
+	PcapFileHead *ph = (PcapFileHead *)f;
+
+	*packets = ph->packets;
+	*skipped = ph->skipped;
+}
+
+void pcapfile_close(PcapFile f) {
+	PcapFileHead *ph = (PcapFileHead *)f;
+
+	if (ph->map != MAP_FAILED)
+		munmap(ph->map, ph->size);
+	if (ph->filtered)
+		pcap_freecode(&ph->fp);
+	if (ph->ifs)
+		mem_free(ph->ifs);
+	mem_free(ph);
+}
@@ -0,0 +1,53 @@
+/*
+ * pcapfile.h - public data structures and entry points for the
+ *              memory-mapped pcap/pcapng file reader
+ *
+ * the whole file is mmap'd and its records are walked in place; the
+ * capture callback is handed a pointer into the mapping, no copy is made.
+ * The callback uses the libpcap handler signature so the same packet
+ * functions serve live and offline input
+ *
+ * classic pcap files are read in either byte order with micro or
+ * nanosecond timestamps; pcapng files may hold several sections, only
+ * enhanced and simple packet blocks are passed on, packets of interfaces
+ * whose link type differs from the first one are skipped
+ */
+
+#ifndef _PCAPFILE_H_INCLUDED_
+#define _PCAPFILE_H_INCLUDED_
+
+#include <pcap.h>
+
+typedef void *PcapFile;
+
+/* map `path' and check its header
+ * returns NULL if error, with a message in `errbuf' (PCAP_ERRBUF_SIZE) */
+PcapFile pcapfile_open(const char *path, char *errbuf);
+
+/* link type (DLT_*) of the packets passed on */
+int pcapfile_linktype(PcapFile f);
+
+/* compile `filter' with libpcap; records not matching it are skipped
+ * returns 0 if successful, -1 with a message in `errbuf' otherwise */
+int pcapfile_setfilter(PcapFile f, const char *filter, char *errbuf);
+
+/* replay at `speed' times the recorded rate, sleeping between records;
+ * 0 (the default) reads as fast as possible */
+void pcapfile_setspeed(PcapFile f, double speed);
+
+/* pass up to `cnt' records (cnt <= 0 means all) to `cb'
+ * returns the number of records processed, 0 at the end of the file,
+ * -1 on a damaged record */
+int pcapfile_dispatch(PcapFile f, int cnt, pcap_handler cb, u_char *user);
+
+/* run pcapfile_dispatch() until the end of the file or an error */
+int pcapfile_loop(PcapFile f, pcap_handler cb, u_char *user);
+
+/* number of records passed on and skipped (filter or link type) so far */
+void pcapfile_stats(PcapFile f, unsigned long *packets,
+		    unsigned long *skipped);
+
+/* destructor, unmaps the file */
+void pcapfile_close(PcapFile f);
+
+#endif /* _PCAPFILE_H_INCLUDED_ */
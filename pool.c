@@ -0,0 +1,129 @@
+/*
+ * pool.c - implementation of fixed-size object pools
+ */
+
+#include "pool.h"
+#include "mem.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define CACHE_LINE 64
+
+typedef struct slab {
+	struct slab *next;
+} Slab;
+
+typedef struct free_obj {
+	struct free_obj *next;
+} FreeObj;
+
+typedef struct pool_head {
+	unsigned long objsize;
+	unsigned long capacity;
+	unsigned long slabobjs;
+	unsigned long in_use;
+	unsigned long peak;
+	unsigned long nfree;
+	unsigned long nslabs;
+	unsigned long failures;
+	FreeObj *freelist;
+	Slab *slabs;
+	unsigned char *cur;	/* next never used object in the newest slab */
+	unsigned long left;	/* never used objects left in the newest slab */
+} PoolHead;
+
+Pool pool_create(unsigned long objsize, unsigned long capacity,
+		 unsigned long slabobjs) {
+	PoolHead *ph = (PoolHead *)mem_alloc(sizeof(PoolHead));
+
+	if (ph) {
+		memset(ph, 0, sizeof(PoolHead));
+		if (objsize < sizeof(FreeObj))
+			objsize = sizeof(FreeObj);
+		ph->objsize = (objsize + CACHE_LINE - 1) &
+			      ~((unsigned long)CACHE_LINE - 1);
+		ph->capacity = capacity;
+		ph->slabobjs = slabobjs ? slabobjs : 1;
+	}
+	return (Pool)ph;
+}
+
+/*
+ * allocate a new slab; the first cache line holds the slab link so that
+ * every object stays cache aligned
+ * returns 0 if failure (malloc failure), otherwise 1
+ */
+static int slab_add(PoolHead *ph) {
+	Slab *s;
+
+	if (posix_memalign((void **)&s, CACHE_LINE,
+			   CACHE_LINE + ph->slabobjs * ph->objsize))
+		return 0;
+	s->next = ph->slabs;
+	ph->slabs = s;
+	ph->nslabs++;
+	ph->cur = (unsigned char *)s + CACHE_LINE;
+	ph->left = ph->slabobjs;
+	return 1;
+}
+
+void *pool_alloc(Pool p) {
+	PoolHead *ph = (PoolHead *)p;
+	void *obj;
+
+	if (ph->capacity && ph->in_use >= ph->capacity) {
+		ph->failures++;
+		return NULL;
+	}
+	if (ph->freelist) {
+		obj = ph->freelist;
+		ph->freelist = ph->freelist->next;
+		ph->nfree--;
+	} else {
+		if (!ph->left && !slab_add(ph)) {
+			ph->failures++;
+			return NULL;
+		}
+		obj = ph->cur;
+		ph->cur += ph->objsize;
+		ph->left--;
+	}
+	if (++ph->in_use > ph->peak)
+		ph->peak = ph->in_use;
+	return obj;
+}
+
+void pool_free(Pool p, void *obj) {
+	PoolHead *ph = (PoolHead *)p;
+	FreeObj *fo = (FreeObj *)obj;
+
+	if (!fo)
+		return;
+	fo->next = ph->freelist;
+	ph->freelist = fo;
+	ph->nfree++;
+	ph->in_use--;
+}
+
+void pool_stats(Pool p, PoolStats *st) {
+	PoolHead *ph = (PoolHead *)p;
+
+	st->objsize = ph->objsize;
+	st->capacity = ph->capacity;
+	st->in_use = ph->in_use;
+	st->peak = ph->peak;
+	st->free = ph->nfree;
+	st->slabs = ph->nslabs;
+	st->failures = ph->failures;
+}
+
+void pool_destroy(Pool p) {
+	PoolHead *ph = (PoolHead *)p;
+	Slab *s, *next;
+
+	for (s = ph->slabs; s != NULL; s = next) {
+		next = s->next;
+		free(s);
+	}
+	mem_free(ph);
+}
@@ -0,0 +1,48 @@
+/*
+ * pool.h - public data structures and entry points for fixed-size object
+ *          pools
+ *
+ * objects are carved out of cache-aligned slabs that are allocated on
+ * demand and never returned to the heap; freed objects go onto a free list
+ * and are recycled first, so a pool in steady state does no malloc/free at
+ * all
+ *
+ * a pool is not thread-safe - each thread owns its own
+ */
+
+#ifndef _POOL_H_INCLUDED_
+#define _POOL_H_INCLUDED_
+
+typedef void *Pool;
+
+typedef struct pool_stats {
+	unsigned long objsize;	/* object size after alignment */
+	unsigned long capacity;	/* max number of objects, 0 if unbounded */
+	unsigned long in_use;	/* objects currently handed out */
+	unsigned long peak;	/* high water mark of in_use */
+	unsigned long free;	/* objects on the free list */
+	unsigned long slabs;	/* slabs allocated so far */
+	unsigned long failures;	/* pool_alloc() calls that returned NULL */
+} PoolStats;
+
+/* constructor - objects are `objsize' bytes, rounded up to a cache line;
+ * at most `capacity' objects (0 means no limit) are handed out at a time,
+ * slabs hold `slabobjs' objects
+ * returns NULL if error */
+Pool pool_create(unsigned long objsize, unsigned long capacity,
+		 unsigned long slabobjs);
+
+/* return an uninitialised object, or NULL if the pool is at capacity or a
+ * new slab cannot be allocated */
+void *pool_alloc(Pool p);
+
+/* give `obj', previously returned by pool_alloc() on `p', back */
+void pool_free(Pool p, void *obj);
+
+/* fill in `st' with the current counters of `p' */
+void pool_stats(Pool p, PoolStats *st);
+
+/* destructor - releases all slabs, outstanding objects become invalid */
+void pool_destroy(Pool p);
+
+#endif /* _POOL_H_INCLUDED_ */
@@ -0,0 +1,218 @@
+/*
+ * publisher.c - implementation of the background flow record publisher
+ */
+
+#include "publisher.h"
+#include "spscring.h"
+#include "mem.h"
+#include "config.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+
+#define PUB_HDR_MAX 16			/* room for "BULK:<n>\n" */
+#define PUB_ROW_MAX 128			/* longest insert statement */
+#define PUB_IDLE_MS 1			/* nap of an idle publisher */
+
+typedef struct producer {
+	SPSCRing ring;
+	unsigned long queued, dropped;	/* written by the producer only */
+	char pad[64];
+} Producer;
+
+typedef struct publisher {
+	RpcConnection rpc;
+	Producer *producers;
+	int nproducers;
+	unsigned maxquery;
+	unsigned flush_ms;
+	pthread_t thread;
+	int running;
+	int stop;
+	char *query;			/* PUB_HDR_MAX bytes, then the rows */
+	char resp[SOCK_RECV_BUF_LEN];
+	unsigned qlen;			/* bytes of rows */
+	unsigned nrows;
+	unsigned long published, failed, calls, bytes;
+} PublisherHead;
+
+static void send_batch(PublisherHead *ph) {
+	char hdr[PUB_HDR_MAX];
+	char *q;
+	unsigned hlen, rlen, len;
+
+	if (!ph->nrows)
+		return;
+	hlen = snprintf(hdr, sizeof(hdr), "BULK:%u\n", ph->nrows);
+	q = ph->query + PUB_HDR_MAX - hlen;
+	memcpy(q, hdr, hlen);
+	ph->query[PUB_HDR_MAX + ph->qlen] = '\0';
+	len = hlen + ph->qlen + 1;
+	ph->calls++;
+	ph->bytes += len;
+	if (rpc_call(ph->rpc, q, len, ph->resp, sizeof(ph->resp), &rlen))
+		ph->published += ph->nrows;
+	else
+		ph->failed += ph->nrows;
+	ph->qlen = 0;
+	ph->nrows = 0;
+}
+
+static void add_row(PublisherHead *ph, const FlowRecord *r) {
+	char saddr[INET_ADDRSTRLEN], daddr[INET_ADDRSTRLEN];
+	char row[PUB_ROW_MAX];
+	unsigned len;
+
+	inet_ntop(AF_INET, &r->saddr, saddr, sizeof(saddr));
+	inet_ntop(AF_INET, &r->daddr, daddr, sizeof(daddr));
+	len = snprintf(row, sizeof(row),
+		       "insert into Flows values ('%u', '%s', '%u', '%s', '%u', '%llu', '%llu')\n",
+		       r->proto, saddr, ntohs(r->sport), daddr, ntohs(r->dport),
+		       (unsigned long long)r->packets,
+		       (unsigned long long)r->bytes);
+	/* leave room for the terminating NUL */
+	if (ph->qlen + len + 1 > ph->maxquery - PUB_HDR_MAX)
+		send_batch(ph);
+	memcpy(ph->query + PUB_HDR_MAX + ph->qlen, row, len);
+	ph->qlen += len;
+	ph->nrows++;
+}
+
+/* move everything queued into batches; returns the number of records */
+static unsigned long drain(PublisherHead *ph) {
+	unsigned long n = 0;
+	FlowRecord *r;
+	int i;
+
+	for (i = 0; i < ph->nproducers; i++)
+		while ((r = spsc_peek(ph->producers[i].ring)) != NULL) {
+			add_row(ph, r);
+			spsc_release(ph->producers[i].ring);
+			n++;
+		}
+	return n;
+}
+
+static void *publisher_loop(void *args) {
+	PublisherHead *ph = (PublisherHead *)args;
+	struct timespec nap = {0, PUB_IDLE_MS * 1000000};
+	unsigned idle_ms = 0;
+
+	while (!__atomic_load_n(&ph->stop, __ATOMIC_ACQUIRE)) {
+		if (drain(ph)) {
+			idle_ms = 0;
+			continue;
+		}
+		/* a partly filled batch goes out once the records dry up */
+		if (ph->nrows && idle_ms >= ph->flush_ms) {
+			send_batch(ph);
+			idle_ms = 0;
+		}
+		nanosleep(&nap, NULL);
+		idle_ms += PUB_IDLE_MS;
+	}
+	drain(ph);
+	send_batch(ph);
+	return NULL;
+}
+
+Publisher pub_create(RpcConnection rpc, int nproducers, unsigned long qsize,
+		     unsigned maxquery, unsigned flush_ms) {
+	PublisherHead *ph;
+	int i;
+
+	if (maxquery < PUB_HDR_MAX + PUB_ROW_MAX + 1)
+		return NULL;
+	if (!(ph = (PublisherHead *)mem_alloc(sizeof(PublisherHead))))
+		return NULL;
+	memset(ph, 0, sizeof(PublisherHead));
+	ph->rpc = rpc;
+	ph->nproducers = nproducers;
+	ph->maxquery = maxquery;
+	ph->flush_ms = flush_ms;
+	ph->producers = (Producer *)mem_alloc(nproducers * sizeof(Producer));
+	ph->query = (char *)mem_alloc(maxquery);
+	if (!ph->producers || !ph->query)
+		goto err;
+	memset(ph->producers, 0, nproducers * sizeof(Producer));
+	for (i = 0; i < nproducers; i++)
+		if (!(ph->producers[i].ring = spsc_create(qsize,
+							   sizeof(FlowRecord))))
+			goto err;
+	return (Publisher)ph;
+err:
+	pub_destroy((Publisher)ph);
+	return NULL;
+}
+
+int pub_start(Publisher p) {
+	PublisherHead *ph = (PublisherHead *)p;
+
+	ph->stop = 0;
+	if (pthread_create(&ph->thread, NULL, publisher_loop, ph))
+		return 0;
+	ph->running = 1;
+	return 1;
+}
+
+int pub_enqueue(Publisher p, int producer, const FlowRecord *r, int wait) {
+	Producer *pr = &((PublisherHead *)p)->producers[producer];
+	FlowRecord *slot;
+
+	while ((slot = spsc_reserve(pr->ring)) == NULL) {
+		if (!wait) {
+			pr->dropped++;
+			return 0;
+		}
+		sched_yield();
+	}
+	*slot = *r;
+	spsc_commit(pr->ring);
+	pr->queued++;
+	return 1;
+}
+
+void pub_stop(Publisher p) {
+	PublisherHead *ph = (PublisherHead *)p;
+
+	if (!ph->running)
+		return;
+	__atomic_store_n(&ph->stop, 1, __ATOMIC_RELEASE);
+	pthread_join(ph->thread, NULL);
+	ph->running = 0;
+}
+
+void pub_stats(Publisher p, PubStats *st) {
+	PublisherHead *ph = (PublisherHead *)p;
+	int i;
+
+	memset(st, 0, sizeof(PubStats));
+	for (i = 0; i < ph->nproducers; i++) {
+		st->queued += ph->producers[i].queued;
+		st->dropped += ph->producers[i].dropped;
+	}
+	st->published = ph->published;
+	st->failed = ph->failed;
+	st->calls = ph->calls;
+	st->bytes = ph->bytes;
+}
+
+void pub_destroy(Publisher p) {
+	PublisherHead *ph = (PublisherHead *)p;
+	int i;
+
+	pub_stop(p);
+	if (ph->producers) {
+		for (i = 0; i < ph->nproducers; i++)
+			if (ph->producers[i].ring)
+				spsc_destroy(ph->producers[i].ring);
+		mem_free(ph->producers);
+	}
+	if (ph->query)
+		mem_free(ph->query);
+	mem_free(ph);
+}
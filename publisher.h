@@ -0,0 +1,68 @@
+/*
+ * publisher.h - public data structures and entry points for the background
+ *               publisher of flow records to the Homework database
+ *
+ * packet threads hand records over through one lock-free ring each and
+ * never wait for the database; a publisher thread drains the rings,
+ * coalesces the records into BULK: messages of insert statements into the
+ * Flows table, each as large as fits into `maxquery' bytes, and ships
+ * them with rpc_call()
+ *
+ * the Flows table is expected to be
+ *
+ * create table Flows (proto integer, saddr varchar(16), sport integer,
+ * daddr varchar(16), dport integer, npkts integer, nbytes integer)
+ */
+
+#ifndef _PUBLISHER_H_INCLUDED_
+#define _PUBLISHER_H_INCLUDED_
+
+#include <stdint.h>
+#include "srpc.h"
+
+typedef void *Publisher;
+
+typedef struct flow_record {
+	uint32_t saddr, daddr;		/* network order */
+	uint16_t sport, dport;		/* network order */
+	uint8_t proto;
+	uint64_t packets;
+	uint64_t bytes;
+} FlowRecord;
+
+typedef struct pub_stats {
+	unsigned long queued;		/* records accepted by pub_enqueue() */
+	unsigned long dropped;		/* records refused on a full ring */
+	unsigned long published;	/* records in successful calls */
+	unsigned long failed;		/* records in failed calls */
+	unsigned long calls;		/* rpc_call()s made */
+	unsigned long bytes;		/* query bytes sent */
+} PubStats;
+
+/* constructor - `nproducers' threads get a ring of `qsize' records each;
+ * messages are at most `maxquery' bytes, a partly filled one is sent
+ * after `flush_ms' milliseconds without new records
+ * returns NULL if error */
+Publisher pub_create(RpcConnection rpc, int nproducers, unsigned long qsize,
+		     unsigned maxquery, unsigned flush_ms);
+
+/* start the publisher thread; returns 1 if successful, 0 otherwise */
+int pub_start(Publisher p);
+
+/* producer `producer': queue a copy of `r'; if the ring is full the
+ * record is dropped, unless `wait' is set, in which case the caller
+ * yields until there is room
+ * returns 1 if queued, 0 if dropped */
+int pub_enqueue(Publisher p, int producer, const FlowRecord *r, int wait);
+
+/* publish everything queued so far and stop the publisher thread; the
+ * producers must be done */
+void pub_stop(Publisher p);
+
+/* fill in the counters; exact after pub_stop() */
+void pub_stats(Publisher p, PubStats *st);
+
+/* destructor */
+void pub_destroy(Publisher p);
+
+#endif /* _PUBLISHER_H_INCLUDED_ */
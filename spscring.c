@@ -0,0 +1,93 @@
+/*
+ * spscring.c - implementation of lock-free single-producer/single-consumer
+ *              rings
+ */
+
+#include "spscring.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define CACHE_LINE 64
+
+typedef struct spsc_ring {
+	/* read-only after construction */
+	unsigned char *slots;
+	unsigned long mask;
+	unsigned long slotsize;
+	unsigned char pad0[CACHE_LINE - 3 * sizeof(unsigned long)];
+	/* written by the producer only */
+	unsigned long head;
+	unsigned long tail_cache;	/* producer's last view of tail */
+	unsigned char pad1[CACHE_LINE - 2 * sizeof(unsigned long)];
+	/* written by the consumer only */
+	unsigned long tail;
+	unsigned long head_cache;	/* consumer's last view of head */
+	unsigned char pad2[CACHE_LINE - 2 * sizeof(unsigned long)];
+} SPSCRingHead;
+
+SPSCRing spsc_create(unsigned long nslots, unsigned long slotsize) {
+	SPSCRingHead *rh;
+	unsigned long n = 1;
+
+	while (n < nslots)
+		n <<= 1;
+	slotsize = (slotsize + CACHE_LINE - 1) & ~((unsigned long)CACHE_LINE - 1);
+	if (posix_memalign((void **)&rh, CACHE_LINE, sizeof(SPSCRingHead)))
+		return NULL;
+	memset(rh, 0, sizeof(SPSCRingHead));
+	if (posix_memalign((void **)&rh->slots, CACHE_LINE, n * slotsize)) {
+		free(rh);
+		return NULL;
+	}
+	rh->mask = n - 1;
+	rh->slotsize = slotsize;
+	return (SPSCRing)rh;
+}
+
+void *spsc_reserve(SPSCRing r) {
+	SPSCRingHead *rh = (SPSCRingHead *)r;
+
+	if (rh->head - rh->tail_cache > rh->mask) {
+		rh->tail_cache = __atomic_load_n(&rh->tail, __ATOMIC_ACQUIRE);
+		if (rh->head - rh->tail_cache > rh->mask)
+			return NULL;
+	}
+	return rh->slots + (rh->head & rh->mask) * rh->slotsize;
+}
+
+void spsc_commit(SPSCRing r) {
+	SPSCRingHead *rh = (SPSCRingHead *)r;
+
+	__atomic_store_n(&rh->head, rh->head + 1, __ATOMIC_RELEASE);
+}
+
+void *spsc_peek(SPSCRing r) {
+	SPSCRingHead *rh = (SPSCRingHead *)r;
+
+	if (rh->tail == rh->head_cache) {
+		rh->head_cache = __atomic_load_n(&rh->head, __ATOMIC_ACQUIRE);
+		if (rh->tail == rh->head_cache)
+			return NULL;
+	}
+	return rh->slots + (rh->tail & rh->mask) * rh->slotsize;
+}
+
+void spsc_release(SPSCRing r) {
+	SPSCRingHead *rh = (SPSCRingHead *)r;
+
+	__atomic_store_n(&rh->tail, rh->tail + 1, __ATOMIC_RELEASE);
+}
+
+unsigned long spsc_count(SPSCRing r) {
+	SPSCRingHead *rh = (SPSCRingHead *)r;
+
+	return __atomic_load_n(&rh->head, __ATOMIC_ACQUIRE) -
+	       __atomic_load_n(&rh->tail, __ATOMIC_ACQUIRE);
+}
+
+void spsc_destroy(SPSCRing r) {
+	SPSCRingHead *rh = (SPSCRingHead *)r;
+
+	free(rh->slots);
+	free(rh);
+}
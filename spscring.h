@@ -0,0 +1,43 @@
+/*
+ * spscring.h - public data structures and entry points for lock-free
+ *              single-producer/single-consumer rings of fixed-size slots
+ *
+ * exactly one thread may act as the producer (spsc_reserve/spsc_commit)
+ * and exactly one thread as the consumer (spsc_peek/spsc_release); no
+ * locks are taken, the two sides only synchronise through the head and
+ * tail indices, which live on separate cache lines
+ *
+ * slots are handed out in place, so a producer writes directly into the
+ * ring memory and the consumer reads from it without a further copy
+ */
+
+#ifndef _SPSCRING_H_INCLUDED_
+#define _SPSCRING_H_INCLUDED_
+
+typedef void *SPSCRing;
+
+/* constructor - `nslots' is rounded up to a power of two, every slot is
+ * `slotsize' bytes long (rounded up to a cache line)
+ * returns NULL if error */
+SPSCRing spsc_create(unsigned long nslots, unsigned long slotsize);
+
+/* producer: return the next free slot, or NULL if the ring is full */
+void *spsc_reserve(SPSCRing r);
+
+/* producer: publish the slot returned by the last spsc_reserve() */
+void spsc_commit(SPSCRing r);
+
+/* consumer: return the oldest published slot, or NULL if the ring is empty */
+void *spsc_peek(SPSCRing r);
+
+/* consumer: hand the slot returned by the last spsc_peek() back */
+void spsc_release(SPSCRing r);
+
+/* number of published slots not yet released; exact only when called by
+ * the consumer or when both sides are idle */
+unsigned long spsc_count(SPSCRing r);
+
+/* destructor */
+void spsc_destroy(SPSCRing r);
+
+#endif /* _SPSCRING_H_INCLUDED_ */
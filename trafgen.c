@@ -0,0 +1,474 @@
+/*
+ * trafgen.c - implementation of the synthetic traffic generator
+ */
+
+#include "trafgen.h"
+#include "mem.h"
+#include <localhash.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <arpa/inet.h>
+#include <net/ethernet.h>
+#include <linux/ip.h>
+#include <linux/tcp.h>
+#include <linux/udp.h>
+
+#define TG_EPOCH 1262304000		/* time of the first packet */
+#define TG_CLIENT_NET 0x0a000000	/* 10.0.0.0/8 */
+#define TG_SERVER_NET 0xc6120000	/* 198.18.0.0/15 */
+#define TG_HDR_MAX (sizeof(struct ether_header) + sizeof(struct iphdr) + \
+		    sizeof(struct tcphdr))
+#define TG_FRAME_MAX 1514
+#define TG_MSG_MAX 256
+#define TG_RANDOM_SIZE 65536		/* random bytes payloads are cut from */
+
+static const char *app_names[TG_MAX_APP] = {
+	"http", "tls", "bittorrent", "dns", "edonkey", "ssh", "tcp", "udp"
+};
+
+/* protocol and server port of every application, 0 for a random one */
+static const struct {
+	uint8_t proto;
+	uint16_t port;
+	int repeat;			/* the exchange goes on over and over */
+} apps[TG_MAX_APP] = {
+	{IPPROTO_TCP, 80, 0},
+	{IPPROTO_TCP, 443, 0},
+	{IPPROTO_TCP, 6881, 0},
+	{IPPROTO_UDP, 53, 1},
+	{IPPROTO_TCP, 4662, 0},
+	{IPPROTO_TCP, 22, 0},
+	{IPPROTO_TCP, 0, 0},
+	{IPPROTO_UDP, 0, 0},
+};
+
+typedef struct tg_flow {
+	uint32_t caddr, saddr;		/* host order */
+	uint16_t cport, sport;
+	uint8_t app;
+	uint32_t npkts, sent;
+	uint32_t seq[2];		/* next sequence number, client and server */
+} TGFlow;
+
+typedef struct trafgen {
+	TrafGenConfig cfg;
+	unsigned long started;		/* flows started so far */
+	TGFlow *active;
+	unsigned nactive;
+	double *size_cdf;		/* P(flow size <= i + 1) */
+	unsigned mix_total;
+	uint64_t time_us;
+	uint16_t ip_id;
+	/* the opening exchange of every application, client message first */
+	u_char msg[TG_MAX_APP][2][TG_MSG_MAX];
+	unsigned msglen[TG_MAX_APP][2];
+	u_char *random;
+	u_char frame[TG_FRAME_MAX];
+} TrafGenHead;
+
+void trafgen_defaults(TrafGenConfig *cfg) {
+	int i;
+
+	memset(cfg, 0, sizeof(TrafGenConfig));
+	cfg->flows = 10000;
+	cfg->active = 1000;
+	cfg->zipf = 1.0;
+	cfg->max_packets = 1000;
+	cfg->packet_size = 512;
+	cfg->clients = 4096;
+	cfg->servers = 1024;
+	cfg->interval_us = 10;
+	for (i = 0; i < TG_MAX_APP; i++)
+		cfg->mix[i] = 1;
+	cfg->seed = 1;
+}
+
+int trafgen_parse(TrafGenConfig *cfg, const char *spec) {
+	char name[32];
+	const char *p, *eq, *end;
+	char *rest;
+	unsigned long v;
+	double d;
+	int i;
+
+	for (p = spec; *p != '\0'; p = *end ? end + 1 : end) {
+		end = strchr(p, ',');
+		if (end == NULL)
+			end = p + strlen(p);
+		eq = memchr(p, '=', end - p);
+		if (eq == NULL || eq - p >= sizeof(name))
+			return 0;
+		memcpy(name, p, eq - p);
+		name[eq - p] = '\0';
+		d = strtod(eq + 1, &rest);
+		if (rest != end || d < 0)
+			return 0;
+		v = (unsigned long)d;
+		if (strcmp(name, "zipf") == 0) {
+			cfg->zipf = d;
+			continue;
+		}
+		for (i = 0; i < TG_MAX_APP; i++)
+			if (strcmp(name, app_names[i]) == 0)
+				break;
+		if (i < TG_MAX_APP)
+			cfg->mix[i] = v;
+		else if (strcmp(name, "flows") == 0)
+			cfg->flows = v;
+		else if (strcmp(name, "active") == 0)
+			cfg->active = v;
+		else if (strcmp(name, "max") == 0)
+			cfg->max_packets = v;
+		else if (strcmp(name, "size") == 0)
+			cfg->packet_size = v;
+		else if (strcmp(name, "clients") == 0)
+			cfg->clients = v;
+		else if (strcmp(name, "servers") == 0)
+			cfg->servers = v;
+		else if (strcmp(name, "interval") == 0)
+			cfg->interval_us = v;
+		else if (strcmp(name, "seed") == 0)
+			cfg->seed = v;
+		else
+			return 0;
+	}
+	return 1;
+}
+
+const char *trafgen_app_name(enum trafgen_app app) {
+	return app_names[app];
+}
+
+static void put_u16(u_char *p, uint16_t v) {
+	p[0] = v >> 8;
+	p[1] = v;
+}
+
+static void put_l32(u_char *p, uint32_t v) {
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+static unsigned put_str(u_char *p, const char *s) {
+	memcpy(p, s, strlen(s));
+	return strlen(s);
+}
+
+/* a TLS handshake record of `len' bytes with handshake message `type' */
+static unsigned tls_hello(u_char *p, uint8_t type, unsigned len) {
+	unsigned i;
+
+	p[0] = 0x16;
+	p[1] = 0x03;
+	p[2] = 0x01;
+	put_u16(p + 3, len - 5);
+	p[5] = type;
+	p[6] = 0;
+	put_u16(p + 7, len - 9);
+	p[9] = 0x03;
+	p[10] = 0x01;
+	for (i = 11; i < len; i++)
+		p[i] = random_mt();
+	/* no session id */
+	p[43] = 0;
+	return len;
+}
+
+/* a DNS message about www.example.com, a response if `answer' */
+static unsigned dns_message(u_char *p, int answer) {
+	static const u_char qname[] = "\003www\007example\003com";
+	unsigned len = 12;
+
+	memset(p, 0, 12);
+	put_u16(p, 0x1234);
+	put_u16(p + 2, answer ? 0x8180 : 0x0100);
+	put_u16(p + 4, 1);
+	put_u16(p + 6, answer ? 1 : 0);
+	memcpy(p + len, qname, sizeof(qname));
+	len += sizeof(qname);
+	put_u16(p + len, 1);		/* A */
+	put_u16(p + len + 2, 1);	/* IN */
+	len += 4;
+	if (answer) {
+		put_u16(p + len, 0xc00c);
+		put_u16(p + len + 2, 1);
+		put_u16(p + len + 4, 1);
+		put_u16(p + len + 6, 0);	/* TTL 3600 */
+		put_u16(p + len + 8, 3600);
+		put_u16(p + len + 10, 4);
+		put_u16(p + len + 12, 0xc000);	/* 192.0.2.1 */
+		put_u16(p + len + 14, 0x0201);
+		len += 16;
+	}
+	return len;
+}
+
+/* an eDonkey hello (0x01) or hello answer (0x4c) of `len' bytes */
+static unsigned edonkey_hello(u_char *p, uint8_t opcode, unsigned len) {
+	unsigned i;
+
+	for (i = 0; i < len; i++)
+		p[i] = random_mt();
+	p[0] = 0xe3;
+	put_l32(p + 1, len - 5);
+	p[5] = opcode;
+	if (opcode == 0x01) {
+		p[6] = 0x10;		/* length of the user hash */
+		put_l32(p + 29, 2);	/* meta tags */
+	}
+	return len;
+}
+
+static void build_messages(TrafGenHead *th) {
+	u_char *c, *s;
+	unsigned i;
+
+	c = th->msg[TG_HTTP][0], s = th->msg[TG_HTTP][1];
+	th->msglen[TG_HTTP][0] = put_str(c, "GET /index.html HTTP/1.1\r\n"
+					 "Host: www.example.com\r\n"
+					 "User-Agent: trafgen/1.0\r\n"
+					 "Accept: */*\r\n\r\n");
+	th->msglen[TG_HTTP][1] = put_str(s, "HTTP/1.1 200 OK\r\n"
+					 "Server: Apache\r\n"
+					 "Content-Type: text/html\r\n"
+					 "Content-Length: 1000000\r\n\r\n");
+
+	th->msglen[TG_TLS][0] = tls_hello(th->msg[TG_TLS][0], 0x01, 180);
+	th->msglen[TG_TLS][1] = tls_hello(th->msg[TG_TLS][1], 0x02, 90);
+
+	/* handshakes of the same torrent, each with its own peer id */
+	c = th->msg[TG_BITTORRENT][0], s = th->msg[TG_BITTORRENT][1];
+	c[0] = 19;
+	memcpy(c + 1, "BitTorrent protocol", 19);
+	memset(c + 20, 0, 8);
+	for (i = 28; i < 68; i++)
+		c[i] = random_mt();
+	memcpy(s, c, 48);
+	for (i = 48; i < 68; i++)
+		s[i] = random_mt();
+	th->msglen[TG_BITTORRENT][0] = th->msglen[TG_BITTORRENT][1] = 68;
+
+	th->msglen[TG_DNS][0] = dns_message(th->msg[TG_DNS][0], 0);
+	th->msglen[TG_DNS][1] = dns_message(th->msg[TG_DNS][1], 1);
+
+	th->msglen[TG_EDONKEY][0] = edonkey_hello(th->msg[TG_EDONKEY][0], 0x01, 48);
+	th->msglen[TG_EDONKEY][1] = edonkey_hello(th->msg[TG_EDONKEY][1], 0x4c, 40);
+
+	th->msglen[TG_SSH][0] = put_str(th->msg[TG_SSH][0], "SSH-2.0-OpenSSH_5.3\r\n");
+	th->msglen[TG_SSH][1] = put_str(th->msg[TG_SSH][1],
+					"SSH-2.0-OpenSSH_5.1p1 Debian-5\r\n");
+}
+
+/* a uniform double in [0, 1) */
+static double random_unit(void) {
+	return random_mt() / 4294967296.0;
+}
+
+static uint32_t size_sample(TrafGenHead *th) {
+	double u = random_unit();
+	unsigned lo = 0, hi = th->cfg.max_packets - 1, mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (th->size_cdf[mid] < u)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo + 1;
+}
+
+static void start_flow(TrafGenHead *th, TGFlow *f) {
+	unsigned pick = random_mt() % th->mix_total;
+	int app;
+
+	for (app = 0; pick >= th->cfg.mix[app]; app++)
+		pick -= th->cfg.mix[app];
+	f->app = app;
+	f->caddr = TG_CLIENT_NET + 1 + random_mt() % th->cfg.clients;
+	f->saddr = TG_SERVER_NET + 1 + random_mt() % th->cfg.servers;
+	f->cport = 1024 + random_mt() % (65536 - 1024);
+	f->sport = apps[app].port ? apps[app].port : 1024 + random_mt() % (65536 - 1024);
+	f->npkts = size_sample(th);
+	f->sent = 0;
+	f->seq[0] = random_mt();
+	f->seq[1] = random_mt();
+	th->started++;
+}
+
+TrafGen trafgen_create(const TrafGenConfig *cfg) {
+	TrafGenHead *th;
+	double sum = 0;
+	unsigned i;
+
+	if (cfg->active == 0 || cfg->max_packets == 0 || cfg->clients == 0 ||
+	    cfg->servers == 0 || cfg->packet_size > TG_FRAME_MAX)
+		return NULL;
+	if (!(th = (TrafGenHead *)mem_alloc(sizeof(TrafGenHead))))
+		return NULL;
+	memset(th, 0, sizeof(TrafGenHead));
+	th->cfg = *cfg;
+	for (i = 0; i < TG_MAX_APP; i++)
+		th->mix_total += cfg->mix[i];
+	th->active = (TGFlow *)mem_alloc(cfg->active * sizeof(TGFlow));
+	th->size_cdf = (double *)mem_alloc(cfg->max_packets * sizeof(double));
+	th->random = (u_char *)mem_alloc(TG_RANDOM_SIZE + TG_FRAME_MAX);
+	if (th->mix_total == 0 || !th->active || !th->size_cdf || !th->random) {
+		trafgen_destroy((TrafGen)th);
+		return NULL;
+	}
+
+	seed_mt(cfg->seed);
+	for (i = 0; i < cfg->max_packets; i++)
+		th->size_cdf[i] = sum += pow(i + 1, -cfg->zipf);
+	for (i = 0; i < cfg->max_packets; i++)
+		th->size_cdf[i] /= sum;
+	for (i = 0; i < TG_RANDOM_SIZE + TG_FRAME_MAX; i++)
+		th->random[i] = random_mt();
+	build_messages(th);
+	th->time_us = (uint64_t)TG_EPOCH * 1000000;
+	while (th->nactive < cfg->active && th->started < cfg->flows)
+		start_flow(th, &th->active[th->nactive++]);
+	return (TrafGen)th;
+}
+
+/* payload of packet `k' after the handshake of `f' in direction `dir' */
+static unsigned payload(TrafGenHead *th, TGFlow *f, unsigned k, int dir,
+			unsigned hdrlen, u_char *p) {
+	unsigned len;
+
+	if (apps[f->app].repeat)
+		k %= 2;
+	if (k < 2 && th->msglen[f->app][dir]) {
+		len = th->msglen[f->app][dir];
+		memcpy(p, th->msg[f->app][dir], len);
+		return len;
+	}
+	len = th->cfg.packet_size > hdrlen ? th->cfg.packet_size - hdrlen : 1;
+	memcpy(p, th->random + random_mt() % TG_RANDOM_SIZE, len);
+	return len;
+}
+
+static unsigned build_frame(TrafGenHead *th, TGFlow *f) {
+	struct ether_header *eth = (struct ether_header *)th->frame;
+	struct iphdr *ip = (struct iphdr *)(eth + 1);
+	struct tcphdr *tcp = (struct tcphdr *)(ip + 1);
+	struct udphdr *udp = (struct udphdr *)(ip + 1);
+	unsigned i = f->sent, k, l4len, len = 0;
+	uint32_t sum = 0;
+	int dir;
+
+	memset(th->frame, 0, TG_HDR_MAX);
+	if (apps[f->app].proto == IPPROTO_TCP) {
+		/* handshake, then the exchange alternating from the client */
+		dir = i < 3 ? i == 1 : (i - 3) % 2;
+		l4len = sizeof(struct tcphdr);
+		if (i >= 3) {
+			len = payload(th, f, i - 3, dir, TG_HDR_MAX,
+				      (u_char *)(tcp + 1));
+			tcp->psh = 1;
+		}
+		tcp->source = htons(dir ? f->sport : f->cport);
+		tcp->dest = htons(dir ? f->cport : f->sport);
+		tcp->seq = htonl(f->seq[dir]);
+		tcp->syn = i < 2;
+		tcp->ack = i > 0;
+		if (i > 0)
+			tcp->ack_seq = htonl(f->seq[1 - dir]);
+		tcp->doff = 5;
+		tcp->window = htons(65535);
+		f->seq[dir] += len + (i < 2);
+	} else {
+		dir = i % 2;
+		l4len = sizeof(struct udphdr);
+		len = payload(th, f, i, dir, TG_HDR_MAX - sizeof(struct tcphdr) +
+			      sizeof(struct udphdr), (u_char *)(udp + 1));
+		udp->source = htons(dir ? f->sport : f->cport);
+		udp->dest = htons(dir ? f->cport : f->sport);
+		udp->len = htons(l4len + len);
+	}
+
+	memset(eth->ether_dhost, dir ? 0x02 : 0x04, ETHER_ADDR_LEN);
+	memset(eth->ether_shost, dir ? 0x04 : 0x02, ETHER_ADDR_LEN);
+	eth->ether_type = htons(ETHERTYPE_IP);
+	ip->version = 4;
+	ip->ihl = 5;
+	ip->tot_len = htons(sizeof(struct iphdr) + l4len + len);
+	ip->id = htons(th->ip_id++);
+	ip->ttl = 64;
+	ip->protocol = apps[f->app].proto;
+	ip->saddr = htonl(dir ? f->saddr : f->caddr);
+	ip->daddr = htonl(dir ? f->caddr : f->saddr);
+	for (k = 0; k < sizeof(struct iphdr) / 2; k++)
+		sum += ((uint16_t *)ip)[k];
+	sum = (sum & 0xffff) + (sum >> 16);
+	ip->check = ~((sum & 0xffff) + (sum >> 16));
+	return sizeof(struct ether_header) + sizeof(struct iphdr) + l4len + len;
+}
+
+const u_char *trafgen_next(TrafGen g, struct pcap_pkthdr *hdr) {
+	TrafGenHead *th = (TrafGenHead *)g;
+	TGFlow *f;
+
+	if (th->nactive == 0)
+		return NULL;
+	f = &th->active[random_mt() % th->nactive];
+	hdr->caplen = hdr->len = build_frame(th, f);
+	hdr->ts.tv_sec = th->time_us / 1000000;
+	hdr->ts.tv_usec = th->time_us % 1000000;
+	th->time_us += th->cfg.interval_us;
+	if (++f->sent == f->npkts) {
+		if (th->started < th->cfg.flows)
+			start_flow(th, f);
+		else
+			*f = th->active[--th->nactive];
+	}
+	return th->frame;
+}
+
+long trafgen_write_pcap(TrafGen g, const char *path) {
+	/* classic pcap file header, in host byte order */
+	struct {
+		uint32_t magic;
+		uint16_t major, minor;
+		uint32_t zone, sigfigs, snaplen, linktype;
+	} fh = {0xa1b2c3d4, 2, 4, 0, 0, TG_FRAME_MAX, DLT_EN10MB};
+	struct pcap_pkthdr hdr;
+	const u_char *frame;
+	uint32_t rec[4];
+	long n = 0;
+	FILE *fp;
+
+	if ((fp = fopen(path, "w")) == NULL)
+		return -1;
+	fwrite(&fh, sizeof(fh), 1, fp);
+	while ((frame = trafgen_next(g, &hdr)) != NULL) {
+		/* the on-disk header has 32 bit timestamps */
+		rec[0] = hdr.ts.tv_sec;
+		rec[1] = hdr.ts.tv_usec;
+		rec[2] = hdr.caplen;
+		rec[3] = hdr.len;
+		fwrite(rec, sizeof(rec), 1, fp);
+		fwrite(frame, hdr.caplen, 1, fp);
+		n++;
+	}
+	if (fclose(fp) != 0)
+		return -1;
+	return n;
+}
+
+void trafgen_destroy(TrafGen g) {
+	TrafGenHead *th = (TrafGenHead *)g;
+
+	if (th->active)
+		mem_free(th->active);
+	if (th->size_cdf)
+		mem_free(th->size_cdf);
+	if (th->random)
+		mem_free(th->random);
+	mem_free(th);
+}
@@ -0,0 +1,83 @@
+/*
+ * trafgen.h - public data structures and entry points for the synthetic
+ *             traffic generator
+ *
+ * generates Ethernet/IPv4 frames of a population of TCP and UDP flows,
+ * for load tests of the flow table and the detection path without real
+ * captures. Every flow belongs to an application whose first payloads
+ * carry the prefixes the opendpi dissectors look for (HTTP request and
+ * response lines, TLS hellos, the BitTorrent handshake, DNS queries,
+ * eDonkey hellos, SSH banners), or random bytes for traffic that stays
+ * unknown; TCP flows open with a handshake and keep their sequence
+ * numbers consistent
+ *
+ * flow sizes in packets follow a Zipf distribution, a fixed number of
+ * flows is interleaved at any time. The stream only depends on the
+ * configuration and its seed. Random numbers come from the Mersenne
+ * twister of libhashish/localhash, which has a single state per process:
+ * only one generator may be in use at a time
+ */
+
+#ifndef _TRAFGEN_H_INCLUDED_
+#define _TRAFGEN_H_INCLUDED_
+
+#include <stdint.h>
+#include <pcap.h>
+
+typedef void *TrafGen;
+
+enum trafgen_app {
+	TG_HTTP,
+	TG_TLS,
+	TG_BITTORRENT,
+	TG_DNS,
+	TG_EDONKEY,
+	TG_SSH,
+	TG_TCP,			/* random payload, stays unknown */
+	TG_UDP,			/* likewise */
+	TG_MAX_APP
+};
+
+typedef struct trafgen_config {
+	unsigned long flows;		/* flows generated in total */
+	unsigned active;		/* flows interleaved at any time */
+	double zipf;			/* exponent of the flow size distribution */
+	unsigned max_packets;		/* packets of the largest flow */
+	unsigned packet_size;		/* frame size of packets after the prefixes */
+	unsigned clients, servers;	/* distinct addresses on either side */
+	unsigned interval_us;		/* time between two packets */
+	unsigned mix[TG_MAX_APP];	/* relative weight of every application */
+	uint32_t seed;
+} TrafGenConfig;
+
+/* fill in the defaults: 10000 flows, 1000 at a time, Zipf 1.0 up to 1000
+ * packets of 512 bytes, and a mix of all applications */
+void trafgen_defaults(TrafGenConfig *cfg);
+
+/* change `cfg' by the comma separated name=value list `spec', names being
+ * the fields of the configuration (flows, active, zipf, max, size,
+ * clients, servers, interval, seed) or applications (http, tls,
+ * bittorrent, dns, edonkey, ssh, tcp, udp) to set their weight
+ * returns 1 if successful, 0 on an unknown name or bad value */
+int trafgen_parse(TrafGenConfig *cfg, const char *spec);
+
+/* name of application `app' */
+const char *trafgen_app_name(enum trafgen_app app);
+
+/* constructor
+ * returns NULL if error */
+TrafGen trafgen_create(const TrafGenConfig *cfg);
+
+/* the next frame of the stream, with its header in *hdr; the frame stays
+ * valid until the next call
+ * returns NULL once every flow is done */
+const u_char *trafgen_next(TrafGen g, struct pcap_pkthdr *hdr);
+
+/* write the rest of the stream to the pcap file `path'
+ * returns the number of frames written, -1 if error */
+long trafgen_write_pcap(TrafGen g, const char *path);
+
+/* destructor */
+void trafgen_destroy(TrafGen g);
+
+#endif /* _TRAFGEN_H_INCLUDED_ */